@@ -0,0 +1,602 @@
+// FBXExport_BENCH.cpp : Benchmarks for every stage of the exporter.
+// The synthetic runs generate their meshes, skins and clips, no Fbx sdk or fbx files needed.
+//
+// Usage: FBXExport_BENCH [options]
+//	--joints N		joints in the generated skeleton and clip (80)
+//	--frames N		frames in the generated clip (240)
+//	--grid N		the generated mesh is an N x N quad grid (96)
+//	--verts N		vertices skinned by the skinning runs (100000)
+//	--repeat N		runs per stage, the fastest one is reported (5)
+//	--json FILE		also writes the results as json, '-' for stdout
+//	--fbx FILE		end to end export of an fbx through the dll, may be given more than once (Run.fbx skinned, Crate.fbx static)
+//	--mesh FILE		runs the skin data checks over an exported .mesh
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <random>
+#include <filesystem>
+#include "FBX_Export_Interface.h"
+#include "anim_runtime.h"
+#include "anim_sampler.h"
+#include "mesh_processing.h"
+#include "skeleton.h"
+#include "skinning.h"
+
+struct bench_config
+{
+	size_t joint_count = 80;
+	size_t frame_count = 240;
+	size_t grid_size = 96;
+	size_t vert_count = 100000;
+	size_t repeat = 5;
+	std::string json_path;
+	std::vector<std::string> fbx_files;
+	std::string mesh_file;
+};
+
+struct bench_result
+{
+	std::string name;
+	std::string unit;		// what 'count' counts
+	double count = 0.0;		// items handled by one run
+	double seconds = 0.0;	// fastest run
+};
+
+struct bench_report
+{
+	std::vector<bench_result> results;
+	std::vector<std::pair<std::string, double>> checks;
+	bool passed = true;
+};
+
+// Runs 'stage' config.repeat times and keeps the fastest
+template<typename Stage>
+void Time_Stage(bench_report& report, const bench_config& config, const std::string& name, const char* unit, double count, Stage&& stage)
+{
+	double best = 0.0;
+	for (size_t r = 0; r < std::max<size_t>(config.repeat, 1); ++r)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		stage();
+		auto end = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration<double>(end - start).count();
+		best = r == 0 ? seconds : std::min(best, seconds);
+	}
+	report.results.push_back({ name, unit, count, best });
+}
+
+double File_Size(const char* file_path)
+{
+	std::error_code error;
+	auto size = std::filesystem::file_size(file_path, error);
+	return error ? 0.0 : static_cast<double>(size);
+}
+
+#pragma region SYNTHETIC DATA
+// Builds a clip where every joint swings on its own frequency, a fifth of the joints never move
+// 'samples' gets the fixed rate local poses, frame major, before reduction
+end::track_clip Make_Synthetic_Clip(size_t joint_count, size_t frame_count, float sample_rate,
+	std::vector<end::trs>& samples, std::vector<float>& times)
+{
+	times.resize(frame_count);
+	samples.assign(frame_count * joint_count, end::trs());
+	for (size_t f = 0; f < frame_count; ++f)
+	{
+		times[f] = f / sample_rate;
+		for (size_t j = 0; j < joint_count; ++j)
+		{
+			end::trs& pose = samples[f * joint_count + j];
+			if (j % 5 == 4)
+				continue;
+			float angle = std::sin(times[f] * (1.0f + j % 7)) * 0.5f;
+			pose.translation = { 0.0f, 0.1f * j + 0.02f * angle, 0.0f };
+			pose.rotation = { std::sin(angle * 0.5f), 0.0f, 0.0f, std::cos(angle * 0.5f) };
+		}
+	}
+
+	end::track_clip clip;
+	clip.name = "synthetic";
+	clip.duration = (frame_count - 1) / sample_rate;
+	clip.sample_rate = sample_rate;
+	for (size_t j = 0; j < joint_count; ++j)
+		clip.parent_indices.push_back(static_cast<int>(j) - 1);
+	end::Reduce_Tracks(samples, times, joint_count, end::reduction_tolerance(), clip.tracks);
+	return clip;
+}
+
+// A rolling N x N quad grid laid out like the sdk hands meshes over: shared control points,
+// per corner normals and uvs, and one skin cluster per joint along the grid's length
+void Make_Synthetic_Mesh(size_t grid_size, size_t joint_count, end::raw_mesh& out_mesh, std::vector<end::skin_cluster>& out_clusters)
+{
+	size_t side = grid_size + 1;
+	out_mesh = end::raw_mesh();
+	out_mesh.control_points.resize(side * side);
+	std::vector<DirectX::XMFLOAT3> point_normals(side * side);
+	for (size_t y = 0; y < side; ++y)
+	{
+		for (size_t x = 0; x < side; ++x)
+		{
+			float u = float(x) / grid_size, v = float(y) / grid_size;
+			float height = 0.1f * std::sin(u * 12.0f) * std::cos(v * 9.0f);
+			out_mesh.control_points[y * side + x] = { u, height, v, 1.0f };
+			float dx = 0.1f * 12.0f * std::cos(u * 12.0f) * std::cos(v * 9.0f);
+			float dz = -0.1f * 9.0f * std::sin(u * 12.0f) * std::sin(v * 9.0f);
+			float length = std::sqrt(dx * dx + 1.0f + dz * dz);
+			point_normals[y * side + x] = { -dx / length, 1.0f / length, -dz / length };
+		}
+	}
+
+	auto add_corner = [&](size_t point)
+	{
+		out_mesh.polygon_vertices.push_back(static_cast<int>(point));
+		out_mesh.normals.push_back(point_normals[point]);
+		out_mesh.uvs.push_back({ out_mesh.control_points[point].x, out_mesh.control_points[point].z });
+	};
+	for (size_t y = 0; y < grid_size; ++y)
+	{
+		for (size_t x = 0; x < grid_size; ++x)
+		{
+			size_t corner = y * side + x;
+			add_corner(corner); add_corner(corner + side); add_corner(corner + 1);
+			add_corner(corner + 1); add_corner(corner + side); add_corner(corner + side + 1);
+		}
+	}
+
+	// each joint owns a band of the grid and fades out over its neighbours'
+	out_clusters.assign(joint_count, end::skin_cluster());
+	for (size_t j = 0; j < joint_count; ++j)
+	{
+		out_clusters[j].joint = static_cast<int>(j);
+		float center = (j + 0.5f) / joint_count;
+		float reach = 2.0f / joint_count;
+		for (size_t p = 0; p < out_mesh.control_points.size(); ++p)
+		{
+			float distance = std::fabs(out_mesh.control_points[p].x - center);
+			if (distance < reach)
+			{
+				out_clusters[j].control_points.push_back(static_cast<int>(p));
+				out_clusters[j].weights.push_back(1.0f - distance / reach);
+			}
+		}
+	}
+}
+
+// Random vertices in a unit box, each bound to up to four random joints
+std::vector<end::simple_vert> Make_Random_Skinned_Verts(size_t vert_count, size_t joint_count)
+{
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_int_distribution<int> joint(0, static_cast<int>(joint_count) - 1);
+
+	std::vector<end::simple_vert> verts(vert_count);
+	for (auto& vert : verts)
+	{
+		vert.pos = { unit(random), unit(random), unit(random), 1.0f };
+		vert.norm = { unit(random), unit(random), unit(random) };
+
+		float sum = 0.0f;
+		int influences = 1 + static_cast<int>(random() % 4);
+		for (int k = 0; k < 4; ++k)
+		{
+			vert.joint_index[k] = joint(random);
+			vert.weights[k] = k < influences ? unit(random) + 1.0f : 0.0f;
+			sum += vert.weights[k];
+		}
+		for (int k = 0; k < 4; ++k)
+			vert.weights[k] /= sum;
+	}
+	return verts;
+}
+#pragma endregion
+
+// Reads the vertices, and the indices and skeleton hash when asked for, of a .mesh file written by 'export_simple_mesh'
+bool Read_Mesh_File(const char* file_path, std::vector<end::simple_vert>& out_verts, std::vector<uint32_t>* out_indices = nullptr,
+	uint64_t* out_skeleton_hash = nullptr)
+{
+	std::ifstream file(file_path, std::ios::binary | std::ios::in);
+	uint32_t index_count = 0, vert_count = 0;
+	file.read((char*)&index_count, sizeof(uint32_t));
+	if (out_indices)
+	{
+		out_indices->resize(index_count);
+		file.read((char*)out_indices->data(), sizeof(uint32_t) * index_count);
+	}
+	else
+		file.seekg(sizeof(uint32_t) * index_count, std::ios::cur);
+	file.read((char*)&vert_count, sizeof(uint32_t));
+	out_verts.resize(vert_count);
+	file.read((char*)out_verts.data(), sizeof(end::simple_vert) * vert_count);
+	if (out_skeleton_hash)
+		file.read((char*)out_skeleton_hash, sizeof(uint64_t));
+	return file.good();
+}
+
+float Largest_Difference(const end::skinned_batch& a, const end::skinned_batch& b, size_t vert_count)
+{
+	float worst = 0.0f;
+	for (size_t i = 0; i < vert_count; ++i)
+	{
+		worst = std::max(worst, std::fabs(a.px[i] - b.px[i]));
+		worst = std::max(worst, std::fabs(a.py[i] - b.py[i]));
+		worst = std::max(worst, std::fabs(a.pz[i] - b.pz[i]));
+		worst = std::max(worst, std::fabs(a.nx[i] - b.nx[i]));
+		worst = std::max(worst, std::fabs(a.ny[i] - b.ny[i]));
+		worst = std::max(worst, std::fabs(a.nz[i] - b.nz[i]));
+	}
+	return worst;
+}
+
+void Mesh_Benchmarks(bench_report& report, const bench_config& config)
+{
+	end::raw_mesh raw;
+	std::vector<end::skin_cluster> clusters;
+	Make_Synthetic_Mesh(config.grid_size, config.joint_count, raw, clusters);
+	double points = static_cast<double>(raw.control_points.size());
+	double corners = static_cast<double>(raw.polygon_vertices.size());
+
+	Time_Stage(report, config, "bind_skin", "control_points", points,
+		[&] { end::Bind_Skin(clusters, raw.control_points.size(), raw.influences); });
+
+	end::mesh_buffers expanded;
+	Time_Stage(report, config, "expand_vertices", "vertices", corners,
+		[&] { end::Expand_Vertices(raw, expanded); });
+
+	// welding works in place, every run starts over from the expanded vertices
+	end::mesh_buffers welded;
+	Time_Stage(report, config, "compactify", "vertices", corners, [&]
+	{
+		welded.verts = expanded.verts;
+		end::Compactify(welded);
+	});
+	report.checks.push_back({ "compactify_vertex_count", double(welded.verts.size()) });
+	// the grid's corners all agree on their control point's normal and uv
+	if (welded.verts.size() != raw.control_points.size())
+		report.passed = false;
+	for (size_t i = 0; i < welded.indices.size(); ++i)
+	{
+		if (welded.verts[welded.indices[i]].pos.x != expanded.verts[i].pos.x || welded.verts[welded.indices[i]].pos.z != expanded.verts[i].pos.z)
+			report.passed = false;
+	}
+
+	// the whole pipeline out of one arena, the way Process_Mesh runs it
+	Time_Stage(report, config, "mesh_arena_pipeline", "vertices", corners, [&]
+	{
+		std::pmr::monotonic_buffer_resource arena(end::Mesh_Arena_Size(raw.control_points.size(), raw.polygon_vertices.size()));
+		end::mesh_buffers mesh(&arena);
+		end::Expand_Vertices(raw, mesh);
+		end::Compactify(mesh);
+	});
+
+	const char* mesh_path = "bench_tmp.mesh";
+	Time_Stage(report, config, "write_mesh_file", "bytes",
+		double(sizeof(uint32_t) * (2 + welded.indices.size()) + sizeof(end::simple_vert) * welded.verts.size() + sizeof(uint64_t)),
+		[&] { end::Write_Mesh_File(welded.View(), mesh_path, 0); });
+	std::remove(mesh_path);
+
+	// streamed in chunks, once with a weld table big enough for the whole mesh and once with one that keeps filling up
+	const size_t chunk = 4096;
+	for (size_t table_bytes : { size_t(64) << 20, size_t(16) << 10 })
+	{
+		end::mesh_stream_writer writer;
+		std::string name = table_bytes > (size_t(1) << 20) ? "stream_mesh" : "stream_mesh_small_table";
+		Time_Stage(report, config, name, "vertices", corners, [&]
+		{
+			writer.Open(mesh_path, static_cast<uint32_t>(expanded.verts.size()), table_bytes);
+			for (size_t first = 0; first < expanded.verts.size(); first += chunk)
+				writer.Write_Chunk(expanded.verts.data() + first, std::min(chunk, expanded.verts.size() - first));
+			writer.Close(0);
+		});
+		report.checks.push_back({ name + "_vertex_count", double(writer.Vertex_Count()) });
+
+		// every corner still has to resolve to its own vertex
+		std::vector<uint32_t> indices;
+		std::vector<end::simple_vert> verts;
+		if (!Read_Mesh_File(mesh_path, verts, &indices) || indices.size() != expanded.verts.size())
+			report.passed = false;
+		for (size_t i = 0; i < indices.size() && report.passed; ++i)
+		{
+			if (indices[i] >= verts.size() || verts[indices[i]].pos.x != expanded.verts[i].pos.x
+				|| verts[indices[i]].norm.y != expanded.verts[i].norm.y || verts[indices[i]].tex_coord.y != expanded.verts[i].tex_coord.y)
+				report.passed = false;
+		}
+		// with room for every vertex it has to weld exactly like Compactify
+		if (writer.Weld_Resets() == 0 && (verts.size() != welded.verts.size() || indices != std::vector<uint32_t>(welded.indices.begin(), welded.indices.end())))
+			report.passed = false;
+		std::remove(mesh_path);
+	}
+}
+
+void Animation_Benchmarks(bench_report& report, const bench_config& config, end::track_clip& out_clip)
+{
+	std::vector<end::trs> samples;
+	std::vector<float> times;
+	out_clip = Make_Synthetic_Clip(config.joint_count, config.frame_count, 24.0f, samples, times);
+	double joint_frames = static_cast<double>(samples.size());
+
+	std::vector<end::joint_track> tracks;
+	Time_Stage(report, config, "reduce_tracks", "joint_frames", joint_frames,
+		[&] { end::Reduce_Tracks(samples, times, config.joint_count, end::reduction_tolerance(), tracks); });
+
+	// ten minutes of root motion, a straight walk that can't drop keys past the segment cap
+	const size_t long_frame_count = 24 * 60 * 10;
+	std::vector<float> long_times(long_frame_count);
+	std::vector<end::trs> long_samples(long_frame_count);
+	for (size_t f = 0; f < long_frame_count; ++f)
+	{
+		long_times[f] = f / 24.0f;
+		long_samples[f].translation = { 1.5f * long_times[f], 0.0f, 0.02f * std::sin(long_times[f] * 0.01f) };
+	}
+	end::joint_track long_track;
+	Time_Stage(report, config, "reduce_tracks_long", "joint_frames", double(long_frame_count),
+		[&] { end::Reduce_Joint_Track(long_samples, long_times, end::reduction_tolerance(), long_track); });
+
+	float long_worst = 0.0f;
+	const auto& keys = long_track.translation;
+	for (size_t f = 0, k = 0; f < long_frame_count; ++f)
+	{
+		while (k + 2 < keys.times.size() && keys.times[k + 1] <= long_times[f])
+			++k;
+		float t = std::clamp((long_times[f] - keys.times[k]) / (keys.times[k + 1] - keys.times[k]), 0.0f, 1.0f);
+		float x = keys.values[k].x + (keys.values[k + 1].x - keys.values[k].x) * t;
+		float z = keys.values[k].z + (keys.values[k + 1].z - keys.values[k].z) * t;
+		long_worst = std::max(long_worst, std::hypot(x - long_samples[f].translation.x, z - long_samples[f].translation.z));
+	}
+	report.checks.push_back({ "long_clip_largest_error", long_worst });
+	if (long_worst > end::reduction_tolerance().position * 1.01f)
+		report.passed = false;
+
+	end::packed_clip packed;
+	Time_Stage(report, config, "pack_clip", "joints", static_cast<double>(config.joint_count),
+		[&] { end::Pack_Clip(out_clip, packed); });
+
+	const char* track_path = "bench_tmp.anim";
+	std::vector<end::track_clip> clips(1, out_clip);
+	end::Write_Track_File(clips, end::reduction_tolerance(), track_path);
+	Time_Stage(report, config, "write_track_file", "bytes", File_Size(track_path),
+		[&] { end::Write_Track_File(clips, end::reduction_tolerance(), track_path); });
+	std::remove(track_path);
+
+	// both sampling paths have to agree before the timings mean anything
+	const size_t sample_count = 2000;
+	float duration = static_cast<float>(out_clip.duration);
+	std::vector<end::trs> reference_pose, simd_pose;
+	Time_Stage(report, config, "sample_clip", "joints", double(sample_count) * config.joint_count, [&]
+	{
+		for (size_t i = 0; i < sample_count; ++i)
+			end::Sample_Clip(out_clip, duration * i / sample_count, reference_pose);
+	});
+
+	end::clip_sampler sampler(packed);
+	Time_Stage(report, config, "clip_sampler", "joints", double(sample_count) * config.joint_count, [&]
+	{
+		for (size_t i = 0; i < sample_count; ++i)
+			sampler.Sample(duration * i / sample_count, simd_pose);
+	});
+
+	float worst = 0.0f;
+	for (size_t i = 0; i < 100; ++i)
+	{
+		float t = duration * i / 100.0f;
+		end::Sample_Clip(out_clip, t, reference_pose);
+		sampler.Sample(t, simd_pose);
+		for (size_t j = 0; j < config.joint_count; ++j)
+		{
+			worst = std::max(worst, std::fabs(reference_pose[j].translation.y - simd_pose[j].translation.y));
+			worst = std::max(worst, std::fabs(reference_pose[j].rotation.x - simd_pose[j].rotation.x));
+			worst = std::max(worst, std::fabs(reference_pose[j].rotation.w - simd_pose[j].rotation.w));
+		}
+	}
+	report.checks.push_back({ "sampler_largest_difference", worst });
+	if (worst >= 1e-5f)
+		report.passed = false;
+}
+
+// Skins random vertices with the clip's pose halfway through, bound to the clip's first frame
+void Skinning_Benchmarks(bench_report& report, const bench_config& config, const end::track_clip& clip)
+{
+	using namespace DirectX;
+
+	std::vector<end::trs> pose;
+	std::vector<XMFLOAT4X4> bind_pose, model_pose, inverse_bind, palette;
+	end::Sample_Clip(clip, 0.0f, pose);
+	end::Local_To_Model(clip.parent_indices, pose, bind_pose);
+	end::Sample_Clip(clip, static_cast<float>(clip.duration) * 0.5f, pose);
+	end::Local_To_Model(clip.parent_indices, pose, model_pose);
+
+	inverse_bind.resize(bind_pose.size());
+	for (size_t j = 0; j < bind_pose.size(); ++j)
+		XMStoreFloat4x4(&inverse_bind[j], XMMatrixInverse(nullptr, XMLoadFloat4x4(&bind_pose[j])));
+	end::Build_Skinning_Palette(model_pose, inverse_bind, palette);
+
+	std::vector<end::simple_vert> verts = Make_Random_Skinned_Verts(config.vert_count, palette.size());
+	end::skin_batch batch;
+	end::Make_Skin_Batch(verts.data(), verts.size(), batch);
+	double count = static_cast<double>(config.vert_count);
+
+	end::skinned_batch reference, skinned;
+	Time_Stage(report, config, "skin_scalar", "vertices", count, [&] { end::Skin_Batch(palette, batch, reference, end::SKIN_SCALAR, 1); });
+	Time_Stage(report, config, "skin_sse", "vertices", count, [&] { end::Skin_Batch(palette, batch, skinned, end::SKIN_SSE, 1); });
+	float worst = Largest_Difference(reference, skinned, config.vert_count);
+
+	if (end::Cpu_Has_Avx2())
+	{
+		Time_Stage(report, config, "skin_avx2", "vertices", count, [&] { end::Skin_Batch(palette, batch, skinned, end::SKIN_AVX2, 1); });
+		worst = std::max(worst, Largest_Difference(reference, skinned, config.vert_count));
+	}
+
+	Time_Stage(report, config, "skin_threaded", "vertices", count, [&] { end::Skin_Batch(palette, batch, skinned); });
+	worst = std::max(worst, Largest_Difference(reference, skinned, config.vert_count));
+
+	report.checks.push_back({ "skinning_largest_difference", worst });
+	if (worst >= 1e-4f)
+		report.passed = false;
+}
+
+// Whole exports through the dll, sdk import included
+void End_To_End_Benchmarks(bench_report& report, const bench_config& config)
+{
+	for (auto& fbx : config.fbx_files)
+	{
+		std::string stem = std::filesystem::path(fbx).stem().string();
+		int result = 0;
+
+		Time_Stage(report, config, "export_simple_mesh:" + stem, "files", 1.0,
+			[&] { result |= export_simple_mesh(fbx.c_str(), "bench_tmp.mesh"); });
+		Time_Stage(report, config, "export_simple_mesh_streamed:" + stem, "files", 1.0,
+			[&] { result |= export_simple_mesh_streamed(fbx.c_str(), "bench_tmp_streamed.mesh"); });
+		// the default budget leaves the weld table room for any test asset, both files have to be the same
+		std::vector<end::simple_vert> verts, streamed_verts;
+		std::vector<uint32_t> indices, streamed_indices;
+		uint64_t mesh_skeleton = 0, streamed_skeleton = 0;
+		bool same = Read_Mesh_File("bench_tmp.mesh", verts, &indices, &mesh_skeleton)
+			&& Read_Mesh_File("bench_tmp_streamed.mesh", streamed_verts, &streamed_indices, &streamed_skeleton)
+			&& indices == streamed_indices && verts.size() == streamed_verts.size() && mesh_skeleton == streamed_skeleton
+			&& std::memcmp(verts.data(), streamed_verts.data(), verts.size() * sizeof(end::simple_vert)) == 0;
+		report.checks.push_back({ "streamed_mesh_matches:" + stem, same ? 1.0 : 0.0 });
+		if (!same)
+			report.passed = false;
+		std::remove("bench_tmp.mesh");
+		std::remove("bench_tmp_streamed.mesh");
+
+		// a static mesh has no skeleton, so no clip or .skel to export either
+		if (mesh_skeleton != 0)
+		{
+			Time_Stage(report, config, "export_animation_tracks:" + stem, "files", 1.0,
+				[&] { result |= export_animation_tracks(fbx.c_str(), "bench_tmp.anim"); });
+			uint64_t skeleton_hash = 0;
+			Time_Stage(report, config, "export_skeleton:" + stem, "files", 1.0,
+				[&] { result |= export_skeleton(fbx.c_str(), ".", &skeleton_hash); });
+
+			std::remove("bench_tmp.anim");
+			std::remove(end::Skeleton_File_Name(skeleton_hash).c_str());
+		}
+
+		report.checks.push_back({ "export_result:" + stem, double(result) });
+		if (result != 0)
+			report.passed = false;
+	}
+}
+
+std::string Json_Escape(const std::string& text)
+{
+	std::string out;
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			out += '\\';
+		out += c;
+	}
+	return out;
+}
+
+void Write_Json(std::ostream& out, const bench_config& config, const bench_report& report)
+{
+	out << "{\n";
+	out << "\t\"config\": { \"joints\": " << config.joint_count << ", \"frames\": " << config.frame_count
+		<< ", \"grid\": " << config.grid_size << ", \"verts\": " << config.vert_count << ", \"repeat\": " << config.repeat
+		<< ", \"avx2\": " << (end::Cpu_Has_Avx2() ? "true" : "false") << " },\n";
+
+	out << "\t\"results\": [\n";
+	for (size_t i = 0; i < report.results.size(); ++i)
+	{
+		const bench_result& result = report.results[i];
+		out << "\t\t{ \"name\": \"" << Json_Escape(result.name) << "\", \"unit\": \"" << result.unit
+			<< "\", \"count\": " << result.count << ", \"seconds\": " << result.seconds
+			<< ", \"per_second\": " << (result.seconds > 0.0 ? result.count / result.seconds : 0.0) << " }"
+			<< (i + 1 < report.results.size() ? ",\n" : "\n");
+	}
+	out << "\t],\n";
+
+	out << "\t\"checks\": {";
+	for (size_t i = 0; i < report.checks.size(); ++i)
+		out << (i ? ", " : " ") << "\"" << Json_Escape(report.checks[i].first) << "\": " << report.checks[i].second;
+	out << " },\n";
+	out << "\t\"passed\": " << (report.passed ? "true" : "false") << "\n";
+	out << "}\n";
+}
+
+void Print_Report(const bench_report& report)
+{
+	for (auto& result : report.results)
+	{
+		std::printf("%-40s %12.3f ms %16.0f %s/s\n", result.name.c_str(), result.seconds * 1000.0,
+			result.seconds > 0.0 ? result.count / result.seconds : 0.0, result.unit.c_str());
+	}
+	for (auto& check : report.checks)
+		std::printf("%-40s %g\n", check.first.c_str(), check.second);
+	std::printf("%s\n", report.passed ? "all checks passed" : "CHECKS FAILED");
+}
+
+bool Parse_Arguments(int argc, char** argv, bench_config& config)
+{
+	for (int i = 1; i < argc; i += 2)
+	{
+		if (i + 1 >= argc)
+			return false;
+		const char* arg = argv[i];
+		const char* value = argv[i + 1];
+
+		if (strcmp(arg, "--joints") == 0)		config.joint_count = std::strtoul(value, nullptr, 10);
+		else if (strcmp(arg, "--frames") == 0)	config.frame_count = std::strtoul(value, nullptr, 10);
+		else if (strcmp(arg, "--grid") == 0)	config.grid_size = std::strtoul(value, nullptr, 10);
+		else if (strcmp(arg, "--verts") == 0)	config.vert_count = std::strtoul(value, nullptr, 10);
+		else if (strcmp(arg, "--repeat") == 0)	config.repeat = std::strtoul(value, nullptr, 10);
+		else if (strcmp(arg, "--json") == 0)	config.json_path = value;
+		else if (strcmp(arg, "--fbx") == 0)		config.fbx_files.push_back(value);
+		else if (strcmp(arg, "--mesh") == 0)	config.mesh_file = value;
+		else
+			return false;
+	}
+	return config.joint_count > 0 && config.frame_count > 1 && config.grid_size > 0 && config.vert_count > 0;
+}
+
+int main(int argc, char** argv)
+{
+	bench_config config;
+	if (!Parse_Arguments(argc, argv, config))
+	{
+		std::cout << "usage: FBXExport_BENCH [--joints N] [--frames N] [--grid N] [--verts N] [--repeat N] [--json FILE] [--fbx FILE]... [--mesh FILE]" << std::endl;
+		return 2;
+	}
+
+	bench_report report;
+	end::track_clip clip;
+	Mesh_Benchmarks(report, config);
+	Animation_Benchmarks(report, config, clip);
+	Skinning_Benchmarks(report, config, clip);
+	End_To_End_Benchmarks(report, config);
+
+	if (!config.mesh_file.empty())
+	{
+		std::vector<end::simple_vert> verts;
+		if (!Read_Mesh_File(config.mesh_file.c_str(), verts))
+		{
+			std::cout << "couldn't read " << config.mesh_file << std::endl;
+			return 1;
+		}
+		int highest_joint = -1;
+		for (auto& vert : verts)
+			highest_joint = std::max({ highest_joint, vert.joint_index[0], vert.joint_index[1], vert.joint_index[2], vert.joint_index[3] });
+		size_t bad = end::Check_Skin_Data(verts.data(), verts.size(), static_cast<size_t>(highest_joint + 1));
+		report.checks.push_back({ "bad_skin_vertices:" + std::filesystem::path(config.mesh_file).stem().string(), double(bad) });
+	}
+
+	Print_Report(report);
+
+	if (config.json_path == "-")
+		Write_Json(std::cout, config, report);
+	else if (!config.json_path.empty())
+	{
+		std::ofstream json(config.json_path, std::ios::trunc | std::ios::out);
+		Write_Json(json, config, report);
+	}
+
+	return report.passed ? 0 : 1;
+}
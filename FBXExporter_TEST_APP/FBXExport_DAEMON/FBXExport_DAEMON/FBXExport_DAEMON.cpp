@@ -0,0 +1,586 @@
+// FBXExport_DAEMON.cpp : Long running exporter for editor live links.
+// Keeps the Fbx sdk warm (see 'set_exporter_warm') and takes export requests over a localhost socket,
+// so a save only pays for its import and export, not for process startup and sdk initialization.
+//
+// Usage:
+//	FBXExport_DAEMON [--port N] [--threads N]	serves requests (port 52300, 2 threads)
+//	FBXExport_DAEMON --client [--port N]		sends the request lines read from stdin and prints the replies
+//
+// Protocol, one tab separated request per line, replies are streamed back on the same connection
+//	export <id> <fbx path> <output path without extension> [outputs]
+//		outputs is a comma list of mesh, mats, anim, tanim and skel (mesh,mats,tanim,skel)
+//		replies:	queued <id>
+//					output <id> <output> <result> <milliseconds> <file>		as each file is written
+//					done <id> ok|failed|cancelled|superseded <milliseconds>	since the request came in
+//	cancel <id>		the export stops at its next check, see 'start_export_job'
+//	shutdown		stops the daemon once the running exports are done
+//
+// A newer export of the same fbx supersedes the older ones still queued or running, so a burst of saves only
+// exports the last one. A running export is cancelled in the middle of its current output, not after it.
+// Exports of the same fbx never run at the same time, different files run in parallel on the dll's job workers.
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using socket_t = SOCKET;
+#define close_socket closesocket
+#define SHUT_RDWR SD_BOTH
+const int SEND_FLAGS = 0;
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+using socket_t = int;
+const socket_t INVALID_SOCKET = -1;
+#define close_socket close
+// a client that went away must not take the daemon down with SIGPIPE
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+#endif
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdio>
+#include <cstdlib>
+#include "FBX_Export_Interface.h"
+
+#pragma region CONNECTION
+class connection
+{
+public:
+	explicit connection(socket_t socket) : socket(socket) {}
+	~connection() { close_socket(socket); }
+
+	connection(const connection&) = delete;
+	connection& operator=(const connection&) = delete;
+
+	// Returns false once the other end is gone
+	bool Send(const std::string& line)
+	{
+		std::lock_guard<std::mutex> guard(write_lock);
+		if (!open)
+			return false;
+		std::string data = line + "\n";
+		for (size_t sent = 0; sent < data.size();)
+		{
+			int n = send(socket, data.data() + sent, static_cast<int>(data.size() - sent), SEND_FLAGS);
+			if (n <= 0)
+			{
+				open = false;
+				return false;
+			}
+			sent += n;
+		}
+		return true;
+	}
+
+	// Blocks until a whole line came in, false when the connection closed
+	bool Read_Line(std::string& out_line)
+	{
+		for (;;)
+		{
+			size_t end = pending.find('\n');
+			if (end != std::string::npos)
+			{
+				out_line = pending.substr(0, end);
+				pending.erase(0, end + 1);
+				if (!out_line.empty() && out_line.back() == '\r')
+					out_line.pop_back();
+				return true;
+			}
+			char buffer[4096];
+			int n = recv(socket, buffer, sizeof(buffer), 0);
+			if (n <= 0)
+			{
+				open = false;
+				return false;
+			}
+			pending.append(buffer, n);
+		}
+	}
+
+	bool Is_Open() const { return open; }
+
+	// Unblocks a Read_Line waiting on the other thread
+	void Close()
+	{
+		open = false;
+		shutdown(socket, SHUT_RDWR);
+	}
+
+private:
+	socket_t socket;
+	std::mutex write_lock;
+	std::atomic<bool> open{ true };
+	std::string pending;
+};
+
+std::vector<std::string> Split(const std::string& line, char separator)
+{
+	std::vector<std::string> fields;
+	std::stringstream stream(line);
+	std::string field;
+	while (std::getline(stream, field, separator))
+		fields.push_back(field);
+	return fields;
+}
+
+double Milliseconds_Since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+#pragma endregion
+
+#pragma region SERVICE
+struct export_job
+{
+	std::string id;
+	std::string fbx;
+	std::string stem;
+	std::vector<std::string> outputs;
+	uint64_t generation = 0;
+	std::shared_ptr<connection> client;
+	std::atomic<bool> cancelled{ false };
+	std::chrono::steady_clock::time_point received;
+};
+
+// Runs one output of a job as an async export, 'out_file' is what got written.
+// 'stop' is asked every few milliseconds while it runs and cancels the export once it returns true,
+// the result is EXPORT_JOB_CANCELLED then unless the export was too far along to stop
+template<typename Stop>
+int Export_Output(const export_job& job, const std::string& output, std::string& out_file, Stop&& stop)
+{
+	std::filesystem::path directory = std::filesystem::path(job.stem).parent_path();
+	if (directory.empty())
+		directory = ".";
+
+	struct output_kind
+	{
+		const char* name;
+		export_job_kind kind;
+		const char* extension;		// null for the skeleton, it's named after its hash in the output directory
+	};
+	static const output_kind kinds[] =
+	{
+		{ "mesh", EXPORT_JOB_MESH, ".mesh" },
+		{ "mats", EXPORT_JOB_MATERIALS, ".mats" },
+		{ "anim", EXPORT_JOB_ANIMATION, ".anim" },
+		{ "tanim", EXPORT_JOB_ANIMATION_TRACKS, ".tanim" },
+		{ "skel", EXPORT_JOB_SKELETON, nullptr },
+	};
+	auto kind = std::find_if(std::begin(kinds), std::end(kinds), [&](const output_kind& k) { return output == k.name; });
+	if (kind == std::end(kinds))
+	{
+		out_file = "-";
+		return -1;
+	}
+
+	export_job_desc desc;
+	desc.kind = kind->kind;
+	desc.fbx_file_path = job.fbx.c_str();
+	out_file = kind->extension ? job.stem + kind->extension : directory.string();
+	desc.output_path = out_file.c_str();
+
+	export_job_handle handle = start_export_job(&desc);
+	if (handle == nullptr)
+		return -1;
+	int result;
+	bool cancelled = false;
+	while ((result = wait_export_job(handle, 20)) == EXPORT_JOB_RUNNING)
+	{
+		if (!cancelled && stop())
+			cancelled = cancel_export_job(handle) == 0;
+	}
+	export_job_status status = {};
+	poll_export_job(handle, &status);
+	release_export_job(handle);
+
+	if (kind->extension == nullptr)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.skel", static_cast<unsigned long long>(status.skeleton_hash));
+		out_file = (directory / name).string();
+	}
+	return result;
+}
+
+class export_service
+{
+public:
+	void Submit(const std::shared_ptr<export_job>& job)
+	{
+		std::vector<std::shared_ptr<export_job>> superseded;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			job->generation = ++next_generation;
+			latest[job->fbx] = job->generation;
+			// older saves of the same file that haven't started yet are dropped right away,
+			// a running one is cancelled by its worker, see Export_Output
+			for (auto it = queue.begin(); it != queue.end();)
+			{
+				if ((*it)->fbx == job->fbx)
+				{
+					superseded.push_back(*it);
+					it = queue.erase(it);
+				}
+				else
+					++it;
+			}
+			queue.push_back(job);
+		}
+		job->client->Send("queued\t" + job->id);
+		for (auto& old : superseded)
+			Finish(*old, "superseded");
+		wake.notify_all();
+	}
+
+	// An empty 'id' cancels everything 'client' asked for
+	void Cancel(const std::shared_ptr<connection>& client, const std::string& id)
+	{
+		std::vector<std::shared_ptr<export_job>> dropped;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			for (auto& job : running)
+				if (job->client == client && (id.empty() || job->id == id))
+					job->cancelled = true;
+			for (auto it = queue.begin(); it != queue.end();)
+			{
+				if ((*it)->client == client && (id.empty() || (*it)->id == id))
+				{
+					dropped.push_back(*it);
+					it = queue.erase(it);
+				}
+				else
+					++it;
+			}
+		}
+		for (auto& job : dropped)
+			Finish(*job, "cancelled");
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+		wake.notify_all();
+	}
+
+	void Run_Worker()
+	{
+		for (;;)
+		{
+			std::shared_ptr<export_job> job;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				// the first job whose file isn't already being exported by another worker
+				auto ready = queue.end();
+				wake.wait(guard, [&]
+				{
+					ready = std::find_if(queue.begin(), queue.end(), [&](const std::shared_ptr<export_job>& j) { return busy.count(j->fbx) == 0; });
+					return stopping || ready != queue.end();
+				});
+				if (ready == queue.end())
+					return;
+				job = *ready;
+				queue.erase(ready);
+				busy.insert(job->fbx);
+				running.push_back(job);
+			}
+
+			Run_Job(*job);
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				busy.erase(job->fbx);
+				running.erase(std::find(running.begin(), running.end(), job));
+			}
+			wake.notify_all();
+		}
+	}
+
+private:
+	// Null while the job should keep going
+	const char* Stop_Reason(const export_job& job)
+	{
+		if (job.cancelled || !job.client->Is_Open())
+			return "cancelled";
+		std::lock_guard<std::mutex> guard(lock);
+		return latest[job.fbx] != job.generation ? "superseded" : nullptr;
+	}
+
+	void Finish(const export_job& job, const char* status)
+	{
+		char ms[32];
+		snprintf(ms, sizeof(ms), "%.1f", Milliseconds_Since(job.received));
+		job.client->Send("done\t" + job.id + "\t" + status + "\t" + ms);
+	}
+
+	void Run_Job(const export_job& job)
+	{
+		bool failed = false;
+		for (auto& output : job.outputs)
+		{
+			if (const char* reason = Stop_Reason(job))
+			{
+				Finish(job, reason);
+				return;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			std::string file;
+			int result = Export_Output(job, output, file, [&] { return Stop_Reason(job) != nullptr; });
+			if (result == EXPORT_JOB_CANCELLED)
+			{
+				const char* reason = Stop_Reason(job);
+				Finish(job, reason ? reason : "cancelled");
+				return;
+			}
+			failed |= result != 0;
+
+			char ms[32];
+			snprintf(ms, sizeof(ms), "%.1f", Milliseconds_Since(start));
+			job.client->Send("output\t" + job.id + "\t" + output + "\t" + std::to_string(result) + "\t" + ms + "\t" + file);
+		}
+		Finish(job, failed ? "failed" : "ok");
+	}
+
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque<std::shared_ptr<export_job>> queue;
+	std::vector<std::shared_ptr<export_job>> running;
+	std::unordered_map<std::string, uint64_t> latest;		// newest generation per fbx path
+	std::unordered_set<std::string> busy;					// fbx paths a worker is exporting
+	uint64_t next_generation = 0;
+	bool stopping = false;
+};
+#pragma endregion
+
+#pragma region SERVER
+// Returns true when the client asked the daemon to shut down
+bool Serve_Client(export_service& service, std::shared_ptr<connection> client)
+{
+	std::string line;
+	while (client->Read_Line(line))
+	{
+		std::vector<std::string> fields = Split(line, '\t');
+		if (fields.empty())
+			continue;
+
+		if (fields[0] == "export" && fields.size() >= 4)
+		{
+			auto job = std::make_shared<export_job>();
+			job->received = std::chrono::steady_clock::now();
+			job->id = fields[1];
+			job->fbx = fields[2];
+			job->stem = fields[3];
+			job->outputs = Split(fields.size() >= 5 ? fields[4] : "mesh,mats,tanim,skel", ',');
+			job->client = client;
+			service.Submit(job);
+		}
+		else if (fields[0] == "cancel" && fields.size() >= 2)
+			service.Cancel(client, fields[1]);
+		else if (fields[0] == "shutdown")
+			return true;
+		else
+			client->Send("error\tbad request: " + line);
+	}
+	// nobody is left to read the results
+	service.Cancel(client, "");
+	return false;
+}
+
+int Run_Server(uint16_t port, int thread_count)
+{
+	socket_t listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listener == INVALID_SOCKET)
+		return -1;
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	// local only, there's no authentication
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 16) != 0)
+	{
+		close_socket(listener);
+		return -1;
+	}
+
+	set_exporter_warm(1);
+	export_service service;
+	std::vector<std::thread> workers;
+	for (int i = 0; i < thread_count; ++i)
+		workers.emplace_back([&service] { service.Run_Worker(); });
+	std::cout << "listening on 127.0.0.1:" << port << " with " << thread_count << " export threads" << std::endl;
+
+	// a client's thread raises its flag on the way out
+	struct client_thread
+	{
+		std::thread thread;
+		std::shared_ptr<std::atomic<bool>> finished;
+	};
+
+	std::atomic<bool> stopping{ false };
+	std::vector<std::weak_ptr<connection>> clients;
+	std::vector<client_thread> client_threads;
+	for (;;)
+	{
+		socket_t accepted = accept(listener, nullptr, nullptr);
+		if (accepted == INVALID_SOCKET || stopping)
+		{
+			if (accepted != INVALID_SOCKET)
+				close_socket(accepted);
+			break;
+		}
+
+		// the daemon runs for as long as the editor does, clients that hung up are let go of as new ones come in
+		client_threads.erase(std::remove_if(client_threads.begin(), client_threads.end(), [](client_thread& client)
+		{
+			if (!client.finished->load())
+				return false;
+			client.thread.join();
+			return true;
+		}), client_threads.end());
+		clients.erase(std::remove_if(clients.begin(), clients.end(), [](const std::weak_ptr<connection>& client) { return client.expired(); }),
+			clients.end());
+
+		auto client = std::make_shared<connection>(accepted);
+		auto finished = std::make_shared<std::atomic<bool>>(false);
+		clients.push_back(client);
+		client_threads.push_back({ std::thread([&service, &stopping, client, finished, port]
+		{
+			if (Serve_Client(service, client) && !stopping.exchange(true))
+			{
+				// wake the accept up so the main loop sees the shutdown
+				socket_t poke = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+				sockaddr_in self = {};
+				self.sin_family = AF_INET;
+				self.sin_port = htons(port);
+				self.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+				connect(poke, (sockaddr*)&self, sizeof(self));
+				close_socket(poke);
+			}
+			finished->store(true);
+		}), finished });
+	}
+
+	close_socket(listener);
+	service.Stop();
+	for (auto& worker : workers)
+		worker.join();
+	// hang up on whoever is still connected
+	for (auto& client : clients)
+		if (auto open = client.lock())
+			open->Close();
+	for (auto& client : client_threads)
+		client.thread.join();
+	return 0;
+}
+
+// Sends stdin to the daemon line by line and prints every reply until all of the exports sent are done
+int Run_Client(uint16_t port)
+{
+	socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (s == INVALID_SOCKET || connect(s, (sockaddr*)&address, sizeof(address)) != 0)
+	{
+		std::cerr << "no daemon on port " << port << std::endl;
+		return -1;
+	}
+	auto daemon = std::make_shared<connection>(s);
+
+	std::atomic<int> sent{ 0 }, finished{ 0 };
+	std::atomic<bool> input_done{ false };
+	std::thread input([&]
+	{
+		std::string line;
+		while (std::getline(std::cin, line))
+		{
+			if (line.compare(0, 6, "export") == 0)
+				++sent;
+			daemon->Send(line);
+			if (line == "shutdown")
+				break;
+		}
+		input_done = true;
+		// every reply may already be in, nothing else would wake the reader up
+		if (finished >= sent)
+			daemon->Close();
+	});
+
+	int failed = 0;
+	std::string reply;
+	while (daemon->Read_Line(reply))
+	{
+		std::cout << reply << std::endl;
+		if (reply.compare(0, 5, "done\t") == 0)
+		{
+			++finished;
+			// cancelled and superseded exports were asked for, only real failures count
+			failed += reply.find("\tfailed\t") != std::string::npos;
+		}
+		if (input_done && finished >= sent)
+			break;
+	}
+	input.join();
+	return failed == 0 ? 0 : -1;
+}
+#pragma endregion
+
+int main(int argc, char** argv)
+{
+	uint16_t port = 52300;
+	int thread_count = 2;
+	bool client = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--client")
+			client = true;
+		else if (arg == "--port" && i + 1 < argc)
+			port = static_cast<uint16_t>(std::atoi(argv[++i]));
+		else if (arg == "--threads" && i + 1 < argc)
+			thread_count = std::max(1, std::atoi(argv[++i]));
+		else
+		{
+			std::cerr << "usage: FBXExport_DAEMON [--client] [--port N] [--threads N]" << std::endl;
+			return 2;
+		}
+	}
+
+#ifdef _WIN32
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+		return 1;
+#endif
+	int result = client ? Run_Client(port) : Run_Server(port, thread_count);
+#ifdef _WIN32
+	WSACleanup();
+#endif
+	return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,701 @@
+// FBXExport_DRIVER.cpp : Runs the exporter over a manifest of fbx files split into shards.
+// Every shard is converted by its own worker process, the workers may run on different machines
+// as long as they all see the same work directory (and the files in the manifest).
+//
+// Usage: FBXExport_DRIVER <mode> --manifest FILE [options]
+//	run			starts one worker per shard on this machine, waits for them and merges their logs
+//	worker		converts one shard (--shard I), then helps with whatever the other shards left, start these on other nodes
+//	merge		merges every worker's log into WORK/results.tsv, exits with 1 unless every asset converted
+//	shards		prints the shard of every asset
+//
+// Options
+//	--work DIR			the shared work directory (driver_work)
+//	--out DIR			where the exported files go, in the same directories the assets are in under the manifest (WORK/out)
+//	--shards N			(4)
+//	--shard I			the shard a worker starts with
+//	--by hash|size		shard by a hash of the path, which stays put when the manifest changes,
+//						or balance the shards by file size (hash)
+//	--lock-timeout S	a lock nobody refreshed for S seconds belongs to a dead worker and is taken over (120)
+//	--attempts N		tries per asset, crashed workers included, before it is given up on (3)
+//	--no-steal			workers stop after their own shard
+//	--dry-run			nothing is exported, every asset just succeeds. For trying out the sharding and locking
+//
+// The manifest is one fbx path per line, relative paths are relative to the manifest, '#' starts a comment.
+//
+// Work directory
+//	locks/<key>.lock		held while an asset converts, names the worker and the attempt, touched every few seconds
+//	done/<key>.done			the asset is finished, one way or the other, nobody picks it up again
+//	logs/<host>_<pid>.tsv	one line per asset the worker finished
+//	results.tsv				the merged logs in manifest order
+// <key> is the fnv1a hash of the asset's path
+//
+// Lock timeouts are checked against this machine's clock, keep them well above the clock skew between nodes.
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "FBX_Export_Interface.h"
+#include "fnv1a.h"
+
+namespace fs = std::filesystem;
+
+struct driver_config
+{
+	std::string mode;
+	fs::path manifest;
+	fs::path work_dir = "driver_work";
+	fs::path out_dir;
+	int shard_count = 4;
+	int shard = -1;
+	bool by_size = false;
+	int lock_timeout = 120;
+	int attempts = 3;
+	bool steal = true;
+	bool dry_run = false;
+};
+
+struct asset
+{
+	std::string path;
+	std::string name;		// as written in the manifest
+	uint64_t key = 0;
+	uint64_t size = 0;
+	int shard = 0;
+};
+
+// one line of a worker log
+struct asset_result
+{
+	std::string key;
+	std::string status;			// ok, failed or crashed
+	int attempt = 0;
+	double seconds = 0.0;
+	uint64_t bytes = 0;
+	std::string outputs;
+	std::string worker;
+	std::string path;
+};
+
+#pragma region HELPERS
+std::string Key_String(uint64_t key)
+{
+	char text[17];
+	snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(key));
+	return text;
+}
+
+// "<host>_<pid>", unique across every worker sharing the work directory
+std::string Worker_Name()
+{
+	char host[256] = "host";
+#ifdef _WIN32
+	DWORD size = sizeof(host);
+	GetComputerNameA(host, &size);
+	unsigned long pid = GetCurrentProcessId();
+#else
+	gethostname(host, sizeof(host) - 1);
+	unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+	return std::string(host) + "_" + std::to_string(pid);
+}
+
+// Creates 'path' only if it doesn't exist yet, atomically, also on a shared file system
+bool Create_Exclusive(const fs::path& path, const std::string& contents)
+{
+#ifdef _WIN32
+	int fd = _wopen(path.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+	if (fd < 0)
+		return false;
+	_write(fd, contents.data(), static_cast<unsigned int>(contents.size()));
+	_close(fd);
+#else
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+		return false;
+	ssize_t written = write(fd, contents.data(), contents.size());
+	(void)written;
+	close(fd);
+#endif
+	return true;
+}
+
+std::string Read_Text(const fs::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream text;
+	text << file.rdbuf();
+	return text.str();
+}
+
+// Written next to 'path' and renamed over it so readers never see half a file
+bool Write_Text_Atomic(const fs::path& path, const std::string& contents, const std::string& worker)
+{
+	fs::path temp = path;
+	temp += "." + worker + ".tmp";
+	{
+		std::ofstream file(temp, std::ios::trunc | std::ios::binary);
+		if (!file.is_open())
+			return false;
+		file << contents;
+	}
+	std::error_code error;
+	fs::rename(temp, path, error);
+	return !error;
+}
+
+std::string Quote(const std::string& arg)
+{
+	return "\"" + arg + "\"";
+}
+#pragma endregion
+
+#pragma region MANIFEST
+int Read_Manifest(const driver_config& config, std::vector<asset>& out_assets)
+{
+	std::ifstream file(config.manifest);
+	if (!file.is_open())
+		return -1;
+
+	fs::path base = config.manifest.parent_path();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		line.erase(std::find(line.begin(), line.end(), '#'), line.end());
+		size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos)
+			continue;
+		line = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+
+		asset a;
+		fs::path path = line;
+		a.path = (path.is_absolute() ? path : base / path).lexically_normal().string();
+		a.name = line;
+		// hashed as written so every node gets the same key whatever its working directory
+		a.key = end::fnv1a(line.data(), line.size());
+		std::error_code error;
+		a.size = fs::file_size(a.path, error);
+		if (error)
+			a.size = 0;
+		out_assets.push_back(a);
+	}
+	return 0;
+}
+
+// Deterministic for a given manifest, every worker works the assignment out on its own
+void Assign_Shards(std::vector<asset>& assets, int shard_count, bool by_size)
+{
+	if (!by_size)
+	{
+		for (auto& a : assets)
+			a.shard = static_cast<int>(a.key % shard_count);
+		return;
+	}
+
+	// biggest first onto the lightest shard
+	std::vector<size_t> order(assets.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+	{
+		if (assets[a].size != assets[b].size)
+			return assets[a].size > assets[b].size;
+		return assets[a].key < assets[b].key;
+	});
+
+	std::vector<uint64_t> load(shard_count, 0);
+	for (size_t i : order)
+	{
+		int lightest = static_cast<int>(std::min_element(load.begin(), load.end()) - load.begin());
+		assets[i].shard = lightest;
+		load[lightest] += std::max<uint64_t>(assets[i].size, 1);
+	}
+}
+#pragma endregion
+
+#pragma region LOCKING
+enum e_claim { CLAIM_TAKEN, CLAIM_HELD, CLAIM_EXHAUSTED };
+
+struct lock_state
+{
+	fs::path path;
+	int attempt = 0;
+};
+
+fs::path Lock_Path(const driver_config& config, const asset& a)
+{
+	return config.work_dir / "locks" / (Key_String(a.key) + ".lock");
+}
+
+fs::path Done_Path(const driver_config& config, const asset& a)
+{
+	return config.work_dir / "done" / (Key_String(a.key) + ".done");
+}
+
+int Lock_Attempt(const std::string& contents)
+{
+	// "<worker> <attempt>"
+	size_t space = contents.find_last_of(' ');
+	return space == std::string::npos ? 1 : std::atoi(contents.c_str() + space + 1);
+}
+
+bool Lock_Is_Stale(const fs::path& lock, int timeout_seconds)
+{
+	std::error_code error;
+	auto written = fs::last_write_time(lock, error);
+	if (error)
+		return false;
+	return fs::file_time_type::clock::now() - written > std::chrono::seconds(timeout_seconds);
+}
+
+// Takes the asset's lock. A lock left behind by a worker that stopped refreshing it is taken over
+// and counts as a failed attempt
+e_claim Claim_Asset(const driver_config& config, const asset& a, const std::string& worker, lock_state& out_lock)
+{
+	out_lock.path = Lock_Path(config, a);
+	out_lock.attempt = 1;
+	if (Create_Exclusive(out_lock.path, worker + " 1"))
+		return CLAIM_TAKEN;
+
+	if (!Lock_Is_Stale(out_lock.path, config.lock_timeout))
+		return CLAIM_HELD;
+
+	// move the dead lock out of the way first, only one worker can win the rename
+	std::string stale = Read_Text(out_lock.path);
+	fs::path tombstone = out_lock.path;
+	tombstone += "." + worker + ".stale";
+	std::error_code error;
+	fs::rename(out_lock.path, tombstone, error);
+	if (error)
+		return CLAIM_HELD;
+	if (Read_Text(tombstone) != stale)
+	{
+		// somebody took it over between the read and the rename. Putting theirs back could land on a newer lock
+		// made since, so it's dropped and the next scan sees to the asset, at worst it converts twice
+		fs::remove(tombstone, error);
+		return CLAIM_HELD;
+	}
+	fs::remove(tombstone, error);
+
+	out_lock.attempt = Lock_Attempt(stale) + 1;
+	if (!Create_Exclusive(out_lock.path, worker + " " + std::to_string(out_lock.attempt)))
+		return CLAIM_HELD;
+	return out_lock.attempt > config.attempts ? CLAIM_EXHAUSTED : CLAIM_TAKEN;
+}
+
+// Keeps touching a lock so other workers can tell its owner is alive
+class lock_heartbeat
+{
+public:
+	lock_heartbeat(const fs::path& lock, int timeout_seconds)
+		: thread([this, lock, timeout_seconds]
+		{
+			auto interval = std::chrono::milliseconds(std::max(250, timeout_seconds * 1000 / 4));
+			std::unique_lock<std::mutex> guard(mutex);
+			while (!wake.wait_for(guard, interval, [this] { return stopping; }))
+			{
+				std::error_code error;
+				fs::last_write_time(lock, fs::file_time_type::clock::now(), error);
+			}
+		})
+	{
+	}
+
+	~lock_heartbeat()
+	{
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		thread.join();
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	std::thread thread;
+};
+#pragma endregion
+
+#pragma region CONVERSION
+// The asset's outputs mirror its directories under the manifest, so files of the same name in different
+// directories don't overwrite each other. Assets outside of it get their key added to the name instead
+fs::path Output_Stem(const driver_config& config, const asset& a)
+{
+	fs::path relative = fs::path(a.name).lexically_normal();
+	if (relative.is_absolute() || relative.has_root_name() || relative.empty() || *relative.begin() == "..")
+		return config.out_dir / (fs::path(a.path).stem().string() + "_" + Key_String(a.key));
+	return config.out_dir / relative.replace_extension();
+}
+
+// Exports everything the exporter knows how to pull out of one file, the asset counts as converted
+// when a mesh, materials or tracks were written, a skeleton alone doesn't. 'out_outputs' lists them
+int Convert_Asset(const driver_config& config, const asset& a, uint64_t& out_bytes, std::string& out_outputs)
+{
+	out_bytes = 0;
+	out_outputs.clear();
+	if (config.dry_run)
+	{
+		out_bytes = a.size;
+		out_outputs = "dry_run";
+		return 0;
+	}
+
+	std::string src = a.path;
+	fs::path stem_path = Output_Stem(config, a);
+	std::error_code dir_error;
+	fs::create_directories(stem_path.parent_path(), dir_error);
+	std::string stem = stem_path.string();
+	auto produced = [&](int result, const std::string& file, const char* name)
+	{
+		std::error_code error;
+		if (result != 0 || !fs::exists(file, error))
+			return;
+		out_bytes += fs::file_size(file, error);
+		out_outputs += out_outputs.empty() ? name : std::string(",") + name;
+	};
+
+	produced(export_simple_mesh(src.c_str(), (stem + ".mesh").c_str()), stem + ".mesh", "mesh");
+	produced(export_materials(src.c_str(), (stem + ".mats").c_str()), stem + ".mats", "mats");
+	produced(export_animation_tracks(src.c_str(), (stem + ".tanim").c_str()), stem + ".tanim", "tanim");
+
+	if (out_outputs.empty())
+		return -1;
+
+	uint64_t skeleton_hash = 0;
+	if (export_skeleton(src.c_str(), config.out_dir.string().c_str(), &skeleton_hash) == 0)
+		out_outputs += ",skel";
+
+	return 0;
+}
+
+void Write_Result(std::ofstream& log, const asset_result& r)
+{
+	log << r.key << '\t' << r.status << '\t' << r.attempt << '\t' << r.seconds << '\t' << r.bytes << '\t'
+		<< (r.outputs.empty() ? "-" : r.outputs) << '\t' << r.worker << '\t' << r.path << '\n';
+	log.flush();
+}
+
+bool Read_Result(const std::string& line, asset_result& out_result)
+{
+	std::stringstream fields(line);
+	std::string attempt, seconds, bytes;
+	if (!std::getline(fields, out_result.key, '\t') || !std::getline(fields, out_result.status, '\t')
+		|| !std::getline(fields, attempt, '\t') || !std::getline(fields, seconds, '\t') || !std::getline(fields, bytes, '\t')
+		|| !std::getline(fields, out_result.outputs, '\t') || !std::getline(fields, out_result.worker, '\t')
+		|| !std::getline(fields, out_result.path))
+		return false;
+	out_result.attempt = std::atoi(attempt.c_str());
+	out_result.seconds = std::atof(seconds.c_str());
+	out_result.bytes = std::strtoull(bytes.c_str(), nullptr, 10);
+	return true;
+}
+#pragma endregion
+
+#pragma region MODES
+int Prepare_Work_Dir(const driver_config& config)
+{
+	std::error_code error;
+	for (const char* dir : { "locks", "done", "logs" })
+		fs::create_directories(config.work_dir / dir, error);
+	fs::create_directories(config.out_dir, error);
+	return fs::is_directory(config.work_dir / "locks") ? 0 : -1;
+}
+
+int Run_Worker(const driver_config& config, const std::vector<asset>& assets)
+{
+	if (Prepare_Work_Dir(config) != 0)
+		return -1;
+
+	std::string worker = Worker_Name();
+	std::ofstream log(config.work_dir / "logs" / (worker + ".tsv"), std::ios::app);
+	if (!log.is_open())
+		return -1;
+
+	// own shard first, then anything the others haven't got to or left behind when they died
+	std::vector<const asset*> queue;
+	for (auto& a : assets)
+		if (a.shard == config.shard)
+			queue.push_back(&a);
+	if (config.steal)
+	{
+		for (int s = 1; s < config.shard_count; ++s)
+			for (auto& a : assets)
+				if (a.shard == (config.shard + s) % config.shard_count)
+					queue.push_back(&a);
+	}
+
+	int converted = 0, failed = 0;
+	for (const asset* a : queue)
+	{
+		std::error_code error;
+		if (fs::exists(Done_Path(config, *a), error))
+			continue;
+
+		lock_state lock;
+		e_claim claim = Claim_Asset(config, *a, worker, lock);
+		if (claim == CLAIM_HELD)
+			continue;
+		// the lock may have been released just before we got it
+		if (fs::exists(Done_Path(config, *a), error))
+		{
+			fs::remove(lock.path, error);
+			continue;
+		}
+
+		asset_result result;
+		result.key = Key_String(a->key);
+		result.worker = worker;
+		result.path = a->path;
+		result.attempt = lock.attempt;
+
+		if (claim == CLAIM_EXHAUSTED)
+		{
+			// every earlier attempt took its worker down with it
+			result.status = "crashed";
+			result.attempt = config.attempts;
+		}
+		else
+		{
+			lock_heartbeat heartbeat(lock.path, config.lock_timeout);
+			auto start = std::chrono::steady_clock::now();
+			int status = -1;
+			for (; result.attempt <= config.attempts; ++result.attempt)
+			{
+				status = Convert_Asset(config, *a, result.bytes, result.outputs);
+				if (status == 0)
+					break;
+			}
+			result.attempt = std::min(result.attempt, config.attempts);
+			result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			result.status = status == 0 ? "ok" : "failed";
+		}
+
+		Write_Result(log, result);
+		Write_Text_Atomic(Done_Path(config, *a), result.status + "\n", worker);
+		fs::remove(lock.path, error);
+
+		if (result.status == "ok")
+			++converted;
+		else
+			++failed;
+		std::cout << result.status << '\t' << a->path << std::endl;
+	}
+
+	std::cout << worker << ": " << converted << " converted, " << failed << " failed" << std::endl;
+	return failed == 0 ? 0 : -1;
+}
+
+int Merge_Logs(const driver_config& config, const std::vector<asset>& assets)
+{
+	// the last line per asset wins, a success always beats a failure
+	std::map<std::string, asset_result> results;
+	std::error_code error;
+	for (auto& entry : fs::directory_iterator(config.work_dir / "logs", error))
+	{
+		if (entry.path().extension() != ".tsv")
+			continue;
+		std::ifstream log(entry.path());
+		std::string line;
+		asset_result result;
+		while (std::getline(log, line))
+		{
+			if (!Read_Result(line, result))
+				continue;
+			auto found = results.find(result.key);
+			if (found == results.end() || found->second.status != "ok")
+				results[result.key] = result;
+		}
+	}
+
+	std::ofstream merged(config.work_dir / "results.tsv", std::ios::trunc);
+	if (!merged.is_open())
+		return -1;
+	merged << "key\tstatus\tattempt\tseconds\tbytes\toutputs\tworker\tpath\n";
+
+	int ok = 0, failed = 0, missing = 0;
+	double seconds = 0.0;
+	uint64_t bytes = 0;
+	for (auto& a : assets)
+	{
+		auto found = results.find(Key_String(a.key));
+		if (found == results.end())
+		{
+			asset_result result;
+			result.key = Key_String(a.key);
+			result.status = "missing";
+			result.worker = "-";
+			result.path = a.path;
+			Write_Result(merged, result);
+			++missing;
+			continue;
+		}
+		Write_Result(merged, found->second);
+		if (found->second.status == "ok")
+			++ok;
+		else
+			++failed;
+		seconds += found->second.seconds;
+		bytes += found->second.bytes;
+	}
+
+	std::cout << assets.size() << " assets: " << ok << " ok, " << failed << " failed, " << missing << " missing, "
+		<< seconds << " s of conversion, " << bytes << " bytes written" << std::endl;
+	return failed == 0 && missing == 0 ? 0 : -1;
+}
+
+// One worker process per shard, each one its own copy of this program
+int Run_Local(const driver_config& config, const std::vector<asset>& assets, const char* self)
+{
+	if (Prepare_Work_Dir(config) != 0)
+		return -1;
+
+	std::string common = " worker --manifest " + Quote(config.manifest.string()) + " --work " + Quote(config.work_dir.string())
+		+ " --out " + Quote(config.out_dir.string()) + " --shards " + std::to_string(config.shard_count)
+		+ " --by " + (config.by_size ? "size" : "hash") + " --lock-timeout " + std::to_string(config.lock_timeout)
+		+ " --attempts " + std::to_string(config.attempts) + (config.steal ? "" : " --no-steal") + (config.dry_run ? " --dry-run" : "");
+
+	std::vector<std::thread> workers;
+	for (int s = 0; s < config.shard_count; ++s)
+	{
+		std::string command = Quote(self) + common + " --shard " + std::to_string(s);
+#ifdef _WIN32
+		// cmd strips the outer pair of quotes
+		command = "\"" + command + "\"";
+#endif
+		workers.emplace_back([command] { std::system(command.c_str()); });
+	}
+	for (auto& worker : workers)
+		worker.join();
+
+	return Merge_Logs(config, assets);
+}
+#pragma endregion
+
+int Parse_Arguments(int argc, char** argv, driver_config& out_config)
+{
+	if (argc < 2)
+		return -1;
+	out_config.mode = argv[1];
+
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--no-steal")
+		{
+			out_config.steal = false;
+			continue;
+		}
+		if (arg == "--dry-run")
+		{
+			out_config.dry_run = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+			return -1;
+		std::string value = argv[++i];
+
+		if (arg == "--manifest")
+			out_config.manifest = value;
+		else if (arg == "--work")
+			out_config.work_dir = value;
+		else if (arg == "--out")
+			out_config.out_dir = value;
+		else if (arg == "--shards")
+			out_config.shard_count = std::max(1, std::atoi(value.c_str()));
+		else if (arg == "--shard")
+			out_config.shard = std::atoi(value.c_str());
+		else if (arg == "--by")
+			out_config.by_size = value == "size";
+		else if (arg == "--lock-timeout")
+			out_config.lock_timeout = std::max(1, std::atoi(value.c_str()));
+		else if (arg == "--attempts")
+			out_config.attempts = std::max(1, std::atoi(value.c_str()));
+		else
+			return -1;
+	}
+
+	if (out_config.out_dir.empty())
+		out_config.out_dir = out_config.work_dir / "out";
+	return out_config.manifest.empty() ? -1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+	driver_config config;
+	if (Parse_Arguments(argc, argv, config) != 0)
+	{
+		std::cerr << "usage: FBXExport_DRIVER run|worker|merge|shards --manifest FILE [--work DIR] [--out DIR] [--shards N] [--shard I]"
+			" [--by hash|size] [--lock-timeout S] [--attempts N] [--no-steal] [--dry-run]" << std::endl;
+		return 2;
+	}
+
+	std::vector<asset> assets;
+	if (Read_Manifest(config, assets) != 0)
+	{
+		std::cerr << "can't read " << config.manifest << std::endl;
+		return 2;
+	}
+	Assign_Shards(assets, config.shard_count, config.by_size);
+
+	int result = -1;
+	if (config.mode == "run")
+	{
+		// the workers are started through the shell, which may not find a relative argv[0]
+		std::error_code error;
+		std::string self = fs::absolute(argv[0], error).string();
+		if (!fs::exists(self, error))
+			self = argv[0];
+		result = Run_Local(config, assets, self.c_str());
+	}
+	else if (config.mode == "worker")
+	{
+		if (config.shard < 0 || config.shard >= config.shard_count)
+		{
+			std::cerr << "worker needs --shard between 0 and " << config.shard_count - 1 << std::endl;
+			return 2;
+		}
+		result = Run_Worker(config, assets);
+	}
+	else if (config.mode == "merge")
+	{
+		result = Merge_Logs(config, assets);
+	}
+	else if (config.mode == "shards")
+	{
+		for (auto& a : assets)
+			std::cout << a.shard << '\t' << Key_String(a.key) << '\t' << a.size << '\t' << a.path << '\n';
+		result = 0;
+	}
+	else
+	{
+		std::cerr << "unknown mode " << config.mode << std::endl;
+		return 2;
+	}
+
+	return result == 0 ? 0 : 1;
+}
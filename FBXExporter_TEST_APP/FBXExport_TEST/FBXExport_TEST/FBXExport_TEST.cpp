@@ -2,10 +2,14 @@
 //
 
 #include <iostream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
 #include <filesystem>
 #include "FBX_Export_Interface.h"
 
 std::string replaceExt(std::string& s, const std::string& newExt);
+bool sameFileContents(const std::string& a, const std::string& b);
 
 int main()
 {
@@ -24,6 +28,15 @@ int main()
 			else
 				std::cout << newFileName + " did NOT export successfully" << std::endl;
 
+			// the streamed export has to write the same file, Crate.fbx covers a static mesh without skeleton or skin
+			std::string streamedFileName = newFileName + ".streamed";
+			if (result == 0 && export_simple_mesh_streamed(entry.path().string().c_str(), streamedFileName.c_str()) == 0
+				&& sameFileContents(newFileName, streamedFileName))
+				std::cout << streamedFileName + " matches SUCCESSFULLY" << std::endl;
+			else
+				std::cout << streamedFileName + " does NOT match" << std::endl;
+			std::filesystem::remove(streamedFileName);
+
 			newFileName = entry.path().string();
 			replaceExt(newFileName, "mats");
 			result = export_materials(entry.path().string().c_str(), newFileName.c_str());
@@ -39,6 +52,21 @@ int main()
 				std::cout << newFileName + " exported SUCCESSFULLY" << std::endl;
 			else
 				std::cout << newFileName + " did NOT export successfully" << std::endl;
+
+			uint64_t skeletonHash = 0;
+			result = export_skeleton(entry.path().string().c_str(), ".", &skeletonHash);
+			if (result == 0)
+				std::cout << "skeleton " << std::hex << skeletonHash << std::dec << " exported SUCCESSFULLY" << std::endl;
+			else
+				std::cout << entry.path().string() + " skeleton did NOT export successfully" << std::endl;
+
+			newFileName = entry.path().string();
+			replaceExt(newFileName, "tanim");
+			result = export_animation_tracks(entry.path().string().c_str(), newFileName.c_str());
+			if (result == 0)
+				std::cout << newFileName + " exported SUCCESSFULLY" << std::endl;
+			else
+				std::cout << newFileName + " did NOT export successfully" << std::endl;
 		}
 	}
 	system("pause");
@@ -54,3 +82,12 @@ std::string replaceExt(std::string& s, const std::string& newExt) {
 	}
 	return s;
 }
+
+bool sameFileContents(const std::string& a, const std::string& b)
+{
+	std::ifstream fileA(a, std::ios::binary), fileB(b, std::ios::binary);
+	if (!fileA.is_open() || !fileB.is_open())
+		return false;
+	return std::equal(std::istreambuf_iterator<char>(fileA), std::istreambuf_iterator<char>(),
+		std::istreambuf_iterator<char>(fileB), std::istreambuf_iterator<char>());
+}
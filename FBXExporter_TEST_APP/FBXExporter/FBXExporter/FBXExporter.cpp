@@ -1,39 +1,282 @@
 #include "pch.h"
 #include "./Interface/FBX_Export_Interface.h"
 #include "FBX_Utilities.h"
+#include "fnv1a.h"
+#include "profiler.h"
+#include "export_progress.h"
+#include "mesh_instances.h"
+#include "morph_targets.h"
+#include "vertex_layout.h"
+#include "collision.h"
+#include "scene_cache.h"
+#include "vertex_streams.h"
+#include "mesh_selection.h"
+#include "import_source.h"
+#include "anim_bounds.h"
 
 #include <vector>
 #include <fstream>
 #include <list>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_set>
+#include <unordered_map>
+#include <filesystem>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <system_error>
+#include <chrono>
+#include <climits>
+#include <cstring>
 
 
 namespace FBXUtils
 {
+	namespace
+	{
+		std::atomic<bool> keep_warm{ false };
+
+		// the calling thread's manager and last scene while warm
+		struct warm_import
+		{
+			FbxManager* manager = nullptr;
+			FbxScene* scene = nullptr;
+			std::string path;
+			std::filesystem::file_time_type write_time;
+			uintmax_t size = 0;
+			uint64_t blob_generation = 0;			// of the registered blob the scene was imported from, 0 for a file
+			FbxAnimStack* current_stack = nullptr;	// exporting tracks switches stacks, put back on reuse
+
+			void Release()
+			{
+				if (manager)
+					manager->Destroy();
+				manager = nullptr;
+				scene = nullptr;
+				path.clear();
+			}
+
+			~warm_import() { Release(); }
+		};
+		thread_local warm_import warm;
+
+		// bumped by every import on this thread, a new scene can land where the last one was freed
+		thread_local uint64_t import_generation = 0;
+
+		FbxManager* Create_Manager()
+		{
+			// Initialize the SDK manager. This object handles all our memory management.
+			FbxManager* lSdkManager = FbxManager::Create();
+			// Create the IO settings object.
+			FbxIOSettings* IOs = FbxIOSettings::Create(lSdkManager, IOSROOT);
+			lSdkManager->SetIOSettings(IOs);
+			return lSdkManager;
+		}
+
+		bool Import_Progress(void* /*args*/, float percentage, const char* /*status*/)
+		{
+			// returning false stops the import
+			return !end::Export_Checkpoint("import", static_cast<size_t>(percentage), 100);
+		}
+
+		// Read only FbxStream over bytes already in memory, a mapped file or a caller's blob.
+		// The 2019 sdk seeks with a long, the bytes can't be more than LONG_MAX
+		class memory_stream : public FbxStream
+		{
+		public:
+			memory_stream(const uint8_t* data, uint64_t size, int reader_id)
+				: data(data), size(size), reader_id(reader_id) {}
+
+			EState GetState() override { return open ? eOpen : eClosed; }
+			bool Open(void* /*pStreamData*/) override
+			{
+				open = true;
+				position = 0;
+				return true;
+			}
+			bool Close() override
+			{
+				open = false;
+				return true;
+			}
+			bool Flush() override { return true; }
+			int Write(const void* /*pData*/, int /*pSize*/) override { return 0; }
+			int Read(void* pData, int pSize) const override
+			{
+				if (!open || pSize <= 0)
+					return 0;
+				uint64_t count = std::min<uint64_t>(static_cast<uint64_t>(pSize), size - position);
+				memcpy(pData, data + position, static_cast<size_t>(count));
+				position += count;
+				return static_cast<int>(count);
+			}
+			int GetReaderID() const override { return reader_id; }
+			int GetWriterID() const override { return -1; }
+			void Seek(const FbxInt64& pOffset, const FbxFile::ESeekPos& pSeekPos) override
+			{
+				FbxInt64 origin = pSeekPos == FbxFile::eBegin ? 0 : pSeekPos == FbxFile::eCurrent ? static_cast<FbxInt64>(position) : static_cast<FbxInt64>(size);
+				SetPosition(static_cast<long>(origin + pOffset));
+			}
+			long GetPosition() const override { return static_cast<long>(position); }
+			void SetPosition(long pPosition) override
+			{
+				position = std::min<uint64_t>(static_cast<uint64_t>(std::max(pPosition, 0L)), size);
+			}
+			int GetError() const override { return 0; }
+			void ClearError() override {}
+
+		private:
+			const uint8_t* data;
+			uint64_t size;
+			mutable uint64_t position = 0;
+			int reader_id;
+			bool open = false;
+		};
+
+		bool Has_Fbx_Extension(const char* fbx_file_path)
+		{
+			std::string extension = std::filesystem::path(fbx_file_path).extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+			return extension == ".fbx";
+		}
+
+		FbxScene* Import_Scene(FbxManager* lSdkManager, const char* fbx_file_path)
+		{
+			// Create an importer using the SDK manager.
+			FbxImporter* lImporter = FbxImporter::Create(lSdkManager, "");
+
+			// The sdk reads a registered blob or the mapped file through a memory_stream rather than doing its own small reads.
+			// Only its fbx reader takes a stream, other formats and files it can't be given whole still go by path
+			end::import_blob blob;
+			end::mapped_file mapped;
+			const uint8_t* bytes = nullptr;
+			uint64_t byte_count = 0;
+			std::error_code error;
+			if (end::Find_Import_Blob(fbx_file_path, blob))
+			{
+				if (blob.size > static_cast<uint64_t>(LONG_MAX))
+				{
+					lImporter->Destroy();
+					return nullptr;
+				}
+				bytes = blob.data;
+				byte_count = blob.size;
+			}
+			else if (Has_Fbx_Extension(fbx_file_path) && std::filesystem::file_size(fbx_file_path, error) <= static_cast<uintmax_t>(LONG_MAX) &&
+				!error && end::Map_File(fbx_file_path, mapped) == 0)
+			{
+				bytes = mapped.data;
+				byte_count = mapped.size;
+			}
+
+			int fbx_reader = lSdkManager->GetIOPluginRegistry()->FindReaderIDByExtension("fbx");
+			memory_stream stream(bytes, byte_count, fbx_reader);
+			// Use the first argument as the filename for the importer.
+			bool initialized = bytes ? lImporter->Initialize(&stream, nullptr, fbx_reader, lSdkManager->GetIOSettings())
+				: lImporter->Initialize(fbx_file_path, -1, lSdkManager->GetIOSettings());
+			if (!initialized)
+			{
+				//printf("Call to FbxImporter::Initialize() failed.\n");
+				//printf("Error returned: %s\n\n", lImporter->GetStatus().GetErrorString());
+				lImporter->Destroy();
+				return nullptr;
+			}
+			// Create a new scene so that it can be populated by the imported file.
+			FbxScene* lScene = FbxScene::Create(lSdkManager, "imported_scene");
+			// Import the contents of the file into the scene.
+			lImporter->SetProgressCallback(Import_Progress);
+			lImporter->Import(lScene);
+			lImporter->Destroy();
+			if (end::Export_Cancelled())
+			{
+				lScene->Destroy();
+				return nullptr;
+			}
+			++import_generation;
+			return lScene;
+		}
+	}
+
 	FbxManager* Create_and_Import(const char* fbx_file_path, FbxScene*& lScene)
 	{
-		// Initialize the SDK manager. This object handles all our memory management.
-		FbxManager* lSdkManager = FbxManager::Create();
-		// Create the IO settings object.
-		FbxIOSettings* IOs = FbxIOSettings::Create(lSdkManager, IOSROOT);
-		lSdkManager->SetIOSettings(IOs);
-		// Create an importer using the SDK manager.
-		FbxImporter* lImporter = FbxImporter::Create(lSdkManager, "");
-		// Use the first argument as the filename for the importer.
-		if (!lImporter->Initialize(fbx_file_path, -1, lSdkManager->GetIOSettings())) 
-		{
-			//printf("Call to FbxImporter::Initialize() failed.\n");
-			//printf("Error returned: %s\n\n", lImporter->GetStatus().GetErrorString());
+		FBX_PROFILE_SCOPE(scope, "import");
+		if (!keep_warm)
+		{
+			// a thread that was warm before the switch gives its manager back on its next export
+			warm.Release();
+
+			FbxManager* lSdkManager = Create_Manager();
+			lScene = Import_Scene(lSdkManager, fbx_file_path);
+			if (!lScene)
+			{
+				lSdkManager->Destroy();
+				return nullptr;
+			}
+			FBX_PROFILE_ITEMS(scope, 1, lScene->GetNodeCount());
+			return lSdkManager;
+		}
+
+		// a blob is the same scene for as long as it's registered, a file for as long as it's unchanged on disk
+		end::import_blob blob;
+		std::error_code error;
+		std::filesystem::file_time_type write_time;
+		uintmax_t size = 0;
+		if (end::Find_Import_Blob(fbx_file_path, blob))
+			size = blob.size;
+		else
+		{
+			write_time = std::filesystem::last_write_time(fbx_file_path, error);
+			size = error ? 0 : std::filesystem::file_size(fbx_file_path, error);
+		}
+		if (warm.scene && !error && warm.path == fbx_file_path && warm.write_time == write_time && warm.size == size && warm.blob_generation == blob.generation)
+		{
+			// same file as last time, nothing to import
+			lScene = warm.scene;
+			lScene->SetCurrentAnimationStack(warm.current_stack);
+			FBX_PROFILE_ITEMS(scope, 0, lScene->GetNodeCount());
+			return warm.manager;
+		}
+
+		if (!warm.manager)
+			warm.manager = Create_Manager();
+		if (warm.scene)
+			warm.scene->Destroy();
+		warm.scene = nullptr;
+		warm.path.clear();
+
+		lScene = Import_Scene(warm.manager, fbx_file_path);
+		if (!lScene)
 			return nullptr;
+		if (!error)
+		{
+			warm.scene = lScene;
+			warm.path = fbx_file_path;
+			warm.write_time = write_time;
+			warm.size = size;
+			warm.blob_generation = blob.generation;
+			warm.current_stack = lScene->GetCurrentAnimationStack();
+		}
+		FBX_PROFILE_ITEMS(scope, 1, lScene->GetNodeCount());
+		return warm.manager;
+	}
+
+	void Release_Import(FbxManager* manager, FbxScene* scene)
+	{
+		if (manager == warm.manager)
+		{
+			// a scene that couldn't be stamped isn't kept for the next export
+			if (scene && scene != warm.scene)
+				scene->Destroy();
+			return;
 		}
-		// Create a new scene so that it can be populated by the imported file.
-		lScene = FbxScene::Create(lSdkManager, "imported_scene");
-		// Import the contents of the file into the scene.
-		lImporter->Import(lScene);
-		lImporter->Destroy();
-		return lSdkManager;
+		manager->Destroy();
 	}
 
-	void ReadNormals(fbxsdk::FbxMesh* pMesh, int inVertexCount, int inPointIndex, DirectX::XMFLOAT3& out_norm)
+	void ReadNormals(fbxsdk::FbxGeometryBase* pMesh, int inVertexCount, int inPointIndex, DirectX::XMFLOAT3& out_norm)
 	{
 		// get pMesh normals
 		// get normal element
@@ -162,220 +405,190 @@ namespace FBXUtils
 	//	2.Extract vertex data from the mesh and store the data in a 'simple_mesh' object or similar
 	//		a. SEE "EXPORTING GUIDE.PDF" for pseudocode and in-depth explaination
 	//		a. See SDK example code VBOMesh::Initialize() in <FbxSDK Directory>\Samples\ViewScene\SceneCache.cxx
-	int Process_Mesh(FbxNode* Node, const char* output_file_path)
+	int Read_Skin_Clusters(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, std::vector<end::skin_cluster>& clusters)
 	{
-		int result = -1;
-		int chidlrenCount = Node->GetChildCount();
+		#pragma region ANIMATION SKINNING
+		// Animation Skinning===========================================
+		clusters.clear();
+		FbxGeometry* geo = (FbxGeometry*)pMesh;
+		if (!geo) return -1;
 
-		int pose_count = FBXUtils::Scene->GetPoseCount();
-		FbxPose* pose = nullptr;
-		for (int i = 0; i < pose_count; ++i)
-		{
-			pose = FBXUtils::Scene->GetPose(i);
-			if (pose->IsBindPose())
-				break;
-		}
-		if (!pose || !pose->IsBindPose())
-			return -1;
+		// find deformer
+		int deformerCount = geo->GetDeformerCount(FbxDeformer::EDeformerType::eSkin);
 
-		for (int i = 0; i < chidlrenCount; i++)
+		for (int deformerIndex = 0; deformerIndex < deformerCount; ++deformerIndex)
 		{
-			FbxNode* childNode = Node->GetChild(i);
-			FbxMesh* pMesh = childNode->GetMesh();
+			FbxDeformer* deformer = geo->GetDeformer(deformerIndex, FbxDeformer::EDeformerType::eSkin);
+			if (!deformer) return -1;
 
-			if (pMesh)
+			FbxSkin* skin = (FbxSkin*)deformer;
+			if (!skin) return -1;
+
+			// get clusters
+			int clusterCount = skin->GetClusterCount();
+			for (int clusterIndex = 0; clusterIndex < clusterCount; ++clusterIndex)
 			{
-				std::vector<end::simple_vert> output;
-				
-				// number of polygons in pMesh
-				int poly_count = pMesh->GetPolygonCount();
-				// number of vertices per polygon
-				int numIndices = pMesh->GetPolygonVertexCount();
-				// index list for vertices
-				int* vert_indices = pMesh->GetPolygonVertices();
-				// the vertex positions
-				FbxVector4 const* control_points = pMesh->GetControlPoints();
+				FbxCluster* cluster = skin->GetCluster(clusterIndex);
+				FbxNode* linkNode = cluster->GetLink();
+				size_t jointCount = JointNodes.size();
+				size_t jointIndex = 0;
 
-				#pragma region ANIMATION SKINNING
-				// Animation Skinning===========================================
-				const int MAX_INFLUENCES = 4; // max number of joints influencing a single vertex
-				struct influence { int joint; float weight; };
-				using influence_set = std::array<influence, MAX_INFLUENCES>;
-				std::vector<influence_set> control_point_influences;
-
-				//// find bind pose
-				//int pose_count = FBXUtils::Scene->GetPoseCount();
-				//FbxPose* pose = nullptr;
-				//for (int i = 0; i < pose_count; ++i)
-				//{
-				//	pose = FBXUtils::Scene->GetPose(i);
-				//	if (pose->IsBindPose())
-				//		break;
-				//}
-				//if (!pose || !pose->IsBindPose())
-				//	return -1;
-
-				// find Skeleton
-				int numItems = pose->GetCount();
-				FbxSkeleton* skeleton = nullptr;
-				for (int i = 0; i < numItems; ++i)
-				{
-					skeleton = pose->GetNode(i)->GetSkeleton();
-					if (skeleton && skeleton->IsSkeletonRoot())
+				// find joint index
+				for (; jointIndex < jointCount; ++jointIndex)
+				{
+					if (linkNode == JointNodes[jointIndex].node)
 						break;
 				}
-				if (!skeleton || !skeleton->IsSkeletonRoot())
-					return -1;
 
-				std::vector<end::myJoint> JointNodes;
+				end::skin_cluster out_cluster;
+				out_cluster.joint = static_cast<int>(jointIndex);
+				int ctrl_pnt_count = cluster->GetControlPointIndicesCount();
+				out_cluster.control_points.assign(cluster->GetControlPointIndices(), cluster->GetControlPointIndices() + ctrl_pnt_count);
+				out_cluster.weights.resize(ctrl_pnt_count);
+				for (int c = 0; c < ctrl_pnt_count; ++c)
+					out_cluster.weights[c] = (float)cluster->GetControlPointWeights()[c];
+				clusters.push_back(std::move(out_cluster));
+			}
+		}
+		#pragma endregion
+		return 0;
+	}
 
-				end::myJoint root;
-				root.node = skeleton->GetNode(0);
-				root.parent_index = -1;
-				JointNodes.push_back(root);
+	int Read_Skin(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, std::pmr::vector<end::influence_set>& out_influences)
+	{
+		std::vector<end::skin_cluster> clusters;
+		if (Read_Skin_Clusters(pMesh, JointNodes, clusters) != 0)
+			return -1;
+		end::Bind_Skin(clusters, pMesh->GetControlPointsCount(), out_influences);
+		return 0;
+	}
 
-				// traverse skeleton tree to get all joints
-				for (size_t i = 0; i < JointNodes.size(); ++i)
-				{
-					int childrenCount = JointNodes[i].node->GetChildCount();
-					for (int j = 0; j < childrenCount; ++j)
-					{
-						auto child = JointNodes[i].node->GetChild(j);
-						if (child->GetNodeAttribute()
-							&& child->GetNodeAttribute()->GetAttributeType()
-							&& child->GetNodeAttribute()->GetAttributeType() == FbxNodeAttribute::eSkeleton
-							)
-						{
-							end::myJoint childJoint;
-							childJoint.node = child;
-							childJoint.parent_index = i;
-							JointNodes.push_back(childJoint);
-						}
-					}
-				}
+	int Read_Influences(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, std::pmr::vector<end::influence_set>& out_influences)
+	{
+		if (!JointNodes.empty() && pMesh->GetDeformerCount(FbxDeformer::EDeformerType::eSkin) > 0)
+			return Read_Skin(pMesh, JointNodes, out_influences);
 
-				// Find mesh
-				//FbxMesh* mesh = nullptr;
-				//for (int i = 0; i < numItems; ++i)
-				//{
-				//	FbxNode* node = pose->GetNode(i);
-				//	mesh = node->GetMesh();
-				//	if (!mesh)
-				//		return -1;
-				//	else
-				//		break; // for now
-				//}
-				control_point_influences.resize(pMesh->GetControlPointsCount());
-				FbxGeometry* geo = (FbxGeometry*)pMesh;
-				if (!geo) return -1;
-
-				// find deformer
-				int deformerCount = geo->GetDeformerCount(FbxDeformer::EDeformerType::eSkin);
-
-				for (int deformerIndex = 0; deformerIndex < deformerCount; ++deformerIndex)
-				{
-					FbxDeformer* deformer = geo->GetDeformer(deformerIndex, FbxDeformer::EDeformerType::eSkin);
-					if (!deformer) return -1;
-
-					FbxSkin* skin = (FbxSkin*)deformer;
-					if (!skin) return -1;
-
-					// get clusters
-					int clusterCount = skin->GetClusterCount();
-					for (int clusterIndex = 0; clusterIndex < clusterCount; ++clusterIndex)
-					{
-						FbxCluster* cluster = skin->GetCluster(clusterIndex);
-						FbxNode* linkNode = cluster->GetLink();
-						size_t jointCount = JointNodes.size();
-						size_t jointIndex = 0;
+		// nothing deforms it, the whole mesh follows the first joint
+		end::influence_set rigid;
+		rigid[0].weight = 1.0f;
+		out_influences.assign(pMesh->GetControlPointsCount(), rigid);
+		return 0;
+	}
 
-						// find joint index
-						for (; jointIndex < jointCount; ++jointIndex)
-						{
-							if (linkNode == JointNodes[jointIndex].node)
-								break;
-						}
-						// get the influences for the control points
-						size_t ctrl_pnt_count = cluster->GetControlPointIndicesCount();
-						for (size_t c = 0; c < ctrl_pnt_count; ++c)
-						{
-							influence inf_to_add;
-							inf_to_add.joint = jointIndex;
-							inf_to_add.weight = (float)cluster->GetControlPointWeights()[c];
-							// potentially doing this wrong 
-							influence_set& inf_set = control_point_influences[cluster->GetControlPointIndices()[c]];
-							for (size_t inf = 0; inf < MAX_INFLUENCES; ++inf)
-							{
-								// if this one is stronger than any other kick out the weakest
-								if (inf_to_add.weight - inf_set[inf].weight > 0.0001f)
-								{
-									inf_set[inf] = inf_to_add;
-									break;
-								}
-							}
-						}
-					}
-				}
-				#pragma endregion
+	int Weld_Mesh(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, end::raw_mesh& raw, end::mesh_buffers& out_mesh)
+	{
+		if (Read_Raw_Mesh(pMesh, JointNodes, raw) != 0)
+			return -1;
+
+		return Weld_Raw_Mesh(raw, out_mesh);
+	}
+
+	int Read_Raw_Mesh(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, end::raw_mesh& raw)
+	{
+		// number of polygons in pMesh
+		int poly_count = pMesh->GetPolygonCount();
+		// the vertex positions
+		FbxVector4 const* control_points = pMesh->GetControlPoints();
+		int control_point_count = pMesh->GetControlPointsCount();
+		size_t corner_count = 3 * static_cast<size_t>(poly_count);
+
+		// copy out everything the sdk owns, the rest of the pipeline runs on plain data
+		{
+			FBX_PROFILE_SCOPE(read_scope, "read_mesh");
+			raw.control_points.resize(control_point_count);
+			for (int c = 0; c < control_point_count; ++c)
+			{
+				raw.control_points[c] = {
+					static_cast<float>(control_points[c].mData[0]),
+					static_cast<float>(control_points[c].mData[1]),
+					static_cast<float>(control_points[c].mData[2]),
+					1.0f
+				};
+			}
+
+			if (Read_Influences(pMesh, JointNodes, raw.influences) != 0)
+				return -1;
 
-				// for each polygon of the Mesh
-				for (int tri = 0; tri < poly_count; ++tri)
+			// for each polygon of the Mesh
+			raw.polygon_vertices.resize(corner_count);
+			raw.normals.resize(corner_count);
+			raw.uvs.resize(corner_count);
+			for (int tri = 0; tri < poly_count; ++tri)
+			{
+				if ((tri & 1023) == 0 && end::Export_Checkpoint("read_mesh", tri, poly_count))
+					return -1;
+				// for each vertex of the polygon
+				for (int v = 0; v < 3; ++v)
 				{
-					// for each vertex of the polygon
-					for (int v = 0; v < 3; ++v)
-					{
-						// the current vertex we are writing to
-						end::simple_vert out_vert;
+					int corner = tri * 3 + v;
+					int ctrlPointIndex = pMesh->GetPolygonVertex(tri, v);
+					raw.polygon_vertices[corner] = ctrlPointIndex;
 
-						int ctrlPointIndex = pMesh->GetPolygonVertex(tri, v);
+					// get normals
+					ReadNormals(pMesh, corner, ctrlPointIndex, raw.normals[corner]);
 
-						// get pMesh positions
-						FbxVector4 position = control_points[ctrlPointIndex];
-						out_vert.pos.x = static_cast<float>(position.mData[0]);
-						out_vert.pos.y = static_cast<float>(position.mData[1]);
-						out_vert.pos.z = static_cast<float>(position.mData[2]);
-						out_vert.pos.w = 1.0f;
+					// get pMesh UVs
+					ReadUVs(pMesh, corner, ctrlPointIndex, raw.uvs[corner]);
+				}
+			}
+			end::Export_Checkpoint("read_mesh", poly_count, poly_count);
+			FBX_PROFILE_ITEMS(read_scope, control_point_count, corner_count);
+		}
 
+		return 0;
+	}
 
-						#pragma region ANIMATION SKINNING
-						influence_set& inf_set = control_point_influences[ctrlPointIndex];
-						for (size_t i = 0; i < 4; ++i)
-						{
-							out_vert.joint_index[i] = inf_set[i].joint;
-							out_vert.weights[i] = inf_set[i].weight;
-						}
-						float sum = out_vert.weights[0] + out_vert.weights[1] + out_vert.weights[2] + out_vert.weights[3];
-						for (size_t i = 0; i < 4; ++i)
-						{
-							out_vert.weights[i] /= sum;
-						}
-						#pragma	endregion
+	int Weld_Raw_Mesh(const end::raw_mesh& raw, end::mesh_buffers& out_mesh)
+	{
+		end::Expand_Vertices(raw, out_mesh);
+		end::Compactify(out_mesh);
+		if (end::Export_Cancelled())
+			return -1;
+		for (auto& vert : out_mesh.verts)
+		{
+			vert.color = { 0.75f, 0.75f, 0.75f, 1.0f };
+		}
+		return 0;
+	}
 
-						// get normals
-						ReadNormals(pMesh, output.size(), ctrlPointIndex, out_vert.norm);
+	int Process_Mesh(FbxNode* Node, const char* output_file_path)
+	{
+		int result = -1;
+		int chidlrenCount = Node->GetChildCount();
 
-						// get pMesh UVs
-						ReadUVs(pMesh, output.size(), ctrlPointIndex, out_vert.tex_coord);
+		for (int i = 0; i < chidlrenCount; i++)
+		{
+			FbxNode* childNode = Node->GetChild(i);
+			FbxMesh* pMesh = childNode->GetMesh();
 
-						output.push_back(out_vert);
-					}
-				}
-				output.shrink_to_fit();
+			if (pMesh)
+			{
+				FBX_PROFILE_SCOPE(scope, "process_mesh");
+				size_t corner_count = 3 * static_cast<size_t>(pMesh->GetPolygonCount());
 
-				end::simple_mesh out_mesh;
-				out_mesh.index_count = numIndices;
-				out_mesh.indices = (uint32_t*)vert_indices;
-				out_mesh.vert_count = 3 * poly_count;
-				out_mesh.verts = output.data();
+				// every buffer of this mesh comes out of one block sized from the polygon count,
+				// freed at once when the mesh is written
+				std::pmr::monotonic_buffer_resource arena(end::Mesh_Arena_Size(pMesh->GetControlPointsCount(), corner_count));
 
-				Compactify(out_mesh);
-				for (size_t i = 0; i < out_mesh.vert_count; ++i)
+				// the skeleton, with the bind pose the mesh's skin clusters were made against
+				// a scene without one is a static mesh, written rigid and without a skeleton hash
+				std::vector<end::myJoint> JointNodes;
+				uint64_t skeletonHash = 0;
+				if (Build_Joint_List(JointNodes) == 0)
 				{
-					out_mesh.verts[i].color = { 0.75f, 0.75f, 0.75f, 1.0f };
+					end::skeleton skel;
+					Build_Skeleton(JointNodes, skel);
+					skeletonHash = end::Skeleton_Hash(skel);
 				}
-				Export_Mesh_File(out_mesh, output_file_path);
-				delete[] out_mesh.indices;
-				delete[] out_mesh.verts;
+				else
+					JointNodes.clear();
+
+				end::raw_mesh raw(&arena);
+				end::mesh_buffers out_mesh(&arena);
+				if (Weld_Mesh(pMesh, JointNodes, raw, out_mesh) != 0)
+					return -1;
+				end::Write_Mesh_File(out_mesh.View(), output_file_path, skeletonHash);
+				FBX_PROFILE_ITEMS(scope, pMesh->GetControlPointsCount(), out_mesh.verts.size());
 
 				result = 0;
 			}
@@ -383,131 +596,825 @@ namespace FBXUtils
 		return result;
 	}
 
-	void Compactify(end::simple_mesh& simpleMesh)
+	namespace
 	{
-		std::vector<end::simple_vert> compactedVertexList;
-		std::vector<int> indicesList;
-
-		int compactedIndex = 0;
-		int const table_size = 1024;
-		//std::list<int>* htable = new std::list<int>[table_size];
-
-		for (size_t v = 0; v < simpleMesh.vert_count; ++v)
+		// the mesh name index of the scene imported last on this thread, kept across warm exports of it
+		struct scene_mesh_index
 		{
-			int hash = v % table_size;
-
-			bool match = false;
-			int index = 0;
-			// for each index in the bucket
-			for (auto& vert : compactedVertexList/*auto index : htable[hash]*/) // doesn't work
+			FbxScene* scene = nullptr;
+			uint64_t generation = 0;
+			end::mesh_name_index names;
+			std::vector<FbxNode*> nodes;		// parallel to names.node_names
+		};
+		thread_local scene_mesh_index mesh_index;
+
+		// rebuilds 'mesh_index' unless it's already of the scene imported last
+		void Index_Mesh_Nodes()
+		{
+			if (mesh_index.scene != FBXUtils::Scene || mesh_index.generation != import_generation)
 			{
-				if (	simpleMesh.verts[v].pos.x == vert.pos.x
-					&&	simpleMesh.verts[v].pos.y == vert.pos.y
-					&&	simpleMesh.verts[v].pos.z == vert.pos.z
-					&&	simpleMesh.verts[v].norm.x == vert.norm.x
-					&&	simpleMesh.verts[v].norm.y == vert.norm.y
-					&&	simpleMesh.verts[v].norm.z == vert.norm.z
-					&&	simpleMesh.verts[v].tex_coord.x == vert.tex_coord.x
-					&&	simpleMesh.verts[v].tex_coord.y == vert.tex_coord.y
-					)
+				FBX_PROFILE_SCOPE(scope, "index_mesh_nodes");
+				mesh_index = scene_mesh_index();
+				mesh_index.scene = FBXUtils::Scene;
+				mesh_index.generation = import_generation;
+
+				int node_count = FBXUtils::Scene->GetNodeCount();
+				for (int i = 0; i < node_count; ++i)
 				{
-					indicesList.push_back(index);
-					match = true;
-					break;
+					FbxNode* node = FBXUtils::Scene->GetNode(i);
+					FbxMesh* pMesh = node->GetMesh();
+					if (!pMesh)
+						continue;
+					end::Add_Mesh_Node(mesh_index.names, node->GetName(), pMesh->GetName());
+					mesh_index.nodes.push_back(node);
 				}
-				++index;
-			}
-			if (!match)
-			{
-				compactedVertexList.push_back(simpleMesh.verts[v]);
-				indicesList.push_back(compactedIndex);
-				//htable[hash].push_back(compactedIndex);
-				++compactedIndex;
+				FBX_PROFILE_ITEMS(scope, node_count, mesh_index.nodes.size());
 			}
 		}
+	}
+
+	void Select_Mesh_Nodes(const char* const* patterns, uint32_t pattern_count, std::vector<FbxNode*>& out_nodes)
+	{
+		Index_Mesh_Nodes();
 
-		simpleMesh.indices = nullptr;
-		simpleMesh.indices = new uint32_t[indicesList.size()];
-		simpleMesh.index_count = static_cast<uint32_t>(indicesList.size());
-		memcpy(simpleMesh.indices, indicesList.data(), sizeof(uint32_t) * indicesList.size());
+		std::vector<uint32_t> selected;
+		end::Select_Mesh_Nodes(mesh_index.names, patterns, pattern_count, selected);
+		out_nodes.clear();
+		for (uint32_t node : selected)
+			out_nodes.push_back(mesh_index.nodes[node]);
+	}
 
-		//delete[] simpleMesh.verts;
-		simpleMesh.verts = nullptr;
-		simpleMesh.verts = new end::simple_vert[compactedVertexList.size()];
-		simpleMesh.vert_count = static_cast<uint32_t>(compactedVertexList.size());
-		memcpy(simpleMesh.verts, compactedVertexList.data(), sizeof(end::simple_vert) * compactedVertexList.size());
+	FbxNode* Find_Mesh_Node(const char* name)
+	{
+		Index_Mesh_Nodes();
 
-		//delete[] htable;
+		int64_t node = end::Find_Mesh_Node(mesh_index.names, name);
+		return node < 0 ? nullptr : mesh_index.nodes[(size_t)node];
 	}
 
-	int Process_Animation(const char* output_file_path)
+	int Process_Node_Mesh(FbxNode* Node, const char* output_file_path)
 	{
-		//int result = -1;
-		// find bind pose
-		int pose_count = FBXUtils::Scene->GetPoseCount();
-		FbxPose* pose = nullptr;
-		for (int i = 0; i < pose_count; ++i)
-		{
-			pose = FBXUtils::Scene->GetPose(i);
-			if (pose->IsBindPose())
-				break;
-		}
-		if (!pose || !pose->IsBindPose())
+		FbxMesh* pMesh = Node->GetMesh();
+		if (!pMesh)
 			return -1;
 
-		// find Skeleton
-		int numItems = pose->GetCount();
-		FbxSkeleton* skeleton = nullptr;
-		for (int i = 0; i < numItems; ++i)
+		FBX_PROFILE_SCOPE(scope, "process_mesh");
+		// a prop picked out of a level has no skeleton, it's rigid then
+		std::vector<end::myJoint> JointNodes;
+		uint64_t skeletonHash = 0;
+		if (Build_Joint_List(JointNodes) == 0)
 		{
-			skeleton = pose->GetNode(i)->GetSkeleton();
-			if (skeleton && skeleton->IsSkeletonRoot())
-				break;
+			end::skeleton skel;
+			Build_Skeleton(JointNodes, skel);
+			skeletonHash = end::Skeleton_Hash(skel);
 		}
-		if (!skeleton || !skeleton->IsSkeletonRoot())
+		else
+			JointNodes.clear();
+
+		size_t corner_count = 3 * static_cast<size_t>(pMesh->GetPolygonCount());
+		std::pmr::monotonic_buffer_resource arena(end::Mesh_Arena_Size(pMesh->GetControlPointsCount(), corner_count));
+		end::raw_mesh raw(&arena);
+		end::mesh_buffers out_mesh(&arena);
+		if (Weld_Mesh(pMesh, JointNodes, raw, out_mesh) != 0)
+			return -1;
+
+		bool skinned = !JointNodes.empty() && pMesh->GetDeformerCount(FbxDeformer::EDeformerType::eSkin) > 0;
+		end::Write_Mesh_File(out_mesh.View(), output_file_path, skinned ? skeletonHash : 0);
+		FBX_PROFILE_ITEMS(scope, pMesh->GetControlPointsCount(), out_mesh.verts.size());
+
+		return 0;
+	}
+
+	int Process_Selected_Meshes(const char* const* patterns, uint32_t pattern_count, const char* output_path, bool combined, uint32_t& out_match_count)
+	{
+		FBX_PROFILE_SCOPE(scope, "process_selected_meshes");
+		std::vector<FbxNode*> nodes;
+		Select_Mesh_Nodes(patterns, pattern_count, nodes);
+		out_match_count = static_cast<uint32_t>(nodes.size());
+		if (nodes.empty())
 			return -1;
 
 		std::vector<end::myJoint> JointNodes;
+		uint64_t skeletonHash = 0;
+		if (Build_Joint_List(JointNodes) == 0)
+		{
+			end::skeleton skel;
+			Build_Skeleton(JointNodes, skel);
+			skeletonHash = end::Skeleton_Hash(skel);
+		}
+		else
+			JointNodes.clear();
 
-		end::myJoint root;
-		root.node = skeleton->GetNode(0);
-		root.parent_index = -1;
-		JointNodes.push_back(root);
+		// the sdk is only read from this thread, one match after another
+		std::vector<end::selected_mesh> meshes(nodes.size());
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			FbxMesh* pMesh = nodes[i]->GetMesh();
+			meshes[i].name = nodes[i]->GetName();
+			if (Read_Raw_Mesh(pMesh, JointNodes, meshes[i].raw) != 0)
+				return -1;
+			bool skinned = !JointNodes.empty() && pMesh->GetDeformerCount(FbxDeformer::EDeformerType::eSkin) > 0;
+			meshes[i].skeleton_hash = skinned ? skeletonHash : 0;
+		}
+		FBX_PROFILE_ITEMS(scope, nodes.size(), meshes.size());
 
-		// traverse skeleton tree to get all joints
-		for (size_t i = 0; i < JointNodes.size(); ++i)
+		return Write_Selected_Meshes(meshes, output_path, combined);
+	}
+
+	int Write_Selected_Meshes(std::vector<end::selected_mesh>& meshes, const char* output_path, bool combined)
+	{
+		if (meshes.empty())
+			return -1;
+
+		// every file name is picked up front, two matches with the same name never race for one file
+		std::vector<std::string> paths;
+		if (!combined)
 		{
-			int childrenCount = JointNodes[i].node->GetChildCount();
-			for (int j = 0; j < childrenCount; ++j)
+			std::filesystem::path directory(output_path);
+			std::error_code error;
+			std::filesystem::create_directories(directory, error);
+			std::unordered_map<std::string, uint32_t> used;
+			for (const end::selected_mesh& mesh : meshes)
+				paths.push_back((directory / end::Selected_Mesh_File_Name(mesh.name, used)).string());
+		}
+
+		// matches share nothing, each thread welds the next one left and writes it on its own
+		end::export_control* control = end::Get_Export_Control();
+		std::atomic<size_t> next{ 0 };
+		std::atomic<bool> failed{ false };
+		auto work = [&]()
+		{
+			for (size_t i = next++; i < meshes.size(); i = next++)
 			{
-				auto child = JointNodes[i].node->GetChild(j);
-				if (child->GetNodeAttribute()
-					&& child->GetNodeAttribute()->GetAttributeType()
-					&& child->GetNodeAttribute()->GetAttributeType() == FbxNodeAttribute::eSkeleton
-					)
+				if (failed || (control && control->cancelled.load(std::memory_order_relaxed)))
+					return;
+				end::selected_mesh& mesh = meshes[i];
+				// nothing would catch it on a helper thread, a bad_alloc there would end the whole process
+				try
 				{
-					end::myJoint childJoint;
-					childJoint.node = child;
-					childJoint.parent_index = i;
-					JointNodes.push_back(childJoint);
+					if (Weld_Raw_Mesh(mesh.raw, mesh.welded) != 0)
+					{
+						failed = true;
+						return;
+					}
+					mesh.raw = end::raw_mesh();
+					if (!combined)
+					{
+						end::Write_Mesh_File(mesh.welded.View(), paths[i].c_str(), mesh.skeleton_hash);
+						mesh.welded = end::mesh_buffers();
+					}
+				}
+				catch (...)
+				{
+					failed = true;
+					return;
 				}
 			}
+		};
+
+		// helpers report to the caller's control, a cancel reaches the welds they run too
+		size_t thread_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), meshes.size());
+		std::vector<std::thread> helpers;
+		try
+		{
+			for (size_t t = 1; t < thread_count; ++t)
+			{
+				helpers.emplace_back([&]
+				{
+					end::Set_Export_Control(control);
+					work();
+					end::Set_Export_Control(nullptr);
+				});
+			}
 		}
+		catch (const std::system_error&)
+		{
+			// out of threads, the ones started and this one share the matches
+		}
+		work();
+		for (std::thread& helper : helpers)
+			helper.join();
+		if (failed || end::Export_Cancelled())
+			return -1;
 
-		FbxAnimStack* currStack = FBXUtils::Scene->GetCurrentAnimationStack();
-		FbxTimeSpan timeSpan = currStack->GetLocalTimeSpan();
-		FbxTime timeStart = timeSpan.GetStart();
-		FbxTime timeEnd = timeSpan.GetStop();
+		if (combined)
+			end::Write_Multi_Mesh_File(meshes, output_path);
+
+		return 0;
+	}
+
+	int Process_Mesh_Streamed(FbxNode* Node, const char* output_file_path, const mesh_stream_options& options)
+	{
+		int result = -1;
+		int chidlrenCount = Node->GetChildCount();
+
+		for (int i = 0; i < chidlrenCount; i++)
+		{
+			FbxNode* childNode = Node->GetChild(i);
+			FbxMesh* pMesh = childNode->GetMesh();
+
+			if (pMesh)
+			{
+				FBX_PROFILE_SCOPE(scope, "process_mesh_streamed");
+				int poly_count = pMesh->GetPolygonCount();
+				FbxVector4 const* control_points = pMesh->GetControlPoints();
+				size_t corner_count = 3 * static_cast<size_t>(poly_count);
+				if (corner_count > UINT32_MAX)
+					return -1;
+
+				// skeleton and influences the way Process_Mesh gets them, static meshes are rigid
+				std::vector<end::myJoint> JointNodes;
+				uint64_t skeletonHash = 0;
+				if (Build_Joint_List(JointNodes) == 0)
+				{
+					end::skeleton skel;
+					Build_Skeleton(JointNodes, skel);
+					skeletonHash = end::Skeleton_Hash(skel);
+				}
+				else
+					JointNodes.clear();
+
+				// the influences are per control point and needed by any corner, they stay whole
+				std::pmr::vector<end::influence_set> influences;
+				if (Read_Influences(pMesh, JointNodes, influences) != 0)
+					return -1;
+
+				// whatever the chunk doesn't need goes to the weld table
+				size_t chunk_polygons = std::max<size_t>(options.chunk_polygons, 1);
+				while (chunk_polygons > 1 && chunk_polygons * 3 * sizeof(end::simple_vert) > options.memory_budget / 2)
+					chunk_polygons /= 2;
+				size_t chunk_bytes = chunk_polygons * 3 * sizeof(end::simple_vert);
+				size_t table_bytes = options.memory_budget > chunk_bytes ? options.memory_budget - chunk_bytes : 0;
+
+				end::mesh_stream_writer writer;
+				if (writer.Open(output_file_path, static_cast<uint32_t>(corner_count), table_bytes) != 0)
+					return -1;
+
+				std::vector<end::simple_vert> chunk;
+				chunk.reserve(chunk_polygons * 3);
+				for (int first = 0; first < poly_count; first += static_cast<int>(chunk_polygons))
+				{
+					if (end::Export_Checkpoint("process_mesh_streamed", first, poly_count))
+					{
+						writer.Discard();
+						return -1;
+					}
+					int last = static_cast<int>(std::min<size_t>(poly_count, first + chunk_polygons));
+					chunk.clear();
+					for (int tri = first; tri < last; ++tri)
+					{
+						for (int v = 0; v < 3; ++v)
+						{
+							int corner = tri * 3 + v;
+							int ctrlPointIndex = pMesh->GetPolygonVertex(tri, v);
+
+							end::simple_vert vert = {};
+							vert.pos = {
+								static_cast<float>(control_points[ctrlPointIndex].mData[0]),
+								static_cast<float>(control_points[ctrlPointIndex].mData[1]),
+								static_cast<float>(control_points[ctrlPointIndex].mData[2]),
+								1.0f
+							};
+							vert.color = { 0.75f, 0.75f, 0.75f, 1.0f };
+							end::Set_Influences(vert, influences[ctrlPointIndex]);
+							ReadNormals(pMesh, corner, ctrlPointIndex, vert.norm);
+							ReadUVs(pMesh, corner, ctrlPointIndex, vert.tex_coord);
+							chunk.push_back(vert);
+						}
+					}
+					writer.Write_Chunk(chunk.data(), chunk.size());
+				}
+
+				result = writer.Close(skeletonHash);
+				FBX_PROFILE_ITEMS(scope, pMesh->GetControlPointsCount(), writer.Vertex_Count());
+			}
+		}
+		return result;
+	}
+
+	int Read_Morph_Channels(FbxMesh* pMesh, const end::raw_mesh& raw, const end::mesh_buffers& welded, const std::vector<uint32_t>& source_corners,
+		const end::morph_tolerance& tolerance, std::vector<end::morph_channel>& out_channels)
+	{
+		out_channels.clear();
+		size_t corner_count = raw.polygon_vertices.size();
+		std::vector<DirectX::XMFLOAT4> targetPoints;
+		std::vector<DirectX::XMFLOAT3> targetNormals;
+
+		int blendShapeCount = pMesh->GetDeformerCount(FbxDeformer::EDeformerType::eBlendShape);
+		for (int b = 0; b < blendShapeCount; ++b)
+		{
+			FbxBlendShape* blendShape = (FbxBlendShape*)pMesh->GetDeformer(b, FbxDeformer::EDeformerType::eBlendShape);
+			if (!blendShape)
+				return -1;
+
+			int channelCount = blendShape->GetBlendShapeChannelCount();
+			for (int c = 0; c < channelCount; ++c)
+			{
+				if (end::Export_Checkpoint("read_morph_channels", c, channelCount))
+					return -1;
+
+				FbxBlendShapeChannel* channel = blendShape->GetBlendShapeChannel(c);
+				int shapeCount = channel ? channel->GetTargetShapeCount() : 0;
+				if (shapeCount == 0)
+					continue;
+
+				end::morph_channel out_channel;
+				out_channel.name = channel->GetName();
+				// the sdk keeps weights in percent
+				out_channel.default_weight = static_cast<float>(channel->DeformPercent.Get() / 100.0);
+				const double* fullWeights = channel->GetTargetShapeFullWeights();
+				for (int t = 0; t < shapeCount; ++t)
+				{
+					FbxShape* shape = channel->GetTargetShape(t);
+					if (!shape)
+						continue;
+
+					int pointCount = shape->GetControlPointsCount();
+					FbxVector4 const* points = shape->GetControlPoints();
+					targetPoints.resize(pointCount);
+					for (int p = 0; p < pointCount; ++p)
+					{
+						targetPoints[p] = {
+							static_cast<float>(points[p].mData[0]),
+							static_cast<float>(points[p].mData[1]),
+							static_cast<float>(points[p].mData[2]),
+							1.0f
+						};
+					}
+
+					// shapes without normals of their own leave the mesh's alone
+					targetNormals.clear();
+					if (shape->GetElementNormal())
+					{
+						targetNormals.resize(corner_count);
+						for (size_t corner = 0; corner < corner_count; ++corner)
+							ReadNormals(shape, static_cast<int>(corner), raw.polygon_vertices[corner], targetNormals[corner]);
+					}
+
+					float fullWeight = fullWeights ? static_cast<float>(fullWeights[t] / 100.0) : 1.0f;
+					end::morph_shape out_shape;
+					end::Build_Morph_Shape(raw, welded, source_corners, targetPoints, targetNormals, fullWeight, tolerance, out_shape);
+					out_channel.shapes.push_back(std::move(out_shape));
+				}
+				std::sort(out_channel.shapes.begin(), out_channel.shapes.end(),
+					[](const end::morph_shape& a, const end::morph_shape& b) { return a.full_weight < b.full_weight; });
+				out_channels.push_back(std::move(out_channel));
+			}
+		}
+		return 0;
+	}
+
+	int Process_Morph_Mesh(FbxNode* Node, const char* output_file_path, const char* morph_file_path, const end::morph_tolerance& tolerance)
+	{
+		// the first mesh under 'Node'
+		FbxMesh* pMesh = nullptr;
+		int chidlrenCount = Node->GetChildCount();
+		for (int i = 0; i < chidlrenCount && !pMesh; i++)
+			pMesh = Node->GetChild(i)->GetMesh();
+		if (!pMesh)
+			return -1;
+
+		FBX_PROFILE_SCOPE(scope, "process_morph_mesh");
+		// faces are often not skinned at all, they're rigid then
+		std::vector<end::myJoint> JointNodes;
+		uint64_t skeletonHash = 0;
+		if (Build_Joint_List(JointNodes) == 0)
+		{
+			end::skeleton skel;
+			Build_Skeleton(JointNodes, skel);
+			skeletonHash = end::Skeleton_Hash(skel);
+		}
+		else
+			JointNodes.clear();
+
+		size_t corner_count = 3 * static_cast<size_t>(pMesh->GetPolygonCount());
+		std::pmr::monotonic_buffer_resource arena(end::Mesh_Arena_Size(pMesh->GetControlPointsCount(), corner_count));
+		end::raw_mesh raw(&arena);
+		end::mesh_buffers out_mesh(&arena);
+		if (Weld_Mesh(pMesh, JointNodes, raw, out_mesh) != 0)
+			return -1;
+
+		// the shapes index the welded vertices, which have to stay one control point each
+		std::vector<uint32_t> sourceCorners;
+		end::Split_Shared_Control_Points(out_mesh, raw.polygon_vertices, sourceCorners);
+
+		std::vector<end::morph_channel> channels;
+		if (Read_Morph_Channels(pMesh, raw, out_mesh, sourceCorners, tolerance, channels) != 0)
+			return -1;
+
+		bool skinned = !JointNodes.empty() && pMesh->GetDeformerCount(FbxDeformer::EDeformerType::eSkin) > 0;
+		uint64_t meshSkeletonHash = skinned ? skeletonHash : 0;
+		end::simple_mesh view = out_mesh.View();
+		end::Write_Mesh_File(view, output_file_path, meshSkeletonHash);
+		end::Write_Morph_File(channels, view.vert_count, end::Mesh_Content_Hash(view, meshSkeletonHash), morph_file_path);
+		FBX_PROFILE_ITEMS(scope, channels.size(), view.vert_count);
+
+		return 0;
+	}
+
+	// ReadNormals and ReadUVs for any layer element, false when it can't be read for this corner
+	template<typename T>
+	bool Read_Layer_Element(const FbxLayerElementTemplate<T>* element, int inVertexCount, int inPointIndex, T& out_value)
+	{
+		int index = 0;
+		switch (element->GetMappingMode())
+		{
+		case FbxGeometryElement::eByControlPoint: index = inPointIndex; break;
+		case FbxGeometryElement::eByPolygonVertex: index = inVertexCount; break;
+		case FbxGeometryElement::eAllSame: index = 0; break;
+		default: return false;
+		}
+		if (element->GetReferenceMode() == FbxGeometryElement::eIndexToDirect)
+			index = element->GetIndexArray().GetAt(index);
+		else if (element->GetReferenceMode() != FbxGeometryElement::eDirect)
+			return false;
+		out_value = element->GetDirectArray().GetAt(index);
+		return true;
+	}
+
+	int Read_Attribute_Mesh(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, end::attribute_mesh& out_mesh)
+	{
+		FBX_PROFILE_SCOPE(scope, "read_mesh");
+		int poly_count = pMesh->GetPolygonCount();
+		FbxVector4 const* control_points = pMesh->GetControlPoints();
+		size_t corner_count = 3 * static_cast<size_t>(poly_count);
+
+		out_mesh = end::attribute_mesh();
+		auto* normals = pMesh->GetElementNormal();
+		auto* colors = pMesh->GetElementVertexColorCount() > 0 ? pMesh->GetElementVertexColor(0) : nullptr;
+		std::vector<FbxGeometryElementUV*> uvSets;
+		for (int set = 0; set < pMesh->GetElementUVCount(); ++set)
+			uvSets.push_back(pMesh->GetElementUV(set));
+
+		std::pmr::vector<end::influence_set> influences;
+		if (!JointNodes.empty() && pMesh->GetDeformerCount(FbxDeformer::EDeformerType::eSkin) > 0)
+		{
+			if (Read_Skin(pMesh, JointNodes, influences) != 0)
+				return -1;
+			out_mesh.joint_count = static_cast<uint32_t>(JointNodes.size());
+		}
+
+		out_mesh.positions.resize(corner_count);
+		if (normals)
+			out_mesh.normals.resize(corner_count);
+		if (colors)
+			out_mesh.colors.resize(corner_count);
+		out_mesh.uv_sets.resize(uvSets.size(), std::vector<DirectX::XMFLOAT2>(corner_count));
+		if (!influences.empty())
+			out_mesh.influences.resize(corner_count);
+
+		for (int tri = 0; tri < poly_count; ++tri)
+		{
+			if ((tri & 1023) == 0 && end::Export_Checkpoint("read_mesh", tri, poly_count))
+				return -1;
+			for (int v = 0; v < 3; ++v)
+			{
+				int corner = tri * 3 + v;
+				int ctrlPointIndex = pMesh->GetPolygonVertex(tri, v);
+				out_mesh.positions[corner] = {
+					static_cast<float>(control_points[ctrlPointIndex].mData[0]),
+					static_cast<float>(control_points[ctrlPointIndex].mData[1]),
+					static_cast<float>(control_points[ctrlPointIndex].mData[2])
+				};
+
+				FbxVector4 normal;
+				if (normals && Read_Layer_Element(normals, corner, ctrlPointIndex, normal))
+					out_mesh.normals[corner] = { static_cast<float>(normal[0]), static_cast<float>(normal[1]), static_cast<float>(normal[2]) };
+
+				FbxColor color;
+				if (colors && Read_Layer_Element(colors, corner, ctrlPointIndex, color))
+					out_mesh.colors[corner] = { static_cast<float>(color.mRed), static_cast<float>(color.mGreen), static_cast<float>(color.mBlue), static_cast<float>(color.mAlpha) };
+
+				for (size_t set = 0; set < uvSets.size(); ++set)
+				{
+					FbxVector2 uv;
+					if (Read_Layer_Element(uvSets[set], corner, ctrlPointIndex, uv))
+						out_mesh.uv_sets[set][corner] = { static_cast<float>(uv[0]), static_cast<float>(uv[1]) };
+				}
+
+				if (!influences.empty())
+					out_mesh.influences[corner] = influences[ctrlPointIndex];
+			}
+		}
+		end::Export_Checkpoint("read_mesh", poly_count, poly_count);
+		FBX_PROFILE_ITEMS(scope, pMesh->GetControlPointsCount(), corner_count);
+		return 0;
+	}
+
+	int Build_Packed_Mesh(const end::attribute_mesh& attributes, uint64_t skeleton_hash, end::packed_mesh& out_packed)
+	{
+		end::Build_Vertex_Layout(attributes, out_packed.layout);
+		end::Pack_Vertices(attributes, out_packed.layout, out_packed.vertices);
+		end::Weld_Packed_Vertices(out_packed.vertices, out_packed.layout.stride, out_packed.indices);
+		if (end::Export_Cancelled())
+			return -1;
+		out_packed.skeleton_hash = attributes.influences.empty() ? 0 : skeleton_hash;
+		return 0;
+	}
+
+	int Process_Packed_Mesh(FbxNode* Node, const char* output_file_path)
+	{
+		// the first mesh under 'Node'
+		FbxMesh* pMesh = nullptr;
+		int chidlrenCount = Node->GetChildCount();
+		for (int i = 0; i < chidlrenCount && !pMesh; i++)
+			pMesh = Node->GetChild(i)->GetMesh();
+		if (!pMesh)
+			return -1;
+
+		FBX_PROFILE_SCOPE(scope, "process_packed_mesh");
+		// without a skeleton the skin channels are left out
+		std::vector<end::myJoint> JointNodes;
+		uint64_t skeletonHash = 0;
+		if (Build_Joint_List(JointNodes) == 0)
+		{
+			end::skeleton skel;
+			Build_Skeleton(JointNodes, skel);
+			skeletonHash = end::Skeleton_Hash(skel);
+		}
+		else
+			JointNodes.clear();
+
+		end::attribute_mesh attributes;
+		if (Read_Attribute_Mesh(pMesh, JointNodes, attributes) != 0)
+			return -1;
+
+		end::packed_mesh packed;
+		if (Build_Packed_Mesh(attributes, skeletonHash, packed) != 0)
+			return -1;
+
+		end::Write_Packed_Mesh_File(packed, output_file_path);
+		FBX_PROFILE_ITEMS(scope, attributes.positions.size(), packed.vertices.size() / packed.layout.stride);
+
+		return 0;
+	}
+
+	int Process_Stream_Mesh(FbxNode* Node, const char* output_file_path, const end::stream_options& options)
+	{
+		// the first mesh under 'Node'
+		FbxMesh* pMesh = nullptr;
+		int chidlrenCount = Node->GetChildCount();
+		for (int i = 0; i < chidlrenCount && !pMesh; i++)
+			pMesh = Node->GetChild(i)->GetMesh();
+		if (!pMesh)
+			return -1;
+
+		FBX_PROFILE_SCOPE(scope, "process_stream_mesh");
+		// without a skeleton there is no skin stream
+		std::vector<end::myJoint> JointNodes;
+		uint64_t skeletonHash = 0;
+		if (Build_Joint_List(JointNodes) == 0)
+		{
+			end::skeleton skel;
+			Build_Skeleton(JointNodes, skel);
+			skeletonHash = end::Skeleton_Hash(skel);
+		}
+		else
+			JointNodes.clear();
+
+		size_t corner_count = 3 * static_cast<size_t>(pMesh->GetPolygonCount());
+		std::pmr::monotonic_buffer_resource arena(end::Mesh_Arena_Size(pMesh->GetControlPointsCount(), corner_count));
+		end::raw_mesh raw(&arena);
+		end::mesh_buffers out_mesh(&arena);
+		if (Weld_Mesh(pMesh, JointNodes, raw, out_mesh) != 0)
+			return -1;
+
+		bool skinned = !JointNodes.empty() && pMesh->GetDeformerCount(FbxDeformer::EDeformerType::eSkin) > 0;
+		end::stream_mesh streams;
+		end::Build_Stream_Mesh(out_mesh.View(), skinned ? skeletonHash : 0, options, streams);
+		end::Write_Stream_Mesh_File(streams, options.alignment, output_file_path);
+		FBX_PROFILE_ITEMS(scope, pMesh->GetControlPointsCount(), out_mesh.verts.size());
+
+		return 0;
+	}
+
+	FbxAMatrix Geometric_Transform(FbxNode* node)
+	{
+		return FbxAMatrix(
+			node->GetGeometricTranslation(FbxNode::eSourcePivot),
+			node->GetGeometricRotation(FbxNode::eSourcePivot),
+			node->GetGeometricScaling(FbxNode::eSourcePivot));
+	}
+
+	int Process_Mesh_Instances(const char* output_file_path)
+	{
+		FBX_PROFILE_SCOPE(scope, "process_mesh_instances");
+		// skinned meshes keep their joints, without a skeleton everything is rigid
+		std::vector<end::myJoint> JointNodes;
+		uint64_t skeletonHash = 0;
+		if (Build_Joint_List(JointNodes) == 0)
+		{
+			end::skeleton skel;
+			Build_Skeleton(JointNodes, skel);
+			skeletonHash = end::Skeleton_Hash(skel);
+		}
+		else
+			JointNodes.clear();
+
+		std::filesystem::path directory = std::filesystem::path(output_file_path).parent_path();
+
+		end::instance_table table;
+		std::unordered_map<FbxMesh*, uint32_t> welded;		// meshes already exported, by the table entry they got
+		std::unordered_map<uint64_t, uint32_t> contents;	// table entries by content hash
+		int node_count = FBXUtils::Scene->GetNodeCount();
+		for (int i = 0; i < node_count; ++i)
+		{
+			if (end::Export_Checkpoint("process_mesh_instances", i, node_count))
+				return -1;
+
+			FbxNode* node = FBXUtils::Scene->GetNode(i);
+			FbxMesh* pMesh = node->GetMesh();
+			if (!pMesh || pMesh->GetPolygonCount() == 0)
+				continue;
+
+			auto found = welded.find(pMesh);
+			if (found == welded.end())
+			{
+				size_t corner_count = 3 * static_cast<size_t>(pMesh->GetPolygonCount());
+				std::pmr::monotonic_buffer_resource arena(end::Mesh_Arena_Size(pMesh->GetControlPointsCount(), corner_count));
+				end::raw_mesh raw(&arena);
+				end::mesh_buffers out_mesh(&arena);
+				if (Weld_Mesh(pMesh, JointNodes, raw, out_mesh) != 0)
+					return -1;
+
+				bool skinned = !JointNodes.empty() && pMesh->GetDeformerCount(FbxDeformer::EDeformerType::eSkin) > 0;
+				uint64_t meshSkeletonHash = skinned ? skeletonHash : 0;
+				end::simple_mesh view = out_mesh.View();
+				uint64_t hash = end::Mesh_Content_Hash(view, meshSkeletonHash);
+
+				auto known = contents.find(hash);
+				if (known == contents.end())
+				{
+					// another file with the same mesh already wrote it
+					std::filesystem::path path = directory / end::Mesh_File_Name(hash);
+					std::error_code error;
+					uintmax_t existing = std::filesystem::file_size(path, error);
+					if (error || existing != end::Mesh_File_Size(view))
+						end::Write_Mesh_File(view, path.string().c_str(), meshSkeletonHash);
+
+					known = contents.emplace(hash, static_cast<uint32_t>(table.meshes.size())).first;
+					table.meshes.push_back(hash);
+				}
+				found = welded.emplace(pMesh, known->second).first;
+			}
+
+			end::mesh_instance instance;
+			instance.mesh = found->second;
+			instance.world = To_Float4x4(FbxMatrix(node->EvaluateGlobalTransform() * Geometric_Transform(node)));
+			table.instances.push_back(instance);
+		}
+		if (table.instances.empty())
+			return -1;
+		FBX_PROFILE_ITEMS(scope, table.instances.size(), table.meshes.size());
+
+		end::Write_Instance_File(table, output_file_path);
+
+		return 0;
+	}
+
+	int Process_Collision(const char* output_file_path, const end::collision_settings& settings)
+	{
+		FBX_PROFILE_SCOPE(scope, "process_collision");
+		// the sdk stays on this thread, the submeshes are copied out before the work is spread
+		std::vector<end::collision_mesh> meshes;
+		std::vector<std::string> names;
+		std::unordered_set<FbxMesh*> seen;
+		int node_count = FBXUtils::Scene->GetNodeCount();
+		for (int i = 0; i < node_count; ++i)
+		{
+			if (end::Export_Checkpoint("process_collision", i, node_count))
+				return -1;
+
+			FbxNode* node = FBXUtils::Scene->GetNode(i);
+			FbxMesh* pMesh = node->GetMesh();
+			if (!pMesh || pMesh->GetPolygonCount() == 0 || !seen.insert(pMesh).second)
+				continue;
+
+			// welded on position alone: corners index the control points, seams don't split anything
+			end::collision_mesh mesh;
+			int control_point_count = pMesh->GetControlPointsCount();
+			FbxVector4* control_points = pMesh->GetControlPoints();
+			mesh.vertices.resize(control_point_count);
+			for (int cp = 0; cp < control_point_count; ++cp)
+				mesh.vertices[cp] = DirectX::XMFLOAT3(
+					static_cast<float>(control_points[cp].mData[0]),
+					static_cast<float>(control_points[cp].mData[1]),
+					static_cast<float>(control_points[cp].mData[2]));
+
+			int tri_count = pMesh->GetPolygonCount();
+			mesh.indices.reserve(3 * static_cast<size_t>(tri_count));
+			for (int tri = 0; tri < tri_count; ++tri)
+				for (int v = 0; v < 3; ++v)
+					mesh.indices.push_back(static_cast<uint32_t>(pMesh->GetPolygonVertex(tri, v)));
+
+			meshes.push_back(std::move(mesh));
+			names.push_back(node->GetName());
+		}
+		FBX_PROFILE_ITEMS(scope, node_count, meshes.size());
+
+		return Write_Collision(meshes, names, settings, output_file_path);
+	}
+
+	int Write_Collision(const std::vector<end::collision_mesh>& meshes, std::vector<std::string>& names,
+		const end::collision_settings& settings, const char* output_file_path)
+	{
+		if (meshes.empty())
+			return -1;
+
+		std::vector<end::collision_submesh> submeshes;
+		if (end::Build_Collisions(meshes, settings, submeshes, end::Get_Export_Control()) != 0)
+			return -1;
+		for (size_t i = 0; i < submeshes.size(); ++i)
+			submeshes[i].name = std::move(names[i]);
+
+		end::Write_Collision_File(submeshes, output_file_path);
+
+		return 0;
+	}
+
+	int Process_Animation(const char* output_file_path, const end::anim_bounds_options* bounds_options)
+	{
+		end::AnimClip clip;
+		if (Sample_Anim_Clip(clip) != 0)
+			return -1;
+
+		end::anim_bounds bounds;
+		if (bounds_options)
+		{
+			std::vector<end::myJoint> JointNodes;
+			std::vector<end::bounds_mesh> meshes;
+			if (Build_Joint_List(JointNodes) != 0 || Read_Bounds_Meshes(JointNodes, meshes) != 0)
+				return -1;
+			if (end::Build_Anim_Bounds(clip, meshes, *bounds_options, end::Get_Export_Control(), bounds) != 0)
+				return -1;
+		}
+
+		Export_Animation_File(&clip, output_file_path, bounds_options ? &bounds : nullptr);
+
+		return 0;
+	}
+
+	int Read_Bounds_Meshes(const std::vector<end::myJoint>& JointNodes, std::vector<end::bounds_mesh>& out_meshes)
+	{
+		out_meshes.clear();
+		std::unordered_set<FbxMesh*> seen;
+		int node_count = FBXUtils::Scene->GetNodeCount();
+		for (int i = 0; i < node_count; ++i)
+		{
+			FbxMesh* pMesh = FBXUtils::Scene->GetNode(i)->GetMesh();
+			if (!pMesh || pMesh->GetDeformerCount(FbxDeformer::EDeformerType::eSkin) == 0 || !seen.insert(pMesh).second)
+				continue;
+
+			end::bounds_mesh mesh;
+			FbxVector4 const* control_points = pMesh->GetControlPoints();
+			int control_point_count = pMesh->GetControlPointsCount();
+			mesh.positions.resize(control_point_count);
+			for (int c = 0; c < control_point_count; ++c)
+			{
+				mesh.positions[c] = {
+					static_cast<float>(control_points[c].mData[0]),
+					static_cast<float>(control_points[c].mData[1]),
+					static_cast<float>(control_points[c].mData[2])
+				};
+			}
+			if (Read_Skin(pMesh, JointNodes, mesh.influences) != 0)
+				return -1;
+			out_meshes.push_back(std::move(mesh));
+		}
+		return 0;
+	}
+
+	int Sample_Anim_Clip(end::AnimClip& clip)
+	{
+		FBX_PROFILE_SCOPE(scope, "process_animation");
+		//int result = -1;
+		// the joints and their bind pose, the skin is read by the exports that need it
+		std::vector<end::myJoint> JointNodes;
+		if (Build_Joint_List(JointNodes) != 0)
+			return -1;
+
+		FbxAnimStack* currStack = FBXUtils::Scene->GetCurrentAnimationStack();
+		if (!currStack)
+			return -1;
+		FbxTimeSpan timeSpan = currStack->GetLocalTimeSpan();
+		FbxTime timeStart = timeSpan.GetStart();
+		FbxTime timeEnd = timeSpan.GetStop();
 
-		end::AnimClip clip;
 		clip.duration = static_cast<double>(timeEnd.GetFrameCount(FbxTime::eFrames24) - timeStart.GetFrameCount(FbxTime::eFrames24) + 1);
 		// for every frame in the animation
-		for (size_t i = timeStart.GetFrameCount(FbxTime::eFrames24); i < timeEnd.GetFrameCount(FbxTime::eFrames24); ++i)
+		FbxLongLong firstFrame = timeStart.GetFrameCount(FbxTime::eFrames24);
+		FbxLongLong lastFrame = timeEnd.GetFrameCount(FbxTime::eFrames24);
+		size_t frameCount = lastFrame > firstFrame ? static_cast<size_t>(lastFrame - firstFrame) : 0;
+		clip.frames.reserve(frameCount);
+		for (FbxLongLong i = firstFrame; i < lastFrame; ++i)
 		{
+			if (end::Export_Checkpoint("process_animation", static_cast<size_t>(i - firstFrame), frameCount))
+				return -1;
 			end::myKeyFrame keyframe;
 			FbxTime currTime;
 			currTime.SetFrame(i, FbxTime::eFrames24);
 			keyframe.time = currTime.GetSecondDouble();
+			keyframe.joints.reserve(JointNodes.size());
 
 			// get transform for every joint in the keyframe
 			for (auto& joint : JointNodes)
@@ -520,195 +1427,1006 @@ namespace FBXUtils
 					(float)currTransformOffset.Get(2, 0), (float)currTransformOffset.Get(2, 1), (float)currTransformOffset.Get(2, 2), (float)currTransformOffset.Get(2, 3),
 					(float)currTransformOffset.Get(3, 0), (float)currTransformOffset.Get(3, 1), (float)currTransformOffset.Get(3, 2), (float)currTransformOffset.Get(3, 3)
 				};
+				newJoint.inverse_xform = joint.globalBindposeInverse;
 				newJoint.parent_index = joint.parent_index;
 				keyframe.joints.push_back(newJoint);
 			}
-			clip.frames.push_back(keyframe);
+			clip.frames.push_back(std::move(keyframe));
 		}
-		clip.frameCount = clip.frames.size();
-#		pragma region ANIMATION SKINNING
-		// Animation Skinning===========================================
-		const int MAX_INFLUENCES = 4; // max number of joints influencing a single vertex
-		struct influence { int joint; float weight; };
-		using influence_set = std::array<influence, MAX_INFLUENCES>;
-		std::vector<influence_set> control_point_influences;
+		end::Export_Checkpoint("process_animation", frameCount, frameCount);
+		clip.frameCount = static_cast<int>(clip.frames.size());
+		FBX_PROFILE_ITEMS(scope, JointNodes.size(), clip.frameCount);
 
-		// Find mesh
-		FbxMesh* mesh = nullptr;
-		for (int i = 0; i < numItems; ++i)
+		return 0;
+	}
+
+	FbxPose* Find_Bind_Pose()
+	{
+		int pose_count = FBXUtils::Scene->GetPoseCount();
+		for (int i = 0; i < pose_count; ++i)
 		{
-			FbxNode* node = pose->GetNode(i);
-			mesh = node->GetMesh();
-			if (!mesh)
-				return -1;
-			else
-				break; // for now
+			FbxPose* pose = FBXUtils::Scene->GetPose(i);
+			if (pose->IsBindPose())
+				return pose;
 		}
-		control_point_influences.resize(mesh->GetControlPointsCount());
-		FbxGeometry* geo = (FbxGeometry*)mesh;
-		if (!geo) return -1;
+		return nullptr;
+	}
 
-		// find deformer
-		int deformerCount = geo->GetDeformerCount(FbxDeformer::EDeformerType::eSkin);
+	DirectX::XMFLOAT4X4 To_Float4x4(const FbxMatrix& xform)
+	{
+		return {
+			(float)xform.Get(0, 0), (float)xform.Get(0, 1), (float)xform.Get(0, 2), (float)xform.Get(0, 3),
+			(float)xform.Get(1, 0), (float)xform.Get(1, 1), (float)xform.Get(1, 2), (float)xform.Get(1, 3),
+			(float)xform.Get(2, 0), (float)xform.Get(2, 1), (float)xform.Get(2, 2), (float)xform.Get(2, 3),
+			(float)xform.Get(3, 0), (float)xform.Get(3, 1), (float)xform.Get(3, 2), (float)xform.Get(3, 3)
+		};
+	}
 
-		for (int deformerIndex = 0; deformerIndex < deformerCount; ++deformerIndex)
-		{
-			FbxDeformer* deformer = geo->GetDeformer(deformerIndex, FbxDeformer::EDeformerType::eSkin);
-			if (!deformer) return -1;
+	int Build_Joint_List(std::vector<end::myJoint>& joints)
+	{
+		joints.clear();
 
-			FbxSkin* skin = (FbxSkin*)deformer;
-			if (!skin) return -1;
+		// find bind pose
+		FbxPose* pose = Find_Bind_Pose();
+		if (!pose)
+			return -1;
 
-			// get clusters
+		// find Skeleton
+		int numItems = pose->GetCount();
+		FbxSkeleton* skeleton = nullptr;
+		for (int i = 0; i < numItems; ++i)
+		{
+			skeleton = pose->GetNode(i)->GetSkeleton();
+			if (skeleton && skeleton->IsSkeletonRoot())
+				break;
+		}
+		if (!skeleton || !skeleton->IsSkeletonRoot())
+			return -1;
+
+		end::myJoint root;
+		root.node = skeleton->GetNode(0);
+		root.parent_index = -1;
+		joints.push_back(root);
+
+		// traverse skeleton tree to get all joints
+		for (size_t i = 0; i < joints.size(); ++i)
+		{
+			int childrenCount = joints[i].node->GetChildCount();
+			for (int j = 0; j < childrenCount; ++j)
+			{
+				auto child = joints[i].node->GetChild(j);
+				if (child->GetNodeAttribute()
+					&& child->GetNodeAttribute()->GetAttributeType() == FbxNodeAttribute::eSkeleton
+					)
+				{
+					end::myJoint childJoint;
+					childJoint.node = child;
+					childJoint.parent_index = static_cast<int>(i);
+					joints.push_back(childJoint);
+				}
+			}
+		}
+
+		// joints that don't deform anything only have the bind pose itself
+		for (auto& joint : joints)
+		{
+			int poseIndex = pose->Find(joint.node);
+			FbxMatrix bindMatrix = poseIndex >= 0 ? pose->GetMatrix(poseIndex) : FbxMatrix(joint.node->EvaluateGlobalTransform());
+			joint.globalBindposeInverse = To_Float4x4(bindMatrix.Inverse());
+		}
+
+		// the clusters know exactly what the mesh was bound against
+		int skinCount = FBXUtils::Scene->GetSrcObjectCount<FbxSkin>();
+		for (int skinIndex = 0; skinIndex < skinCount; ++skinIndex)
+		{
+			FbxSkin* skin = FBXUtils::Scene->GetSrcObject<FbxSkin>(skinIndex);
 			int clusterCount = skin->GetClusterCount();
 			for (int clusterIndex = 0; clusterIndex < clusterCount; ++clusterIndex)
 			{
 				FbxCluster* cluster = skin->GetCluster(clusterIndex);
 				FbxNode* linkNode = cluster->GetLink();
-				size_t jointCount = JointNodes.size();
-				size_t jointIndex = 0;
+				for (auto& joint : joints)
+				{
+					if (joint.node != linkNode)
+						continue;
+
+					FbxAMatrix transformMatrix;
+					FbxAMatrix transformLinkMatrix;
+					// the transformation of the mesh at binding time
+					cluster->GetTransformMatrix(transformMatrix);
+					// the transformation of the joint at binding time, from joint space to world space
+					cluster->GetTransformLinkMatrix(transformLinkMatrix);
+					joint.globalBindposeInverse = To_Float4x4(transformLinkMatrix.Inverse() * transformMatrix);
+					break;
+				}
+			}
+		}
+		return 0;
+	}
 
-				//// Attempt 1 at globalbindpose inverse===========================
-				//FbxAMatrix transformMatrix; 
-				//FbxAMatrix transformLinkMatrix;
-				//FbxAMatrix globalBindposeInverseMatrix;
-				//cluster->GetTransformMatrix(transformMatrix);
-				//// The transformation of the mesh at binding time 
-				//cluster->GetTransformLinkMatrix(transformLinkMatrix);
-				//// The transformation of the cluster(joint) at binding time from joint space to world space 
-				//globalBindposeInverseMatrix = transformLinkMatrix.Inverse() * transformMatrix;
-				////===============================================================
+	void Build_Skeleton(const std::vector<end::myJoint>& joints, end::skeleton& out_skeleton)
+	{
+		out_skeleton.names.clear();
+		out_skeleton.parent_indices.clear();
+		out_skeleton.inverse_bind.clear();
+		for (auto& joint : joints)
+		{
+			out_skeleton.names.push_back(joint.node->GetName());
+			out_skeleton.parent_indices.push_back(joint.parent_index);
+			out_skeleton.inverse_bind.push_back(joint.globalBindposeInverse);
+		}
+	}
 
-				// find joint index
-				for (; jointIndex < jointCount; ++jointIndex)
+	int Process_Skeleton(const char* output_directory, uint64_t& out_hash)
+	{
+		std::vector<end::myJoint> JointNodes;
+		if (Build_Joint_List(JointNodes) != 0)
+			return -1;
+
+		end::skeleton skel;
+		Build_Skeleton(JointNodes, skel);
+		return Write_Skeleton(skel, output_directory, out_hash);
+	}
+
+	int Write_Skeleton(const end::skeleton& skel, const char* output_directory, uint64_t& out_hash)
+	{
+		out_hash = end::Skeleton_Hash(skel);
+
+		std::string path = output_directory ? output_directory : "";
+		if (!path.empty() && path.back() != '/' && path.back() != '\\')
+			path += '/';
+		path += end::Skeleton_File_Name(out_hash);
+
+		// another file with the same rig already wrote it
+		end::skeleton existing;
+		uint64_t existingHash = 0;
+		if (end::Load_Skeleton_File(path.c_str(), existing, &existingHash) == 0 && existingHash == out_hash)
+			return 0;
+
+		end::Write_Skeleton_File(skel, out_hash, path.c_str());
+
+		return 0;
+	}
+
+	end::trs To_Trs(const FbxAMatrix& xform)
+	{
+		FbxVector4 t = xform.GetT();
+		FbxQuaternion q = xform.GetQ();
+		FbxVector4 s = xform.GetS();
+
+		end::trs pose;
+		pose.translation = { (float)t[0], (float)t[1], (float)t[2] };
+		pose.rotation = { (float)q[0], (float)q[1], (float)q[2], (float)q[3] };
+		pose.scale = { (float)s[0], (float)s[1], (float)s[2] };
+		return pose;
+	}
+
+	void Fixed_Sample_Times(FbxTime start, FbxTime stop, double sample_rate, std::vector<FbxTime>& out_times)
+	{
+		out_times.clear();
+		double duration = (stop - start).GetSecondDouble();
+		size_t count = static_cast<size_t>(std::floor(duration * sample_rate + 1e-6)) + 1;
+		out_times.reserve(count + 1);
+		for (size_t i = 0; i < count; ++i)
+			out_times.push_back(start + FbxTimeSeconds(i / sample_rate));
+		// keep the very end of the clip even when it falls between two samples
+		if (out_times.back() < stop)
+			out_times.push_back(stop);
+	}
+
+	void Find_Constrained_Nodes(std::unordered_set<FbxObject*>& out_nodes)
+	{
+		int constraintCount = FBXUtils::Scene->GetSrcObjectCount<FbxConstraint>();
+		for (int i = 0; i < constraintCount; ++i)
+		{
+			FbxConstraint* constraint = FBXUtils::Scene->GetSrcObject<FbxConstraint>(i);
+			if (constraint && constraint->GetConstrainedObject())
+				out_nodes.insert(constraint->GetConstrainedObject());
+		}
+	}
+
+	bool Collect_Curve_Times(FbxNode* node, FbxAnimLayer* layer, FbxTime start, FbxTime stop, double sample_rate, std::vector<FbxTime>& out_times)
+	{
+		// linear euler keys only stay close to a quaternion nlerp for the usual XYZ order,
+		// other orders are left to sampling
+		EFbxRotationOrder order;
+		node->GetRotationOrder(FbxNode::eSourcePivot, order);
+		if (order != eEulerXYZ)
+			return false;
+
+		// a linear euler sweep drifts away from nlerp as it widens, split it every few degrees
+		const double MAX_LINEAR_EULER_DEGREES = 2.0;
+		const FbxTime step = FbxTimeSeconds(1.0 / sample_rate);
+
+		out_times.clear();
+		out_times.push_back(start);
+		out_times.push_back(stop);
+
+		FbxPropertyT<FbxDouble3>* properties[3] = { &node->LclTranslation, &node->LclRotation, &node->LclScaling };
+		const char* components[3] = { FBXSDK_CURVENODE_COMPONENT_X, FBXSDK_CURVENODE_COMPONENT_Y, FBXSDK_CURVENODE_COMPONENT_Z };
+		for (int p = 0; p < 3; ++p)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				FbxAnimCurve* curve = properties[p]->GetCurve(layer, components[c]);
+				if (!curve)
+					continue;
+
+				int keyCount = curve->KeyGetCount();
+				for (int k = 0; k < keyCount; ++k)
 				{
-					if (linkNode == JointNodes[jointIndex].node)
-					{
-						//for (size_t i = 0; i < clip.frameCount; ++i)
-						//{
-						//	clip.frames[i].joints[jointIndex].inverse_xform = {
-						//		(float)globalBindposeInverseMatrix.Get(0, 0), (float)globalBindposeInverseMatrix.Get(0, 1), (float)globalBindposeInverseMatrix.Get(0, 2), (float)globalBindposeInverseMatrix.Get(0, 3),
-						//		(float)globalBindposeInverseMatrix.Get(1, 0), (float)globalBindposeInverseMatrix.Get(1, 1), (float)globalBindposeInverseMatrix.Get(1, 2), (float)globalBindposeInverseMatrix.Get(1, 3),
-						//		(float)globalBindposeInverseMatrix.Get(2, 0), (float)globalBindposeInverseMatrix.Get(2, 1), (float)globalBindposeInverseMatrix.Get(2, 2), (float)globalBindposeInverseMatrix.Get(2, 3),
-						//		(float)globalBindposeInverseMatrix.Get(3, 0), (float)globalBindposeInverseMatrix.Get(3, 1), (float)globalBindposeInverseMatrix.Get(3, 2), (float)globalBindposeInverseMatrix.Get(3, 3)
-						//	};
-						//}
+					FbxTime keyTime = curve->KeyGetTime(k);
+					if (keyTime > start && keyTime < stop)
+						out_times.push_back(keyTime);
+					if (k + 1 == keyCount)
 						break;
+
+					// tracks only interpolate linearly between keys, a cubic or stepped segment inside the clip
+					// can't be rebuilt from its keys so the whole joint is left to sampling
+					FbxTime nextTime = curve->KeyGetTime(k + 1);
+					if (nextTime <= start || keyTime >= stop)
+						continue;
+					if (curve->KeyGetInterpolation(k) != FbxAnimCurveDef::eInterpolationLinear)
+						return false;
+					if (p != 1)
+						continue;
+					double sweep = std::fabs(curve->KeyGetValue(k + 1) - curve->KeyGetValue(k));
+					if (sweep <= MAX_LINEAR_EULER_DEGREES)
+						continue;
+					FbxLongLong pieces = static_cast<FbxLongLong>(std::ceil(sweep / MAX_LINEAR_EULER_DEGREES));
+					FbxTime segmentStep = std::max(step, FbxTime((nextTime - keyTime).Get() / pieces));
+					for (FbxTime t = keyTime + segmentStep; t < nextTime; t += segmentStep)
+					{
+						if (t > start && t < stop)
+							out_times.push_back(t);
 					}
-						
 				}
+			}
+		}
+
+		std::sort(out_times.begin(), out_times.end());
+		out_times.erase(std::unique(out_times.begin(), out_times.end()), out_times.end());
+		return true;
+	}
+
+	int Sample_Animation_Stack(FbxAnimStack* stack, const std::vector<end::myJoint>& joints, const animation_options& options, end::track_clip& out_clip)
+	{
+		FBX_PROFILE_SCOPE(scope, "sample_animation_stack");
+		FBXUtils::Scene->SetCurrentAnimationStack(stack);
+
+		FbxTimeSpan timeSpan = stack->GetLocalTimeSpan();
+		FbxTime timeStart = timeSpan.GetStart();
+		FbxTime timeEnd = timeSpan.GetStop();
+		if (timeEnd < timeStart || options.sample_rate <= 0.0)
+			return -1;
+
+		// used by every joint that isn't read from its curves
+		std::vector<FbxTime> fixedTimes;
+		Fixed_Sample_Times(timeStart, timeEnd, options.sample_rate, fixedTimes);
 
-				// get the influences for the control points
-				size_t ctrl_pnt_count = cluster->GetControlPointIndicesCount();
-				for (size_t c = 0; c < ctrl_pnt_count; ++c)
+		// keys can only be read straight off the curves when there is a single layer and nothing drives the joint,
+		// the root is always sampled since it's stored in model space
+		FbxAnimLayer* layer = nullptr;
+		std::unordered_set<FbxObject*> constrained;
+		if (options.curve_native && stack->GetMemberCount<FbxAnimLayer>() == 1)
+		{
+			layer = stack->GetMember<FbxAnimLayer>(0);
+			Find_Constrained_Nodes(constrained);
+		}
+
+		out_clip.tracks.clear();
+		out_clip.tracks.resize(joints.size());
+
+		std::vector<FbxTime> curveTimes;
+		std::vector<float> sampleTimes;
+		std::vector<end::trs> samples;
+		for (size_t j = 0; j < joints.size(); ++j)
+		{
+			if (end::Export_Checkpoint("sample_animation_stack", j, joints.size()))
+				return -1;
+			const end::myJoint& joint = joints[j];
+			const std::vector<FbxTime>* times = &fixedTimes;
+			if (layer && joint.parent_index >= 0 && constrained.count(joint.node) == 0
+				&& Collect_Curve_Times(joint.node, layer, timeStart, timeEnd, options.sample_rate, curveTimes))
+				times = &curveTimes;
+
+			sampleTimes.clear();
+			samples.clear();
+			for (const FbxTime& time : *times)
+			{
+				sampleTimes.push_back(static_cast<float>((time - timeStart).GetSecondDouble()));
+				// the root has no parent joint so it keeps its transform in model space
+				samples.push_back(To_Trs(joint.parent_index < 0
+					? joint.node->EvaluateGlobalTransform(time)
+					: joint.node->EvaluateLocalTransform(time)));
+			}
+
+			end::Make_Rotations_Continuous(samples, 1);
+			end::Reduce_Joint_Track(samples, sampleTimes, options.tolerance, out_clip.tracks[j]);
+		}
+
+		out_clip.name = stack->GetName();
+		out_clip.duration = (timeEnd - timeStart).GetSecondDouble();
+		out_clip.sample_rate = static_cast<float>(options.sample_rate);
+		out_clip.parent_indices.clear();
+		for (auto& joint : joints)
+			out_clip.parent_indices.push_back(joint.parent_index);
+		FBX_PROFILE_ITEMS(scope, joints.size() * fixedTimes.size(), end::Count_Track_Keys(out_clip));
+
+		return 0;
+	}
+
+	int Process_Animation_Tracks(const char* output_file_path, const animation_options& options)
+	{
+		FBX_PROFILE_SCOPE(scope, "process_animation_tracks");
+		// the skeleton is shared, build it once for every stack
+		std::vector<end::myJoint> JointNodes;
+		if (Build_Joint_List(JointNodes) != 0)
+			return -1;
+
+		end::skeleton skel;
+		Build_Skeleton(JointNodes, skel);
+		uint64_t skeletonHash = end::Skeleton_Hash(skel);
+
+		int stackCount = FBXUtils::Scene->GetSrcObjectCount<FbxAnimStack>();
+		if (stackCount == 0)
+			return -1;
+
+		std::vector<end::track_clip> clips;
+		clips.reserve(stackCount);
+		for (int i = 0; i < stackCount; ++i)
+		{
+			end::track_clip clip;
+			FbxAnimStack* stack = FBXUtils::Scene->GetSrcObject<FbxAnimStack>(i);
+			if (Sample_Animation_Stack(stack, JointNodes, options, clip) != 0)
+			{
+				if (end::Export_Cancelled())
+					return -1;
+				continue;
+			}
+			if (clip.name.empty())
+				clip.name = "clip_" + std::to_string(i);
+			clip.skeleton_hash = skeletonHash;
+			clips.push_back(std::move(clip));
+		}
+		if (clips.empty())
+			return -1;
+		FBX_PROFILE_ITEMS(scope, stackCount, clips.size());
+
+		return end::Write_Track_File(clips, options.tolerance, output_file_path);
+	}
+
+	void Export_Animation_File(end::AnimClip* animClip, const char* output_file_path, const end::anim_bounds* bounds)
+	{
+		FBX_PROFILE_SCOPE(scope, "write_animation_file");
+		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+
+		assert(file.is_open());
+
+		if (file.is_open())
+		{
+			file.write((char const*)&animClip->duration, sizeof(double));
+			animClip->frameCount = static_cast<int>(animClip->frames.size());
+			file.write((char const*)&animClip->frameCount, sizeof(int));
+			//file.write((char const*)animClip->frames.data(), sizeof(end::myKeyFrame) * animClip->frames.size());
+
+			for (int i = 0; i < animClip->frameCount; ++i)
+			{
+				file.write((char const*)&animClip->frames[i].time, sizeof(double));
+				file.write((char const*)animClip->frames[i].joints.data(), sizeof(end::Joint) * animClip->frames[i].joints.size());
+			}
+			if (bounds)
+				end::Write_Anim_Bounds(file, *bounds);
+			FBX_PROFILE_ITEMS(scope, animClip->frameCount, animClip->frameCount);
+			FBX_PROFILE_BYTES(scope, file.tellp());
+		}
+
+		file.close();
+	}
+
+	int Read_Cached_Mesh(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, end::cached_mesh& out_mesh)
+	{
+		int poly_count = pMesh->GetPolygonCount();
+		FbxVector4 const* control_points = pMesh->GetControlPoints();
+		int control_point_count = pMesh->GetControlPointsCount();
+		size_t corner_count = 3 * static_cast<size_t>(poly_count);
+
+		out_mesh = end::cached_mesh();
+		out_mesh.control_points.resize(control_point_count);
+		for (int c = 0; c < control_point_count; ++c)
+		{
+			out_mesh.control_points[c] = {
+				static_cast<float>(control_points[c].mData[0]),
+				static_cast<float>(control_points[c].mData[1]),
+				static_cast<float>(control_points[c].mData[2])
+			};
+		}
+
+		if (!JointNodes.empty() && pMesh->GetDeformerCount(FbxDeformer::EDeformerType::eSkin) > 0)
+		{
+			if (Read_Skin_Clusters(pMesh, JointNodes, out_mesh.clusters) != 0)
+				return -1;
+			out_mesh.skinned = true;
+		}
+
+		auto* normals = pMesh->GetElementNormal();
+		auto* colors = pMesh->GetElementVertexColorCount() > 0 ? pMesh->GetElementVertexColor(0) : nullptr;
+		std::vector<FbxGeometryElementUV*> uvSets;
+		for (int set = 0; set < pMesh->GetElementUVCount(); ++set)
+			uvSets.push_back(pMesh->GetElementUV(set));
+
+		out_mesh.polygon_vertices.resize(corner_count);
+		if (normals)
+			out_mesh.normals.resize(corner_count);
+		if (colors)
+			out_mesh.colors.resize(corner_count);
+		out_mesh.uv_sets.resize(uvSets.size(), std::vector<DirectX::XMFLOAT2>(corner_count));
+
+		for (int tri = 0; tri < poly_count; ++tri)
+		{
+			if ((tri & 1023) == 0 && end::Export_Checkpoint("read_mesh", tri, poly_count))
+				return -1;
+			for (int v = 0; v < 3; ++v)
+			{
+				int corner = tri * 3 + v;
+				int ctrlPointIndex = pMesh->GetPolygonVertex(tri, v);
+				out_mesh.polygon_vertices[corner] = ctrlPointIndex;
+
+				FbxVector4 normal;
+				if (normals && Read_Layer_Element(normals, corner, ctrlPointIndex, normal))
+					out_mesh.normals[corner] = { static_cast<float>(normal[0]), static_cast<float>(normal[1]), static_cast<float>(normal[2]) };
+
+				FbxColor color;
+				if (colors && Read_Layer_Element(colors, corner, ctrlPointIndex, color))
+					out_mesh.colors[corner] = { static_cast<float>(color.mRed), static_cast<float>(color.mGreen), static_cast<float>(color.mBlue), static_cast<float>(color.mAlpha) };
+
+				for (size_t set = 0; set < uvSets.size(); ++set)
 				{
-					influence inf_to_add;
-					inf_to_add.joint = jointIndex;
-					inf_to_add.weight = (float)cluster->GetControlPointWeights()[c];
-					// potentially doing this wrong 
-					influence_set& inf_set = control_point_influences[cluster->GetControlPointIndices()[c]];
-					for (size_t inf = 0; inf < MAX_INFLUENCES; ++inf)
-					{
-						// if this one is stronger than any other kick out the weakest
-						if (inf_to_add.weight - inf_set[inf].weight > 0.0001f)
-						{
-							inf_set[inf] = inf_to_add;
-							break;
-						}
-					}
+					FbxVector2 uv;
+					if (Read_Layer_Element(uvSets[set], corner, ctrlPointIndex, uv))
+						out_mesh.uv_sets[set][corner] = { static_cast<float>(uv[0]), static_cast<float>(uv[1]) };
 				}
 			}
 		}
-		#pragma endregion
+		end::Export_Checkpoint("read_mesh", poly_count, poly_count);
+		return 0;
+	}
+
+	int Build_Scene_Cache(end::scene_cache& out_cache)
+	{
+		FBX_PROFILE_SCOPE(scope, "build_scene_cache");
+		out_cache = end::scene_cache();
+
+		std::vector<end::myJoint> JointNodes;
+		if (Build_Joint_List(JointNodes) == 0)
+		{
+			out_cache.has_skeleton = true;
+			Build_Skeleton(JointNodes, out_cache.skel);
+		}
+		else
+			JointNodes.clear();
+
+		FbxNode* root = FBXUtils::Scene->GetRootNode();
+		std::unordered_map<FbxMesh*, uint32_t> cached;
+		int node_count = FBXUtils::Scene->GetNodeCount();
+		for (int i = 0; i < node_count; ++i)
+		{
+			if (end::Export_Checkpoint("build_scene_cache", i, node_count))
+				return -1;
+
+			FbxNode* node = FBXUtils::Scene->GetNode(i);
+			FbxMesh* pMesh = node->GetMesh();
+			if (!pMesh)
+				continue;
+
+			auto found = cached.find(pMesh);
+			if (found == cached.end())
+			{
+				end::cached_mesh mesh;
+				if (Read_Cached_Mesh(pMesh, JointNodes, mesh) != 0)
+					return -1;
+				found = cached.emplace(pMesh, static_cast<uint32_t>(out_cache.meshes.size())).first;
+				out_cache.meshes.push_back(std::move(mesh));
+			}
+
+			end::cached_node cachedNode;
+			cachedNode.name = node->GetName();
+			cachedNode.mesh_name = pMesh->GetName();
+			cachedNode.mesh = found->second;
+			if (node->GetParent() == root)
+			{
+				for (int child = 0; child < root->GetChildCount(); ++child)
+					if (root->GetChild(child) == node)
+						cachedNode.root_child = child;
+			}
+			out_cache.nodes.push_back(std::move(cachedNode));
+		}
+
+		// the scene can be cached without a clip, exporting the animation from it fails like the import would
+		if (out_cache.has_skeleton && Sample_Anim_Clip(out_cache.clip) == 0)
+			out_cache.has_animation = true;
+		else if (end::Export_Cancelled())
+			return -1;
+		FBX_PROFILE_ITEMS(scope, node_count, out_cache.meshes.size());
+
+		return 0;
+	}
+
+	const end::cached_node* Root_Child_Mesh(const end::scene_cache& cache, bool last)
+	{
+		const end::cached_node* found = nullptr;
+		for (const end::cached_node& node : cache.nodes)
+		{
+			if (node.root_child < 0)
+				continue;
+			if (!found || (last ? node.root_child > found->root_child : node.root_child < found->root_child))
+				found = &node;
+		}
+		return found;
+	}
+
+	int Process_Cached_Mesh(const end::scene_cache& cache, const char* output_file_path)
+	{
+		// Process_Mesh writes every mesh under the root to the same file, the last one stays
+		const end::cached_node* node = Root_Child_Mesh(cache, true);
+		if (!node)
+			return -1;
+
+		FBX_PROFILE_SCOPE(scope, "process_mesh");
+		const end::cached_mesh& mesh = cache.meshes[node->mesh];
+		std::pmr::monotonic_buffer_resource arena(end::Mesh_Arena_Size(mesh.control_points.size(), mesh.polygon_vertices.size()));
+		end::raw_mesh raw(&arena);
+		end::mesh_buffers out_mesh(&arena);
+		end::Raw_Mesh_From_Cache(mesh, raw);
+		if (Weld_Raw_Mesh(raw, out_mesh) != 0)
+			return -1;
+		end::Write_Mesh_File(out_mesh.View(), output_file_path, cache.has_skeleton ? end::Skeleton_Hash(cache.skel) : 0);
+		FBX_PROFILE_ITEMS(scope, mesh.control_points.size(), out_mesh.verts.size());
+
+		return 0;
+	}
+
+	int Process_Cached_Packed_Mesh(const end::scene_cache& cache, const char* output_file_path)
+	{
+		const end::cached_node* node = Root_Child_Mesh(cache, false);
+		if (!node)
+			return -1;
+
+		FBX_PROFILE_SCOPE(scope, "process_packed_mesh");
+		uint64_t skeletonHash = cache.has_skeleton ? end::Skeleton_Hash(cache.skel) : 0;
+		end::attribute_mesh attributes;
+		end::Attribute_Mesh_From_Cache(cache.meshes[node->mesh], static_cast<uint32_t>(cache.skel.names.size()), attributes);
+
+		end::packed_mesh packed;
+		if (Build_Packed_Mesh(attributes, skeletonHash, packed) != 0)
+			return -1;
+
+		end::Write_Packed_Mesh_File(packed, output_file_path);
+		FBX_PROFILE_ITEMS(scope, attributes.positions.size(), packed.vertices.size() / packed.layout.stride);
+
+		return 0;
+	}
+
+	int Process_Cached_Stream_Mesh(const end::scene_cache& cache, const char* output_file_path, const end::stream_options& options)
+	{
+		const end::cached_node* node = Root_Child_Mesh(cache, false);
+		if (!node)
+			return -1;
+
+		FBX_PROFILE_SCOPE(scope, "process_stream_mesh");
+		const end::cached_mesh& mesh = cache.meshes[node->mesh];
+		std::pmr::monotonic_buffer_resource arena(end::Mesh_Arena_Size(mesh.control_points.size(), mesh.polygon_vertices.size()));
+		end::raw_mesh raw(&arena);
+		end::mesh_buffers out_mesh(&arena);
+		end::Raw_Mesh_From_Cache(mesh, raw);
+		if (Weld_Raw_Mesh(raw, out_mesh) != 0)
+			return -1;
+
+		end::stream_mesh streams;
+		end::Build_Stream_Mesh(out_mesh.View(), mesh.skinned ? end::Skeleton_Hash(cache.skel) : 0, options, streams);
+		end::Write_Stream_Mesh_File(streams, options.alignment, output_file_path);
+		FBX_PROFILE_ITEMS(scope, mesh.control_points.size(), out_mesh.verts.size());
+
+		return 0;
+	}
+
+	int Process_Cached_Selected_Meshes(const end::scene_cache& cache, const char* const* patterns, uint32_t pattern_count,
+		const char* output_path, bool combined, uint32_t& out_match_count)
+	{
+		FBX_PROFILE_SCOPE(scope, "process_selected_meshes");
+		end::mesh_name_index names;
+		for (const end::cached_node& node : cache.nodes)
+			end::Add_Mesh_Node(names, node.name, node.mesh_name);
+
+		std::vector<uint32_t> selected;
+		end::Select_Mesh_Nodes(names, patterns, pattern_count, selected);
+		out_match_count = static_cast<uint32_t>(selected.size());
+		if (selected.empty())
+			return -1;
+
+		uint64_t skeletonHash = cache.has_skeleton ? end::Skeleton_Hash(cache.skel) : 0;
+		std::vector<end::selected_mesh> meshes(selected.size());
+		for (size_t i = 0; i < selected.size(); ++i)
+		{
+			const end::cached_node& node = cache.nodes[selected[i]];
+			const end::cached_mesh& mesh = cache.meshes[node.mesh];
+			meshes[i].name = node.name;
+			end::Raw_Mesh_From_Cache(mesh, meshes[i].raw);
+			meshes[i].skeleton_hash = mesh.skinned ? skeletonHash : 0;
+		}
+		FBX_PROFILE_ITEMS(scope, cache.nodes.size(), meshes.size());
+
+		return Write_Selected_Meshes(meshes, output_path, combined);
+	}
+
+	int Process_Cached_Collision(const end::scene_cache& cache, const char* output_file_path, const end::collision_settings& settings)
+	{
+		FBX_PROFILE_SCOPE(scope, "process_collision");
+		std::vector<end::collision_mesh> meshes;
+		std::vector<std::string> names;
+		std::vector<bool> seen(cache.meshes.size(), false);
+		for (const end::cached_node& node : cache.nodes)
+		{
+			if (seen[node.mesh] || cache.meshes[node.mesh].polygon_vertices.empty())
+				continue;
+			seen[node.mesh] = true;
+
+			end::collision_mesh mesh;
+			end::Collision_Mesh_From_Cache(cache.meshes[node.mesh], mesh);
+			meshes.push_back(std::move(mesh));
+			names.push_back(node.name);
+		}
+		FBX_PROFILE_ITEMS(scope, cache.nodes.size(), meshes.size());
+
+		return Write_Collision(meshes, names, settings, output_file_path);
+	}
+
+	int Process_Cached_Animation(end::scene_cache& cache, const char* output_file_path, const end::anim_bounds_options* bounds_options)
+	{
+		if (!cache.has_animation)
+			return -1;
+
+		end::anim_bounds bounds;
+		if (bounds_options)
+		{
+			// the cache only marks meshes skinned when the scene has the skeleton the clip was sampled from
+			std::vector<end::bounds_mesh> meshes;
+			for (const end::cached_mesh& cached : cache.meshes)
+			{
+				if (!cached.skinned)
+					continue;
+				end::bounds_mesh mesh;
+				mesh.positions = cached.control_points;
+				end::Bind_Skin(cached.clusters, cached.control_points.size(), mesh.influences);
+				meshes.push_back(std::move(mesh));
+			}
+			if (end::Build_Anim_Bounds(cache.clip, meshes, *bounds_options, end::Get_Export_Control(), bounds) != 0)
+				return -1;
+		}
+
+		Export_Animation_File(&cache.clip, output_file_path, bounds_options ? &bounds : nullptr);
+
+		return 0;
+	}
+
+	int Process_Cached_Skeleton(const end::scene_cache& cache, const char* output_directory, uint64_t& out_hash)
+	{
+		if (!cache.has_skeleton)
+			return -1;
+
+		return Write_Skeleton(cache.skel, output_directory, out_hash);
+	}
+}
+
+namespace
+{
+	std::mutex cache_lock;
+	std::string cache_directory;	// empty while the scene cache is off
+
+	// 0 when 'out_cache' holds the scene, read from its cache or imported and cached now.
+	// 1 when the cache is off and the export imports the file itself, -1 when the file can't be read
+	int Find_Scene_Cache(const char* fbx_file_path, end::scene_cache& out_cache)
+	{
+		std::string directory;
+		{
+			std::lock_guard<std::mutex> guard(cache_lock);
+			directory = cache_directory;
+		}
+		if (directory.empty())
+			return 1;
+
+		uint64_t hash = 0;
+		end::import_blob blob;
+		if (end::Find_Import_Blob(fbx_file_path, blob))
+			hash = end::detail::fnv1a_hash(blob.data, static_cast<size_t>(blob.size));
+		else if (end::Source_File_Hash(fbx_file_path, hash) != 0)
+			return -1;
+		std::string path = (std::filesystem::path(directory) / end::Scene_Cache_File_Name(hash)).string();
+		if (end::Load_Scene_Cache_File(path.c_str(), out_cache) == 0 && out_cache.source_hash == hash)
+			return 0;
+
+		// first export of this file, everything the cache holds is read while the scene is in
+		int result = -1;
+		// Scene pointer, set by call to create_and_import
+		FBXUtils::Scene = nullptr;
+		// Create the FbxManager and import the scene from file
+		FBXUtils::sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, FBXUtils::Scene);
+		// Check if manager creation failed
+		if (FBXUtils::sdk_manager == nullptr)
+			return -1;
+		//If the scene was imported...
+		if (FBXUtils::Scene != nullptr)
+			result = FBXUtils::Build_Scene_Cache(out_cache);
+		//Destroy the manager
+		FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
+		if (result != 0)
+			return -1;
+
+		// a cache that couldn't be written only costs the next export another import
+		out_cache.source_hash = hash;
+		end::Write_Scene_Cache_File(out_cache, path.c_str());
+		return 0;
+	}
+}
+
+int Get_Scene_Poly_Count(const char* fbx_file_path)
+{
+	int result = -1;
+	// Scene pointer, set by call to create_and_import
+	FbxScene* scene = nullptr;
+	// Create the FbxManager and import the scene from file
+	FbxManager* sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, scene);
+	// Check if manager creation failed
+	if (sdk_manager == nullptr)
+		return result;
+	//If the scene was imported...
+	if (scene != nullptr)
+	{
+		//No errors to report, so start polygon count at 0
+		result = 0;
+		// Get the count of geometry objects in the scene
+		int geo_count = scene->GetGeometryCount();
+		for (int i = 0; i < geo_count; ++i)
+		{
+			//Get geometry number 'i'
+			FbxGeometry* geo = scene->GetGeometry(i);
+			// If it's not a mesh, skip it
+			// Geometries might be some other type like nurbs
+			if (geo->GetAttributeType() != FbxNodeAttribute::eMesh)
+				continue;
+			// Found a mesh, add its polygon count to the result
+			FbxMesh* mesh = (FbxMesh*)geo;
+			result += mesh->GetPolygonCount();
+		}
+	}
+	//Destroy the manager
+	FBXUtils::Release_Import(sdk_manager, scene);
+	//Return the polygon count for the scene
+	return result;
+}
+
+//	1.Searches the scene for a mesh with 'mesh_name'
+//		a. If 'mesh_name' is null, proceed by using the first mesh in the scene
+//		b. if no match is found, return an integer error code (ex: -1)
+int export_simple_mesh(const char* fbx_file_path, const char* output_file_path, const char* mesh_name)
+{
+	if (mesh_name == nullptr)
+	{
+		end::scene_cache cache;
+		int cached = Find_Scene_Cache(fbx_file_path, cache);
+		if (cached <= 0)
+			return cached == 0 ? FBXUtils::Process_Cached_Mesh(cache, output_file_path) : -1;
+	}
+
+	int result = -1;
+	// Scene pointer, set by call to create_and_import
+	FBXUtils::Scene = nullptr;
+	// Create the FbxManager and import the scene from file
+	FBXUtils::sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, FBXUtils::Scene);
+	// Check if manager creation failed
+	if (FBXUtils::sdk_manager == nullptr)
+		return result;
+	//If the scene was imported...
+	if (FBXUtils::Scene != nullptr)
+	{
+		if (mesh_name != nullptr)
+		{
+			// the first node named exactly 'mesh_name', or with a mesh named so
+			FbxNode* node = FBXUtils::Find_Mesh_Node(mesh_name);
+			if (node)
+				result = FBXUtils::Process_Node_Mesh(node, output_file_path);
+		}
+		else
+			result = FBXUtils::Process_Mesh(FBXUtils::Scene->GetRootNode(), output_file_path);
+	}
+	//Destroy the manager
+	FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
+
+	return result;
+}
+
+int export_simple_mesh_streamed(const char* fbx_file_path, const char* output_file_path, const mesh_stream_settings* settings)
+{
+	int result = -1;
+	FBXUtils::mesh_stream_options options;
+	if (settings)
+	{
+		options.memory_budget = static_cast<size_t>(settings->memory_budget);
+		options.chunk_polygons = settings->chunk_polygons;
+	}
+	// Scene pointer, set by call to create_and_import
+	FBXUtils::Scene = nullptr;
+	// Create the FbxManager and import the scene from file
+	FBXUtils::sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, FBXUtils::Scene);
+	// Check if manager creation failed
+	if (FBXUtils::sdk_manager == nullptr)
+		return result;
+	//If the scene was imported...
+	if (FBXUtils::Scene != nullptr)
+		result = FBXUtils::Process_Mesh_Streamed(FBXUtils::Scene->GetRootNode(), output_file_path, options);
+	//Destroy the manager
+	FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
+
+	return result;
+}
+
+int export_morph_mesh(const char* fbx_file_path, const char* output_file_path, const char* morph_file_path, const morph_export_settings* settings)
+{
+	int result = -1;
+	end::morph_tolerance tolerance;
+	if (settings)
+	{
+		tolerance.position = settings->position_tolerance;
+		tolerance.normal = settings->normal_tolerance;
+	}
+	// Scene pointer, set by call to create_and_import
+	FBXUtils::Scene = nullptr;
+	// Create the FbxManager and import the scene from file
+	FBXUtils::sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, FBXUtils::Scene);
+	// Check if manager creation failed
+	if (FBXUtils::sdk_manager == nullptr)
+		return result;
+	//If the scene was imported...
+	if (FBXUtils::Scene != nullptr)
+		result = FBXUtils::Process_Morph_Mesh(FBXUtils::Scene->GetRootNode(), output_file_path, morph_file_path, tolerance);
+	//Destroy the manager
+	FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
 
-		Export_Animation_File(&clip, output_file_path);
+	return result;
+}
 
-		return 0;
-	}
+int export_packed_mesh(const char* fbx_file_path, const char* output_file_path)
+{
+	end::scene_cache cache;
+	int cached = Find_Scene_Cache(fbx_file_path, cache);
+	if (cached <= 0)
+		return cached == 0 ? FBXUtils::Process_Cached_Packed_Mesh(cache, output_file_path) : -1;
 
-	//	3.Write the 'simple_mesh' object data to a binary file using 'output_file_path'
-	void Export_Mesh_File(end::simple_mesh mesh, const char* output_file_path)
-	{
-		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+	int result = -1;
+	// Scene pointer, set by call to create_and_import
+	FBXUtils::Scene = nullptr;
+	// Create the FbxManager and import the scene from file
+	FBXUtils::sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, FBXUtils::Scene);
+	// Check if manager creation failed
+	if (FBXUtils::sdk_manager == nullptr)
+		return result;
+	//If the scene was imported...
+	if (FBXUtils::Scene != nullptr)
+		result = FBXUtils::Process_Packed_Mesh(FBXUtils::Scene->GetRootNode(), output_file_path);
+	//Destroy the manager
+	FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
 
-		assert(file.is_open());
+	return result;
+}
 
-		if (file.is_open())
-		{
-			file.write((char const*)&mesh.index_count, sizeof(uint32_t));
-			file.write((char const*)mesh.indices, sizeof(uint32_t) * mesh.index_count);
-			file.write((char const*)&mesh.vert_count, sizeof(uint32_t));
-			file.write((char const*)mesh.verts, sizeof(end::simple_vert) * mesh.vert_count);
-		}
+int export_stream_mesh(const char* fbx_file_path, const char* output_file_path, const vertex_stream_settings* settings)
+{
+	vertex_stream_settings defaults;
+	if (!settings)
+		settings = &defaults;
 
-		file.close();
-	}
+	end::stream_options options;
+	options.alignment = settings->alignment;
+	options.shading = settings->shading_stream != 0;
+	options.skin = settings->skin_stream != 0;
+	options.shadow_indices = settings->shadow_indices != 0;
 
-	void Export_Animation_File(end::AnimClip* animClip, const char* output_file_path)
-	{
-		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+	end::scene_cache cache;
+	int cached = Find_Scene_Cache(fbx_file_path, cache);
+	if (cached <= 0)
+		return cached == 0 ? FBXUtils::Process_Cached_Stream_Mesh(cache, output_file_path, options) : -1;
 
-		assert(file.is_open());
+	int result = -1;
+	// Scene pointer, set by call to create_and_import
+	FBXUtils::Scene = nullptr;
+	// Create the FbxManager and import the scene from file
+	FBXUtils::sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, FBXUtils::Scene);
+	// Check if manager creation failed
+	if (FBXUtils::sdk_manager == nullptr)
+		return result;
+	//If the scene was imported...
+	if (FBXUtils::Scene != nullptr)
+		result = FBXUtils::Process_Stream_Mesh(FBXUtils::Scene->GetRootNode(), output_file_path, options);
+	//Destroy the manager
+	FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
 
-		if (file.is_open())
-		{
-			file.write((char const*)&animClip->duration, sizeof(double));
-			animClip->frameCount = animClip->frames.size();
-			file.write((char const*)&animClip->frameCount, sizeof(int));
-			//file.write((char const*)animClip->frames.data(), sizeof(end::myKeyFrame) * animClip->frames.size());
+	return result;
+}
 
-			for (size_t i = 0; i < animClip->frameCount; ++i)
-			{
-				file.write((char const*)&animClip->frames[i].time, sizeof(double));
-				file.write((char const*)animClip->frames[i].joints.data(), sizeof(end::Joint) * animClip->frames[i].joints.size());
-			}
-		}
+int export_selected_meshes(const char* fbx_file_path, const char* const* names, uint32_t name_count,
+	const char* output_path, const mesh_selection_settings* settings, uint32_t* out_match_count)
+{
+	mesh_selection_settings defaults;
+	if (!settings)
+		settings = &defaults;
+	uint32_t match_count = 0;
+	if (out_match_count)
+		*out_match_count = 0;
+	if (!names || name_count == 0 || !output_path)
+		return -1;
 
-		file.close();
+	int result = -1;
+	end::scene_cache cache;
+	int cached = Find_Scene_Cache(fbx_file_path, cache);
+	if (cached == 0)
+		result = FBXUtils::Process_Cached_Selected_Meshes(cache, names, name_count, output_path, settings->combined != 0, match_count);
+	else if (cached > 0)
+	{
+		// Scene pointer, set by call to create_and_import
+		FBXUtils::Scene = nullptr;
+		// Create the FbxManager and import the scene from file
+		FBXUtils::sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, FBXUtils::Scene);
+		// Check if manager creation failed
+		if (FBXUtils::sdk_manager == nullptr)
+			return result;
+		//If the scene was imported...
+		if (FBXUtils::Scene != nullptr)
+			result = FBXUtils::Process_Selected_Meshes(names, name_count, output_path, settings->combined != 0, match_count);
+		//Destroy the manager
+		FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
 	}
+
+	if (out_match_count)
+		*out_match_count = match_count;
+	return result;
 }
 
-int Get_Scene_Poly_Count(const char* fbx_file_path)
+int export_mesh_instances(const char* fbx_file_path, const char* output_file_path)
 {
 	int result = -1;
 	// Scene pointer, set by call to create_and_import
-	FbxScene* scene = nullptr;
+	FBXUtils::Scene = nullptr;
 	// Create the FbxManager and import the scene from file
-	FbxManager* sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, scene);
+	FBXUtils::sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, FBXUtils::Scene);
 	// Check if manager creation failed
-	if (sdk_manager == nullptr)
+	if (FBXUtils::sdk_manager == nullptr)
 		return result;
 	//If the scene was imported...
-	if (scene != nullptr)
-	{
-		//No errors to report, so start polygon count at 0
-		result = 0;
-		// Get the count of geometry objects in the scene
-		int geo_count = scene->GetGeometryCount();
-		for (int i = 0; i < geo_count; ++i)
-		{
-			//Get geometry number 'i'
-			FbxGeometry* geo = scene->GetGeometry(i);
-			// If it's not a mesh, skip it
-			// Geometries might be some other type like nurbs
-			if (geo->GetAttributeType() != FbxNodeAttribute::eMesh)
-				continue;
-			// Found a mesh, add its polygon count to the result
-			FbxMesh* mesh = (FbxMesh*)geo;
-			result += mesh->GetPolygonCount();
-		}
-	}
+	if (FBXUtils::Scene != nullptr)
+		result = FBXUtils::Process_Mesh_Instances(output_file_path);
 	//Destroy the manager
-	sdk_manager->Destroy();
-	//Return the polygon count for the scene
+	FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
+
 	return result;
 }
 
-//	1.Searches the scene for a mesh with 'mesh_name'
-//		a. If 'mesh_name' is null, proceed by using the first mesh in the scene
-//		b. if no match is found, return an integer error code (ex: -1)
-int export_simple_mesh(const char* fbx_file_path, const char* output_file_path, const char* mesh_name)
+int export_collision(const char* fbx_file_path, const char* output_file_path, const collision_export_settings* settings)
 {
+	collision_export_settings defaults;
+	if (!settings)
+		settings = &defaults;
+
+	end::collision_settings collision;
+	collision.max_hull_vertices = settings->max_hull_vertices;
+	collision.max_hulls = settings->max_hulls;
+	collision.concavity = settings->concavity;
+	collision.simplify_cells = settings->simplify_cells;
+
+	end::scene_cache cache;
+	int cached = Find_Scene_Cache(fbx_file_path, cache);
+	if (cached <= 0)
+		return cached == 0 ? FBXUtils::Process_Cached_Collision(cache, output_file_path, collision) : -1;
+
 	int result = -1;
 	// Scene pointer, set by call to create_and_import
 	FBXUtils::Scene = nullptr;
@@ -719,24 +2437,9 @@ int export_simple_mesh(const char* fbx_file_path, const char* output_file_path,
 		return result;
 	//If the scene was imported...
 	if (FBXUtils::Scene != nullptr)
-	{
-		if (mesh_name != nullptr)
-		{
-			int node_count = FBXUtils::Scene->GetNodeCount();
-			for (int i = 0; i < node_count; ++i)
-			{
-				FbxNode* node = FBXUtils::Scene->GetNode(i);
-				if (mesh_name == node->GetMesh()->GetName())
-				{
-					result = FBXUtils::Process_Mesh(node, output_file_path);
-				}
-			}
-		}
-		else
-			result = FBXUtils::Process_Mesh(FBXUtils::Scene->GetRootNode(), output_file_path);
-	}
+		result = FBXUtils::Process_Collision(output_file_path, collision);
 	//Destroy the manager
-	FBXUtils::sdk_manager->Destroy();
+	FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
 
 	return result;
 }
@@ -828,6 +2531,8 @@ int export_materials(const char* fbx_file_path, const char* output_file_path)
 		}
 
 		// write Material data to .mat file
+		FBX_PROFILE_SCOPE(scope, "write_materials_file");
+		FBX_PROFILE_ITEMS(scope, num_mats, output_mats.size());
 		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
 
 		//assert(file.is_open());
@@ -839,19 +2544,78 @@ int export_materials(const char* fbx_file_path, const char* output_file_path)
 			file.write((char const*)output_mats.data(), sizeof(end::material_t) * mat_count);
 			file.write((char const*)&path_count, sizeof(size_t));
 			file.write((char const*)paths.data(), sizeof(std::array<char, 260>) * path_count);
+			FBX_PROFILE_BYTES(scope, file.tellp());
 		}
 
 		file.close();
 	}
 	//Destroy the manager
-	FBXUtils::sdk_manager->Destroy();
+	FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
 
 	return result;
 }
 
+namespace
+{
+	// without bounds options the file stays what older readers expect byte for byte
+	int Export_Animation(const char* fbx_file_path, const char* output_file_path, const end::anim_bounds_options* bounds_options)
+	{
+		end::scene_cache cache;
+		int cached = Find_Scene_Cache(fbx_file_path, cache);
+		if (cached <= 0)
+			return cached == 0 ? FBXUtils::Process_Cached_Animation(cache, output_file_path, bounds_options) : -1;
+
+		int result = -1;
+		// Scene pointer, set by call to create_and_import
+		FBXUtils::Scene = nullptr;
+		// Create the FbxManager and import the scene from file
+		FBXUtils::sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, FBXUtils::Scene);
+		// Check if manager creation failed
+		if (FBXUtils::sdk_manager == nullptr)
+			return result;
+		//If the scene was imported...
+		if (FBXUtils::Scene != nullptr)
+		{
+			result = FBXUtils::Process_Animation(output_file_path, bounds_options);
+		}
+		//Destroy the manager
+		FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
+
+		return result;
+	}
+}
+
 int export_animation(const char* fbx_file_path, const char* output_file_path)
+{
+	return Export_Animation(fbx_file_path, output_file_path, nullptr);
+}
+
+int export_animation_bounds(const char* fbx_file_path, const char* output_file_path, const anim_bounds_settings* bounds)
+{
+	anim_bounds_settings defaults;
+	if (bounds == nullptr)
+		bounds = &defaults;
+
+	end::anim_bounds_options options;
+	options.source = bounds->source == ANIM_BOUNDS_JOINT_RADII ? end::BOUNDS_JOINT_RADII : end::BOUNDS_SKINNED_MESH;
+	options.padding = bounds->padding;
+	return Export_Animation(fbx_file_path, output_file_path, &options);
+}
+
+int export_animation_tracks(const char* fbx_file_path, const char* output_file_path, const anim_export_settings* settings)
 {
 	int result = -1;
+	anim_export_settings defaults;
+	if (settings == nullptr)
+		settings = &defaults;
+
+	FBXUtils::animation_options options;
+	options.tolerance.position = settings->position_tolerance;
+	options.tolerance.rotation = settings->rotation_tolerance;
+	options.tolerance.scale = settings->scale_tolerance;
+	options.sample_rate = settings->sample_rate;
+	options.curve_native = settings->read_curve_keys;
+
 	// Scene pointer, set by call to create_and_import
 	FBXUtils::Scene = nullptr;
 	// Create the FbxManager and import the scene from file
@@ -862,10 +2626,456 @@ int export_animation(const char* fbx_file_path, const char* output_file_path)
 	//If the scene was imported...
 	if (FBXUtils::Scene != nullptr)
 	{
-		result = FBXUtils::Process_Animation(output_file_path);
+		result = FBXUtils::Process_Animation_Tracks(output_file_path, options);
 	}
 	//Destroy the manager
-	FBXUtils::sdk_manager->Destroy();
+	FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
+
+	return result;
+}
+
+
+int export_skeleton(const char* fbx_file_path, const char* output_directory, uint64_t* out_skeleton_hash)
+{
+	int result = -1;
+	uint64_t hash = 0;
+	end::scene_cache cache;
+	int cached = Find_Scene_Cache(fbx_file_path, cache);
+	if (cached == 0)
+		result = FBXUtils::Process_Cached_Skeleton(cache, output_directory, hash);
+	else if (cached > 0)
+	{
+		// Scene pointer, set by call to create_and_import
+		FBXUtils::Scene = nullptr;
+		// Create the FbxManager and import the scene from file
+		FBXUtils::sdk_manager = FBXUtils::Create_and_Import(fbx_file_path, FBXUtils::Scene);
+		// Check if manager creation failed
+		if (FBXUtils::sdk_manager == nullptr)
+			return result;
+		//If the scene was imported...
+		if (FBXUtils::Scene != nullptr)
+		{
+			result = FBXUtils::Process_Skeleton(output_directory, hash);
+		}
+		//Destroy the manager
+		FBXUtils::Release_Import(FBXUtils::sdk_manager, FBXUtils::Scene);
+	}
 
+	if (result == 0 && out_skeleton_hash)
+		*out_skeleton_hash = hash;
 	return result;
 }
+
+int set_exporter_warm(int keep_warm)
+{
+	FBXUtils::keep_warm = keep_warm != 0;
+	if (!keep_warm)
+		FBXUtils::warm.Release();
+	return 0;
+}
+
+int release_exporter_warm()
+{
+	FBXUtils::warm.Release();
+	return 0;
+}
+
+int set_export_cache_directory(const char* directory)
+{
+	std::string path = directory ? directory : "";
+	if (!path.empty())
+	{
+		std::error_code error;
+		std::filesystem::create_directories(path, error);
+		if (!std::filesystem::is_directory(path, error))
+			return -1;
+	}
+	std::lock_guard<std::mutex> guard(cache_lock);
+	cache_directory = path;
+	return 0;
+}
+
+int register_import_blob(const char* name, const void* data, uint64_t size)
+{
+	return end::Register_Import_Blob(name, data, size);
+}
+
+int release_import_blob(const char* name)
+{
+	return end::Release_Import_Blob(name);
+}
+
+struct async_export_job
+{
+	end::export_control control;
+	export_job_kind kind = EXPORT_JOB_MESH;
+	std::string fbx_file_path;
+	std::string output_path;
+	std::string mesh_name;
+	bool has_mesh_name = false;
+	mesh_stream_settings stream_settings;
+	anim_export_settings anim_settings;
+	collision_export_settings collision_settings;
+	vertex_stream_settings vertex_streams;
+	anim_bounds_settings bounds_settings;
+	bool has_bounds_settings = false;
+	std::vector<std::string> mesh_names;
+	mesh_selection_settings selection_settings;
+	export_progress_callback progress = nullptr;
+	void* user_data = nullptr;
+
+	std::mutex lock;
+	std::condition_variable finished;
+	std::condition_variable callback_returned;
+	std::thread::id callback_thread;		// set while 'progress' runs, only the job's worker reports
+	int result = EXPORT_JOB_RUNNING;
+	const char* stage = nullptr;
+	float stage_fraction = 0.0f;
+	uint64_t skeleton_hash = 0;
+	uint32_t match_count = 0;
+
+	std::atomic<int> references{ 2 };	// the caller's handle and the queue
+};
+
+namespace
+{
+	struct export_job_queue
+	{
+		std::mutex lock;
+		std::condition_variable ready;
+		std::deque<async_export_job*> jobs;
+		bool started = false;
+	};
+
+	// never destroyed, the workers are detached and can still be waiting on it at exit
+	export_job_queue& Job_Queue()
+	{
+		static export_job_queue* queue = new export_job_queue;
+		return *queue;
+	}
+
+	void Drop_Job(async_export_job* job)
+	{
+		if (job->references.fetch_sub(1) == 1)
+			delete job;
+	}
+
+	void Report_Job_Progress(const char* stage, float fraction, void* user_data)
+	{
+		async_export_job* job = static_cast<async_export_job*>(user_data);
+		export_progress_callback progress = nullptr;
+		void* progress_data = nullptr;
+		{
+			std::lock_guard<std::mutex> guard(job->lock);
+			job->stage = stage;
+			job->stage_fraction = fraction;
+			progress = job->progress;
+			progress_data = job->user_data;
+			if (progress)
+				job->callback_thread = std::this_thread::get_id();
+		}
+		if (!progress)
+			return;
+
+		// the callback runs unlocked so it can poll the job, release waits for it to return instead
+		progress(job, stage, fraction, progress_data);
+		{
+			std::lock_guard<std::mutex> guard(job->lock);
+			job->callback_thread = std::thread::id();
+		}
+		job->callback_returned.notify_all();
+	}
+
+	int Run_Job(async_export_job& job)
+	{
+		const char* fbx = job.fbx_file_path.c_str();
+		const char* out = job.output_path.c_str();
+		switch (job.kind)
+		{
+		case EXPORT_JOB_MESH:
+			return export_simple_mesh(fbx, out, job.has_mesh_name ? job.mesh_name.c_str() : nullptr);
+		case EXPORT_JOB_MESH_STREAMED:
+			return export_simple_mesh_streamed(fbx, out, &job.stream_settings);
+		case EXPORT_JOB_MATERIALS:
+			return export_materials(fbx, out);
+		case EXPORT_JOB_ANIMATION:
+			return job.has_bounds_settings ? export_animation_bounds(fbx, out, &job.bounds_settings) : export_animation(fbx, out);
+		case EXPORT_JOB_ANIMATION_TRACKS:
+			return export_animation_tracks(fbx, out, &job.anim_settings);
+		case EXPORT_JOB_SKELETON:
+			return export_skeleton(fbx, out, &job.skeleton_hash);
+		case EXPORT_JOB_MESH_INSTANCES:
+			return export_mesh_instances(fbx, out);
+		case EXPORT_JOB_PACKED_MESH:
+			return export_packed_mesh(fbx, out);
+		case EXPORT_JOB_COLLISION:
+			return export_collision(fbx, out, &job.collision_settings);
+		case EXPORT_JOB_STREAM_MESH:
+			return export_stream_mesh(fbx, out, &job.vertex_streams);
+		case EXPORT_JOB_SELECTED_MESHES:
+		{
+			std::vector<const char*> names;
+			for (const std::string& name : job.mesh_names)
+				names.push_back(name.c_str());
+			return export_selected_meshes(fbx, names.data(), static_cast<uint32_t>(names.size()), out, &job.selection_settings, &job.match_count);
+		}
+		}
+		return -1;
+	}
+
+	void Job_Worker()
+	{
+		export_job_queue& queue = Job_Queue();
+		for (;;)
+		{
+			async_export_job* job = nullptr;
+			{
+				std::unique_lock<std::mutex> guard(queue.lock);
+				queue.ready.wait(guard, [&] { return !queue.jobs.empty(); });
+				job = queue.jobs.front();
+				queue.jobs.pop_front();
+			}
+
+			int result = EXPORT_JOB_CANCELLED;
+			if (!job->control.cancelled)
+			{
+				end::Set_Export_Control(&job->control);
+				try
+				{
+					result = Run_Job(*job);
+				}
+				catch (...)
+				{
+					// the blocking calls let it through to the caller, here there is nobody to catch it
+					result = -1;
+				}
+				end::Set_Export_Control(nullptr);
+				// an export that made it to the end anyway keeps its result
+				if (result != 0 && job->control.cancelled)
+					result = EXPORT_JOB_CANCELLED;
+			}
+
+			{
+				std::lock_guard<std::mutex> guard(job->lock);
+				job->result = result;
+			}
+			job->finished.notify_all();
+			Drop_Job(job);
+		}
+	}
+}
+
+export_job_handle start_export_job(const export_job_desc* desc)
+{
+	if (!desc || !desc->fbx_file_path || !desc->output_path || desc->kind < EXPORT_JOB_MESH || desc->kind > EXPORT_JOB_SELECTED_MESHES)
+		return nullptr;
+	if (desc->kind == EXPORT_JOB_SELECTED_MESHES && (!desc->mesh_names || desc->mesh_name_count == 0))
+		return nullptr;
+
+	async_export_job* job = new async_export_job;
+	job->kind = desc->kind;
+	job->fbx_file_path = desc->fbx_file_path;
+	job->output_path = desc->output_path;
+	job->has_mesh_name = desc->mesh_name != nullptr;
+	if (desc->mesh_name)
+		job->mesh_name = desc->mesh_name;
+	if (desc->stream_settings)
+		job->stream_settings = *desc->stream_settings;
+	if (desc->anim_settings)
+		job->anim_settings = *desc->anim_settings;
+	if (desc->collision_settings)
+		job->collision_settings = *desc->collision_settings;
+	if (desc->vertex_streams)
+		job->vertex_streams = *desc->vertex_streams;
+	for (uint32_t i = 0; desc->mesh_names && i < desc->mesh_name_count; ++i)
+	{
+		if (desc->mesh_names[i])
+			job->mesh_names.push_back(desc->mesh_names[i]);
+	}
+	if (desc->selection_settings)
+		job->selection_settings = *desc->selection_settings;
+	job->has_bounds_settings = desc->bounds_settings != nullptr;
+	if (desc->bounds_settings)
+		job->bounds_settings = *desc->bounds_settings;
+	job->progress = desc->progress;
+	job->user_data = desc->user_data;
+	job->control.callback = Report_Job_Progress;
+	job->control.user_data = job;
+
+	export_job_queue& queue = Job_Queue();
+	{
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (!queue.started)
+		{
+			unsigned worker_count = std::max(1u, std::thread::hardware_concurrency() / 2);
+			for (unsigned i = 0; i < worker_count; ++i)
+				std::thread(Job_Worker).detach();
+			queue.started = true;
+		}
+		queue.jobs.push_back(job);
+	}
+	queue.ready.notify_one();
+	return job;
+}
+
+int poll_export_job(export_job_handle job, export_job_status* out_status)
+{
+	if (!job)
+		return -1;
+	std::lock_guard<std::mutex> guard(job->lock);
+	if (out_status)
+	{
+		out_status->result = job->result;
+		out_status->stage = job->stage;
+		out_status->stage_fraction = job->stage_fraction;
+		out_status->skeleton_hash = job->result == 0 ? job->skeleton_hash : 0;
+		out_status->match_count = job->result != EXPORT_JOB_RUNNING ? job->match_count : 0;
+	}
+	return job->result;
+}
+
+int wait_export_job(export_job_handle job, uint32_t timeout_ms)
+{
+	if (!job)
+		return -1;
+	std::unique_lock<std::mutex> guard(job->lock);
+	auto over = [job] { return job->result != EXPORT_JOB_RUNNING; };
+	if (timeout_ms == EXPORT_WAIT_FOREVER)
+		job->finished.wait(guard, over);
+	else
+		job->finished.wait_for(guard, std::chrono::milliseconds(timeout_ms), over);
+	return job->result;
+}
+
+int cancel_export_job(export_job_handle job)
+{
+	if (!job)
+		return -1;
+	job->control.cancelled = true;
+	return 0;
+}
+
+int release_export_job(export_job_handle job)
+{
+	if (!job)
+		return -1;
+	job->control.cancelled = true;
+	{
+		// the caller's user data may be gone after this, so a callback already running is waited for.
+		// One releasing its own job from inside can't be
+		std::unique_lock<std::mutex> guard(job->lock);
+		job->progress = nullptr;
+		std::thread::id self = std::this_thread::get_id();
+		job->callback_returned.wait(guard, [job, self] { return job->callback_thread == std::thread::id() || job->callback_thread == self; });
+	}
+	Drop_Job(job);
+	return 0;
+}
+
+#ifdef FBXEXPORTER_PROFILING
+namespace
+{
+	export_stage_callback stage_callback = nullptr;
+
+	export_stage_stats To_Stage_Stats(const end::profile_event& event)
+	{
+		export_stage_stats stats = {};
+		stats.name = event.name;
+		stats.milliseconds = event.duration_us / 1000.0;
+		stats.calls = 1;
+		stats.items_in = event.items_in;
+		stats.items_out = event.items_out;
+		stats.bytes_written = event.bytes_written;
+		stats.peak_bytes = event.peak_bytes;
+		return stats;
+	}
+
+	void Forward_Stage(const end::profile_event& event, void* user_data)
+	{
+		export_stage_stats stats = To_Stage_Stats(event);
+		if (stage_callback)
+			stage_callback(&stats, user_data);
+	}
+}
+#endif
+
+int set_export_stage_callback(export_stage_callback callback, void* user_data)
+{
+#ifdef FBXEXPORTER_PROFILING
+	stage_callback = callback;
+	end::Set_Profile_Callback(callback ? Forward_Stage : nullptr, user_data);
+	return 0;
+#else
+	(void)callback;
+	(void)user_data;
+	return -1;
+#endif
+}
+
+int get_export_stats(export_stats* out_stats)
+{
+#ifdef FBXEXPORTER_PROFILING
+	if (out_stats == nullptr)
+		return -1;
+
+	std::vector<end::profile_event> events;
+	end::Get_Profile_Events(events);
+
+	*out_stats = {};
+	std::vector<const char*> dropped;
+	for (auto& event : events)
+	{
+		// names are literals from several translation units, the same stage isn't guaranteed a single address
+		uint32_t s = 0;
+		while (s < out_stats->stage_count && std::strcmp(out_stats->stages[s].name, event.name) != 0)
+			++s;
+		if (s == EXPORT_MAX_STAGES)
+		{
+			auto same = [&](const char* name) { return std::strcmp(name, event.name) == 0; };
+			if (std::none_of(dropped.begin(), dropped.end(), same))
+				dropped.push_back(event.name);
+			continue;
+		}
+
+		export_stage_stats& stage = out_stats->stages[s];
+		if (s == out_stats->stage_count)
+		{
+			stage = To_Stage_Stats(event);
+			++out_stats->stage_count;
+			continue;
+		}
+		stage.milliseconds += event.duration_us / 1000.0;
+		stage.calls += 1;
+		stage.items_in += event.items_in;
+		stage.items_out += event.items_out;
+		stage.bytes_written += event.bytes_written;
+		stage.peak_bytes = std::max(stage.peak_bytes, event.peak_bytes);
+	}
+	out_stats->dropped_stages = static_cast<uint32_t>(dropped.size());
+	out_stats->peak_bytes = end::Peak_Process_Bytes();
+	return dropped.empty() ? 0 : 1;
+#else
+	(void)out_stats;
+	return -1;
+#endif
+}
+
+int reset_export_stats()
+{
+#ifdef FBXEXPORTER_PROFILING
+	end::Reset_Profile();
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+int write_export_trace(const char* trace_file_path)
+{
+#ifdef FBXEXPORTER_PROFILING
+	return end::Write_Profile_Trace(trace_file_path);
+#else
+	(void)trace_file_path;
+	return -1;
+#endif
+}
@@ -1,26 +1,196 @@
 #pragma once
 #include "fbxsdk.h"
 #include "simple_mesh.h"
+#include "mesh_processing.h"
+#include "anim_tracks.h"
+#include "skeleton.h"
+#include "morph_targets.h"
+#include "vertex_layout.h"
+#include "collision.h"
+#include "scene_cache.h"
+#include "vertex_streams.h"
+#include "mesh_selection.h"
+#include "anim_bounds.h"
+
+#include <unordered_set>
+
+namespace end
+{
+	struct myJoint
+	{
+		FbxNode* node;
+		DirectX::XMFLOAT4X4 globalBindposeInverse;
+		int parent_index;
+	};
+}
 
 namespace FBXUtils
 {
-	FbxManager* sdk_manager = nullptr;
+	// per thread so separate threads can export at the same time, each with its own manager
+	thread_local FbxManager* sdk_manager = nullptr;
 
-	FbxScene* Scene = nullptr;
+	thread_local FbxScene* Scene = nullptr;
 
+	// When warm (see 'set_exporter_warm') the manager is kept and the scene is reused
+	// as long as 'fbx_file_path' hasn't changed on disk
 	FbxManager* Create_and_Import(const char* fbx_file_path, FbxScene*& lScene);
 
-	void ReadNormals(fbxsdk::FbxMesh* pMesh, int inVertexCount, int inPointIndex, DirectX::XMFLOAT3& out_norm);
+	// Pairs with every Create_and_Import, destroys the manager unless it's kept warm
+	void Release_Import(FbxManager* manager, FbxScene* scene);
+
+	void ReadNormals(fbxsdk::FbxGeometryBase* pMesh, int inVertexCount, int inPointIndex, DirectX::XMFLOAT3& out_norm);
 	
 	void ReadUVs(fbxsdk::FbxMesh* pMesh, int inVertexCount, int inPointIndex, DirectX::XMFLOAT2& out_uv);
 
+	// The mesh's skin clusters, joints indexing 'JointNodes'
+	int Read_Skin_Clusters(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, std::vector<end::skin_cluster>& clusters);
+
+	// Collects the mesh's skin clusters and binds the strongest joints to every control point
+	int Read_Skin(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, std::pmr::vector<end::influence_set>& out_influences);
+
+	// Read_Skin for skinned meshes, meshes without a skin or with an empty 'JointNodes' get every control point bound rigidly to the first joint
+	int Read_Influences(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, std::pmr::vector<end::influence_set>& out_influences);
+
+	// Reads 'pMesh' into 'raw' then expands and welds it into 'out_mesh'.
+	// Meshes without a skin, or an empty 'JointNodes', are bound rigidly to the first joint
+	int Weld_Mesh(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, end::raw_mesh& raw, end::mesh_buffers& out_mesh);
+
+	// The part of Weld_Mesh that reads the sdk
+	int Read_Raw_Mesh(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, end::raw_mesh& raw);
+
+	// The part of Weld_Mesh after the sdk, shared with the scene cache
+	int Weld_Raw_Mesh(const end::raw_mesh& raw, end::mesh_buffers& out_mesh);
+
+	// Writes every mesh under 'Node' to the same file, the last one stays. Rigid without a skeleton in the scene
 	int Process_Mesh(FbxNode* Node, const char* output_file_path);
 
-	int Process_Animation(const char* output_file_path);
+	// The scene's mesh nodes whose name, or whose mesh's name, matches one of 'patterns', see 'mesh_selection.h'.
+	// The name index is built on the first call after an import and kept for as long as the scene is
+	void Select_Mesh_Nodes(const char* const* patterns, uint32_t pattern_count, std::vector<FbxNode*>& out_nodes);
+
+	// The first mesh node named exactly 'name', or whose mesh is, null if there is none. Shares the index above
+	FbxNode* Find_Mesh_Node(const char* name);
+
+	// Writes the mesh of 'Node' itself, rigid unless it's skinned and the scene has a skeleton
+	int Process_Node_Mesh(FbxNode* Node, const char* output_file_path);
+
+	// Reads every selected mesh here, then welds and writes them in parallel: one '<node name>.mesh' each
+	// in the 'output_path' directory, or all of them in the .mmsh file 'output_path' when 'combined'
+	int Process_Selected_Meshes(const char* const* patterns, uint32_t pattern_count, const char* output_path, bool combined, uint32_t& out_match_count);
+
+	// The part of Process_Selected_Meshes after the sdk, shared with the scene cache. The raw meshes are freed as they're welded
+	int Write_Selected_Meshes(std::vector<end::selected_mesh>& meshes, const char* output_path, bool combined);
+
+	struct mesh_stream_options
+	{
+		size_t memory_budget = size_t(256) << 20;
+		size_t chunk_polygons = 65536;
+	};
+
+	// Process_Mesh a chunk of polygons at a time, see end::mesh_stream_writer
+	// Working memory stays within 'memory_budget' apart from the per control point influences
+	int Process_Mesh_Streamed(FbxNode* Node, const char* output_file_path, const mesh_stream_options& options);
+
+	// Sparse deltas of every FbxBlendShape channel of 'pMesh' against its welded vertices
+	int Read_Morph_Channels(FbxMesh* pMesh, const end::raw_mesh& raw, const end::mesh_buffers& welded, const std::vector<uint32_t>& source_corners,
+		const end::morph_tolerance& tolerance, std::vector<end::morph_channel>& out_channels);
+
+	// Writes the first mesh under 'Node' and its blend shapes, see 'morph_targets.h'
+	int Process_Morph_Mesh(FbxNode* Node, const char* output_file_path, const char* morph_file_path, const end::morph_tolerance& tolerance);
+
+	// Every channel 'pMesh' has, per triangle corner: normals, the first vertex color set, all uv sets and the skin
+	// when there are joints to bind it to
+	int Read_Attribute_Mesh(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, end::attribute_mesh& out_mesh);
+
+	// Writes the first mesh under 'Node' with only the vertex channels it has, see 'vertex_layout.h'
+	int Process_Packed_Mesh(FbxNode* Node, const char* output_file_path);
+
+	// Lays out, packs and welds 'attributes', the skeleton hash is kept only when they carry a skin
+	int Build_Packed_Mesh(const end::attribute_mesh& attributes, uint64_t skeleton_hash, end::packed_mesh& out_packed);
+
+	// Writes the first mesh under 'Node' welded like Process_Mesh, split into vertex streams, see 'vertex_streams.h'
+	int Process_Stream_Mesh(FbxNode* Node, const char* output_file_path, const end::stream_options& options);
+
+	// The node's geometric offset, applied to its attribute only and not inherited by its children
+	FbxAMatrix Geometric_Transform(FbxNode* node);
+
+	// Welds every distinct mesh of the scene once, to '<hash>.mesh' next to 'output_file_path',
+	// and writes the table of nodes placing them there, see 'mesh_instances.h'
+	int Process_Mesh_Instances(const char* output_file_path);
+
+	// Convex hulls and a simplified mesh for every distinct mesh in the scene, built in parallel
+	int Process_Collision(const char* output_file_path, const end::collision_settings& settings);
+
+	// Builds every mesh's collision in parallel and writes them under 'names', which are moved from
+	int Write_Collision(const std::vector<end::collision_mesh>& meshes, std::vector<std::string>& names,
+		const end::collision_settings& settings, const char* output_file_path);
+
+	// With 'bounds_options' the .anim ends with a box per frame, see 'anim_bounds.h'
+	int Process_Animation(const char* output_file_path, const end::anim_bounds_options* bounds_options = nullptr);
+
+	// Control points and skin of every distinct skinned mesh in the scene, what the animation bounds are built from
+	int Read_Bounds_Meshes(const std::vector<end::myJoint>& JointNodes, std::vector<end::bounds_mesh>& out_meshes);
+
+	// The current stack's global joint transforms at 24 fps, what Process_Animation writes
+	int Sample_Anim_Clip(end::AnimClip& clip);
+
+	FbxPose* Find_Bind_Pose();
+
+	DirectX::XMFLOAT4X4 To_Float4x4(const FbxMatrix& xform);
+
+	// Fills 'joints' with the skeleton of the scene's bind pose, parents always come before their children
+	// Each joint's 'globalBindposeInverse' comes from the skin cluster linked to it,
+	// joints that don't deform anything fall back to the inverse of their bind pose matrix
+	int Build_Joint_List(std::vector<end::myJoint>& joints);
+
+	void Build_Skeleton(const std::vector<end::myJoint>& joints, end::skeleton& out_skeleton);
+
+	// Writes the scene's skeleton to '<output_directory>/<hash>.skel', skipped when that file is already there
+	int Process_Skeleton(const char* output_directory, uint64_t& out_hash);
+
+	int Write_Skeleton(const end::skeleton& skel, const char* output_directory, uint64_t& out_hash);
+
+	struct animation_options
+	{
+		end::reduction_tolerance tolerance;
+		double sample_rate = 24.0;
+		// read joints' local curve keys instead of sampling at 'sample_rate' wherever that is exact
+		bool curve_native = false;
+	};
+
+	end::trs To_Trs(const FbxAMatrix& xform);
+
+	void Fixed_Sample_Times(FbxTime start, FbxTime stop, double sample_rate, std::vector<FbxTime>& out_times);
+
+	void Find_Constrained_Nodes(std::unordered_set<FbxObject*>& out_nodes);
+
+	// Gathers the times a joint has to be evaluated at to rebuild its local TRS curves
+	// Returns false when the joint can't be read from its curves and has to be sampled instead,
+	// when its rotation order isn't XYZ or a curve has a cubic or stepped segment inside the clip
+	bool Collect_Curve_Times(FbxNode* node, FbxAnimLayer* layer, FbxTime start, FbxTime stop, double sample_rate, std::vector<FbxTime>& out_times);
+
+	// Samples and reduces one animation stack against an already built skeleton
+	int Sample_Animation_Stack(FbxAnimStack* stack, const std::vector<end::myJoint>& joints, const animation_options& options, end::track_clip& out_clip);
+
+	int Process_Animation_Tracks(const char* output_file_path, const animation_options& options);
+
+	void Export_Animation_File(end::AnimClip* animClip, const char* output_file_path, const end::anim_bounds* bounds = nullptr);
 
-	void Compactify(end::simple_mesh& simpleMesh);
+	// Everything the cached exports need out of the scene: each distinct mesh with its layer elements and skin clusters,
+	// the mesh nodes, the skeleton and the sampled clip, see 'scene_cache.h'
+	int Read_Cached_Mesh(FbxMesh* pMesh, const std::vector<end::myJoint>& JointNodes, end::cached_mesh& out_mesh);
+	int Build_Scene_Cache(end::scene_cache& out_cache);
 
-	void Export_Mesh_File(end::simple_mesh mesh, const char* output_file_path);
+	// The root's first or last mesh child, what the exports taking "the" mesh of a scene use
+	const end::cached_node* Root_Child_Mesh(const end::scene_cache& cache, bool last);
 
-	void Export_Animation_File(end::AnimClip* animClip, const char* output_file_path);
+	// The exports again, from a scene cache instead of the sdk. Same files as their Process_ counterparts
+	int Process_Cached_Mesh(const end::scene_cache& cache, const char* output_file_path);
+	int Process_Cached_Packed_Mesh(const end::scene_cache& cache, const char* output_file_path);
+	int Process_Cached_Stream_Mesh(const end::scene_cache& cache, const char* output_file_path, const end::stream_options& options);
+	int Process_Cached_Selected_Meshes(const end::scene_cache& cache, const char* const* patterns, uint32_t pattern_count,
+		const char* output_path, bool combined, uint32_t& out_match_count);
+	int Process_Cached_Collision(const end::scene_cache& cache, const char* output_file_path, const end::collision_settings& settings);
+	int Process_Cached_Animation(end::scene_cache& cache, const char* output_file_path, const end::anim_bounds_options* bounds_options = nullptr);
+	int Process_Cached_Skeleton(const end::scene_cache& cache, const char* output_directory, uint64_t& out_hash);
 }
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 
-#ifndef FBXEXPORTER_EXPORTS
+#include <cstdint>
+
+#ifndef _WIN32
+// shared object builds, e.g. the driver on linux build nodes
+#define FBXEXPORTER_API __attribute__((visibility("default")))
+#elif !defined(FBXEXPORTER_EXPORTS)
 #define FBXEXPORTER_API __declspec(dllexport)
 #else
 #define FBXEXPORTER_API __declspec(dllimport)
@@ -12,6 +17,9 @@ extern "C" FBXEXPORTER_API int Get_Scene_Poly_Count(const char* fbx_file_path);
 
 // export_simple_mesh
 //
+// The .mesh file ends with the hash of the skeleton it is skinned to, see 'export_skeleton'.
+// Meshes of scenes without a skeleton, or without a skin, are bound rigidly to joint 0 and static ones end with a 0 hash
+//
 // Performs the followings steps :
 // 
 // *Fbx Setup and scene loading 
@@ -30,7 +38,9 @@ extern "C" FBXEXPORTER_API int Get_Scene_Poly_Count(const char* fbx_file_path);
 //
 // *Mesh processing - Calls a function YOU DEFINE that implements the following steps
 //	1.Searches the scene for a mesh with 'mesh_name'
-//		a. If 'mesh_name' is null, proceed by using the first mesh in the scene
+//		a. If 'mesh_name' is null, proceed by using the first mesh in the scene,
+//		   otherwise the first node with exactly that name, or whose mesh has it. Wildcards aren't expanded
+//		   here, globs are 'export_selected_meshes' only
 //		b. if no match is found, return an integer error code (ex: -1)
 //	2.Extract vertex data from the mesh and store the data in a 'simple_mesh' object or similar
 //		a. SEE "EXPORTING GUIDE.PDF" for pseudocode and in-depth explaination
@@ -38,8 +48,303 @@ extern "C" FBXEXPORTER_API int Get_Scene_Poly_Count(const char* fbx_file_path);
 //	3.Write the 'simple_mesh' object data to a binary file using 'output_file_path'
 extern "C" FBXEXPORTER_API int export_simple_mesh(const char* fbx_file_path, const char* output_file_path = "TestMesh.mesh", const char* mesh_name = nullptr);
 
+// Settings for 'export_simple_mesh_streamed'
+struct mesh_stream_settings
+{
+	uint64_t memory_budget = 256ull << 20;	// bytes for the polygon chunk and the weld table together
+	uint32_t chunk_polygons = 65536;		// triangles extracted and welded at a time, shrunk to fit the budget
+};
+
+// Same .mesh as 'export_simple_mesh' for meshes too big to expand in memory. Polygons are extracted, welded and written
+// a chunk at a time and the vertices spill to '<output_file_path>.verts' until the end, so the exporter's working memory
+// stays within the budget whatever the mesh size (the per control point skin influences and the sdk's scene aside).
+// The weld table is capped too: while it has room the file matches 'export_simple_mesh' exactly, past that some
+// vertices are written more than once. Static and unskinned meshes are rigid like there. 'settings' may be null to use the defaults
+extern "C" FBXEXPORTER_API int export_simple_mesh_streamed(const char* fbx_file_path, const char* output_file_path = "TestMesh.mesh", const mesh_stream_settings* settings = nullptr);
+
+// Settings for 'export_morph_mesh'. Vertices a target moves less than this are left out of it
+struct morph_export_settings
+{
+	float position_tolerance = 0.0001f;	// scene units
+	float normal_tolerance = 0.001f;
+};
+
+// Exports the first mesh like 'export_simple_mesh' along with its FbxBlendShape channels (names, default weights
+// and in-between targets) to 'morph_file_path'. Each target only stores the welded vertices it moves, with quantized
+// position and normal deltas. Welded vertices shared by different control points are split first so every target
+// can move them apart, the .mesh can have a few more vertices than 'export_simple_mesh' gives.
+// Meshes without a skeleton are exported too, bound rigidly. See 'morph_targets.h' for reading and applying them.
+// 'settings' may be null to use the defaults
+extern "C" FBXEXPORTER_API int export_morph_mesh(const char* fbx_file_path, const char* output_file_path = "TestMesh.mesh", const char* morph_file_path = "TestMesh.morph", const morph_export_settings* settings = nullptr);
+
+// Exports the first mesh with a vertex layout made of the channels it actually has: position, then normals,
+// the first vertex color set (8 bit), every uv set and, when it has a skin and the scene a skeleton, joints and weights
+// (8 or 16 bit joints, 16 bit weights). Vertices are welded on every channel and indices are 16 bit when they fit.
+// The file describes its own layout. See 'vertex_layout.h' for reading it back
+extern "C" FBXEXPORTER_API int export_packed_mesh(const char* fbx_file_path, const char* output_file_path = "TestMesh.pmesh");
+
+// Settings for 'export_stream_mesh'
+struct vertex_stream_settings
+{
+	uint32_t alignment = 16;	// bytes every stream starts on, a power of two
+	int shading_stream = 1;		// normals, colors and uvs
+	int skin_stream = 1;		// joints and weights, only ever written for skinned meshes
+	int shadow_indices = 1;		// a second index buffer with the corners welded on position alone
+};
+
+// Exports the first mesh welded like 'export_simple_mesh', its vertices split into separate streams instead of one
+// interleaved simple_vert array: positions only (12 bytes a vertex), shading, and skinning. Each stream is its own
+// aligned section so depth, shadow and raycast passes only ever touch the positions. The shadow index buffer indexes the
+// same position stream but gives vertices split only by a normal or uv seam one index, for better vertex reuse.
+// Indices are 16 bit when they fit. Meshes without a skeleton are exported too, without a skin stream.
+// See 'vertex_streams.h' for reading it back. 'settings' may be null to use the defaults
+extern "C" FBXEXPORTER_API int export_stream_mesh(const char* fbx_file_path, const char* output_file_path = "TestMesh.vstr", const vertex_stream_settings* settings = nullptr);
+
+// Settings for 'export_selected_meshes'
+struct mesh_selection_settings
+{
+	int combined = 0;		// every match in the one .mmsh file 'output_path' instead of a .mesh each
+};
+
+// Exports every mesh node whose name, or whose mesh's name, matches one of 'names' from a single import, like
+// 'export_simple_mesh' exports one. Names are exact or glob patterns ('*' any run of characters, '?' any one), e.g.
+// { "Hero_LOD1", "*_COL*" }. Exact names are looked up in a hash index of the scene's node names built once per scene
+// (and kept with it while warm), patterns run over it in scene order. The meshes are read one after another, then welded
+// and written in parallel. Each match goes to '<output_path>/<node name>.mesh', 'output_path' being a directory created
+// when missing, with "_1", "_2".. after a name already used. With 'combined' they all go into the .mmsh file 'output_path'
+// instead, see 'mesh_selection.h' for reading it back. A node matched by several names is exported once. Meshes are rigid
+// unless skinned to the scene's skeleton. Returns -1 when nothing matches. 'settings' and 'out_match_count' may be null
+extern "C" FBXEXPORTER_API int export_selected_meshes(const char* fbx_file_path, const char* const* names, uint32_t name_count,
+	const char* output_path = ".", const mesh_selection_settings* settings = nullptr, uint32_t* out_match_count = nullptr);
+
+// Exports every distinct mesh in the scene once, for scenes built out of the same few meshes placed over and over.
+// Nodes sharing an FbxMesh, and meshes that weld down to the same buffers, all use one '<hash>.mesh' written next to
+// 'output_file_path' (skipped when it's already there), named after the hash of its contents.
+// 'output_file_path' gets the instance table: the mesh hashes and, per node, which mesh and its world transform.
+// Meshes without a skin are bound rigidly to joint 0. See 'mesh_instances.h' for reading it back
+extern "C" FBXEXPORTER_API int export_mesh_instances(const char* fbx_file_path, const char* output_file_path = "TestScene.inst");
+
+// Settings for 'export_collision'
+struct collision_export_settings
+{
+	uint32_t max_hull_vertices = 64;	// the hull keeps the furthest points first once there are more
+	uint32_t max_hulls = 1;				// above 1 closed concave meshes are split into up to this many convex hulls
+	float concavity = 0.1f;				// splitting stops once the hulls enclose at most this much more than the mesh
+	uint32_t simplify_cells = 32;		// vertices snap to a grid this many cells along the mesh's longest side, 0 keeps every triangle, at most 2097151
+};
+
+// Bakes collision for every distinct mesh in the scene to its own file: a quickhull convex hull, or with 'max_hulls' above 1
+// an approximate convex decomposition of the concave ones, and a simplified triangle mesh, all in the mesh's space
+// like the .mesh. Each submesh is named after the first node using it and they are built in parallel.
+// Open meshes always get a single hull. See 'collision.h' for reading it back. 'settings' may be null to use the defaults
+extern "C" FBXEXPORTER_API int export_collision(const char* fbx_file_path, const char* output_file_path = "TestMesh.coll", const collision_export_settings* settings = nullptr);
+
 // Export mesh Materials
 // Parameters: FBX file path, exported file path, 
 extern "C" FBXEXPORTER_API int export_materials(const char* fbx_file_path, const char* output_file_path = "TestMat.mat");
 
+// Where 'export_animation_bounds' takes its per frame bounds from
+enum anim_bounds_source_kind
+{
+	ANIM_BOUNDS_SKINNED_MESH,		// every skinned mesh of the scene skinned to the frame's pose, exact
+	ANIM_BOUNDS_JOINT_RADII			// each joint's position grown by how far the vertices it moves reach from it, looser but cheaper
+};
+
+// Settings for the bounds 'export_animation_bounds' bakes
+struct anim_bounds_settings
+{
+	int source = ANIM_BOUNDS_SKINNED_MESH;
+	float padding = 0.0f;			// added on every side of every box, scene units
+};
+
+// Samples the current animation stack's global joint transforms at 24 fps
 extern "C" FBXEXPORTER_API int export_animation(const char* fbx_file_path, const char* output_file_path = "TestMat.anim");
+
+// 'export_animation', and the .anim also gets a box per frame, built in parallel over the frames, and their union for the whole clip.
+// They trail the frames, readers of the original layout are unaffected. A scene without a skinned mesh gets boxes around
+// its joints, grown by the padding. See 'anim_bounds.h' for reading them. 'bounds' may be null for the default settings
+extern "C" FBXEXPORTER_API int export_animation_bounds(const char* fbx_file_path, const char* output_file_path = "TestMat.anim", const anim_bounds_settings* bounds = nullptr);
+
+// Settings for 'export_animation_tracks'.
+// A key is dropped when interpolating its neighbours rebuilds it within the tolerances.
+struct anim_export_settings
+{
+	float position_tolerance = 0.001f;	// scene units
+	float rotation_tolerance = 0.0005f;	// radians
+	float scale_tolerance = 0.0001f;
+	float sample_rate = 24.0f;			// samples per second
+	// Read the joints' local FbxAnimCurve keys instead of sampling the whole clip, for joints whose curves are all
+	// linearly interpolated. Joints with cubic or stepped keys, constrained joints, other rotation orders and
+	// layered stacks still get sampled at 'sample_rate'. Wide linear euler sweeps get a few keys in between
+	bool read_curve_keys = false;
+};
+
+// Exports every animation stack in the file as one variable rate track per joint.
+// The skeleton is built once and shared by all the clips, the file has a directory to look clips up by name.
+// Joints that don't move are collapsed down to a single key.
+// Tracks hold local space translation, rotation (smallest three, 48 bits) and scale only when the clip uses it,
+// the joint hierarchy is written once at the top of the file. See 'anim_runtime.h' for reading it back.
+// Fails without writing anything when a joint's channel keeps more than 65535 keys.
+// 'settings' may be null to use the default tolerances
+extern "C" FBXEXPORTER_API int export_animation_tracks(const char* fbx_file_path, const char* output_file_path = "TestAnim.anim", const anim_export_settings* settings = nullptr);
+
+
+// Writes the skeleton (joint names, hierarchy and global bind pose inverses) to '<output_directory>/<hash>.skel'.
+// The hash only depends on the rig, so every file exported from characters sharing it lands on the same .skel
+// and it is only written the first time. Meshes and track files store the same hash to find their skeleton.
+// 'out_skeleton_hash' may be null. See 'skeleton.h' for reading it back
+extern "C" FBXEXPORTER_API int export_skeleton(const char* fbx_file_path, const char* output_directory = ".", uint64_t* out_skeleton_hash = nullptr);
+
+// Keeps the Fbx sdk manager alive between export calls instead of creating one per call, one per calling thread,
+// along with the last imported scene for as long as its file doesn't change on disk. Exporting the mesh, materials,
+// tracks and skeleton of a file then only imports it once. Meant for long running hosts like FBXExport_DAEMON.
+// Exports always run on the calling thread's own manager, so different threads can export at the same time. Off by default
+extern "C" FBXEXPORTER_API int set_exporter_warm(int keep_warm);
+
+// Destroys the calling thread's warm manager and scene, the next export starts cold
+extern "C" FBXEXPORTER_API int release_exporter_warm();
+
+// Scene cache.
+// With a directory set, export_simple_mesh (without 'mesh_name'), export_packed_mesh, export_stream_mesh, export_selected_meshes,
+// export_collision, export_animation and export_skeleton read the fbx through '<directory>/<hash>.fbxcache': control points, polygon indices, layer elements,
+// skin clusters, the skeleton and the sampled clip, keyed by the hash of the fbx's bytes. The first export of a file imports it
+// and writes the cache, every later one, whatever its options, only hashes the file and reads the cache without the sdk.
+// An edited fbx hashes differently and is imported again. The other exports always import.
+// Null or "" turns it off. Returns -1 when the directory can't be created
+extern "C" FBXEXPORTER_API int set_export_cache_directory(const char* directory);
+
+// In-memory imports.
+// Registers 'size' bytes of an .fbx file at 'data' under 'name': every export, blocking or async, given 'name' as its
+// 'fbx_file_path' imports those bytes instead of a file, no temp file needed. The bytes aren't copied and have to stay valid
+// until 'release_import_blob' returns and no export of 'name' is running anymore. Registering a name again replaces its blob.
+// The scene cache keys blobs by the hash of their bytes like files, a warm scene is kept for as long as its blob is registered.
+// Blobs over 2GB can't be read through the sdk's stream and fail to import.
+// Files are always read the same way when they can be: an .fbx path is memory mapped with the whole file prefetched,
+// or read in a few large reads where it can't be mapped, and the sdk parses it from memory instead of doing its own small reads
+extern "C" FBXEXPORTER_API int register_import_blob(const char* name, const void* data, uint64_t size);
+
+// Returns -1 when 'name' isn't registered
+extern "C" FBXEXPORTER_API int release_import_blob(const char* name);
+
+// Asynchronous exports.
+// 'start_export_job' queues one of the exports above on the dll's own worker threads (half the hardware threads,
+// at least one) and returns straight away with a job to poll, wait on or cancel. Its result is whatever the blocking
+// call would have returned. Cancelling is cooperative: the export stops at its next check (during the import,
+// every few thousand corners or vertices of a mesh, every animation frame or joint) and finishes with
+// EXPORT_JOB_CANCELLED, without writing its output. With 'set_exporter_warm' on, each worker keeps its own warm scene.
+// Every job has to be released, releasing one that hasn't finished cancels it.
+enum export_job_kind
+{
+	EXPORT_JOB_MESH,				// export_simple_mesh
+	EXPORT_JOB_MESH_STREAMED,		// export_simple_mesh_streamed
+	EXPORT_JOB_MATERIALS,			// export_materials
+	EXPORT_JOB_ANIMATION,			// export_animation
+	EXPORT_JOB_ANIMATION_TRACKS,	// export_animation_tracks
+	EXPORT_JOB_SKELETON,			// export_skeleton, 'output_path' is the output directory
+	EXPORT_JOB_MESH_INSTANCES,		// export_mesh_instances
+	EXPORT_JOB_PACKED_MESH,			// export_packed_mesh
+	EXPORT_JOB_COLLISION,			// export_collision
+	EXPORT_JOB_STREAM_MESH,			// export_stream_mesh
+	EXPORT_JOB_SELECTED_MESHES		// export_selected_meshes
+};
+
+const int EXPORT_JOB_RUNNING = 1;		// queued or still exporting
+const int EXPORT_JOB_CANCELLED = -2;
+const uint32_t EXPORT_WAIT_FOREVER = 0xFFFFFFFF;
+
+typedef struct async_export_job* export_job_handle;
+
+// Called from the worker as the export goes through its stages, with how far along the current one is (0 to 1).
+// Stages: import, read_mesh, compactify, process_mesh_streamed, process_mesh_instances, read_morph_channels, weld_packed_vertices,
+// process_collision, build_scene_cache, process_animation, build_anim_bounds, sample_animation_stack.
+// The export waits for it, keep it short
+typedef void (*export_progress_callback)(export_job_handle job, const char* stage, float stage_fraction, void* user_data);
+
+struct export_job_desc
+{
+	export_job_kind kind = EXPORT_JOB_MESH;
+	const char* fbx_file_path = nullptr;
+	const char* output_path = nullptr;
+	const char* mesh_name = nullptr;						// EXPORT_JOB_MESH, may be null
+	const mesh_stream_settings* stream_settings = nullptr;	// EXPORT_JOB_MESH_STREAMED, may be null
+	const anim_export_settings* anim_settings = nullptr;	// EXPORT_JOB_ANIMATION_TRACKS, may be null
+	const collision_export_settings* collision_settings = nullptr;	// EXPORT_JOB_COLLISION, may be null
+	const vertex_stream_settings* vertex_streams = nullptr;			// EXPORT_JOB_STREAM_MESH, may be null
+	const char* const* mesh_names = nullptr;				// EXPORT_JOB_SELECTED_MESHES
+	uint32_t mesh_name_count = 0;
+	const mesh_selection_settings* selection_settings = nullptr;	// EXPORT_JOB_SELECTED_MESHES, may be null
+	const anim_bounds_settings* bounds_settings = nullptr;	// EXPORT_JOB_ANIMATION, runs 'export_animation_bounds' when set
+	export_progress_callback progress = nullptr;			// may be null
+	void* user_data = nullptr;
+};
+
+struct export_job_status
+{
+	int result;						// EXPORT_JOB_RUNNING until the export is over
+	const char* stage;				// last stage reported, null before the first one
+	float stage_fraction;
+	uint64_t skeleton_hash;			// EXPORT_JOB_SKELETON, once it succeeded
+	uint32_t match_count;			// EXPORT_JOB_SELECTED_MESHES, once it's over
+};
+
+// Everything 'desc' points to is copied. Returns null when the description is incomplete
+extern "C" FBXEXPORTER_API export_job_handle start_export_job(const export_job_desc* desc);
+
+// Never blocks. Returns the job's result, or EXPORT_JOB_RUNNING. 'out_status' may be null
+extern "C" FBXEXPORTER_API int poll_export_job(export_job_handle job, export_job_status* out_status);
+
+// Blocks until the job is over or 'timeout_ms' went by (EXPORT_WAIT_FOREVER for no limit).
+// Returns the job's result, or EXPORT_JOB_RUNNING on timeout
+extern "C" FBXEXPORTER_API int wait_export_job(export_job_handle job, uint32_t timeout_ms = EXPORT_WAIT_FOREVER);
+
+// Asks the job to stop, returns straight away. A job too far along to stop keeps its result
+extern "C" FBXEXPORTER_API int cancel_export_job(export_job_handle job);
+
+// The handle can't be used anymore afterwards, and no progress callback starts after this returns.
+// A callback running at the time is waited for, unless it's the one calling this
+extern "C" FBXEXPORTER_API int release_export_job(export_job_handle job);
+
+// Export stage profiling.
+// Only available when the dll is built with FBXEXPORTER_PROFILING defined, otherwise the stages aren't
+// instrumented at all and these functions return -1 / do nothing.
+// Stages: import, process_mesh, read_mesh, bind_skin, expand_vertices, compactify, write_mesh_file, process_animation,
+// write_animation_file, process_animation_tracks, sample_animation_stack, write_track_file, write_skeleton_file, write_materials_file,
+// process_mesh_streamed, weld_chunk, process_mesh_instances, write_instance_file, process_morph_mesh, build_morph_shape, write_morph_file,
+// process_packed_mesh, weld_packed_vertices, write_packed_mesh_file, process_collision, build_collision, build_convex_hull,
+// decompose_convex, simplify_collision_mesh, write_collision_file, source_file_hash, build_scene_cache, write_scene_cache_file,
+// load_scene_cache_file, process_stream_mesh, build_stream_mesh, write_stream_mesh_file, index_mesh_nodes, select_meshes,
+// process_selected_meshes, write_multi_mesh_file, map_file, build_anim_bounds
+struct export_stage_stats
+{
+	const char* name;				// static string owned by the dll
+	double milliseconds;			// wall time, summed over every call
+	uint32_t calls;
+	uint64_t items_in;				// what the stage consumed, e.g. vertices in, joints
+	uint64_t items_out;				// what it produced, e.g. vertices out, frames
+	uint64_t bytes_written;
+	uint64_t peak_bytes;			// highest process peak private bytes seen when the stage finished
+};
+
+const uint32_t EXPORT_MAX_STAGES = 64;
+
+struct export_stats
+{
+	uint32_t stage_count;
+	uint32_t dropped_stages;		// stages that ran but didn't fit in 'stages', 0 unless the list above outgrows it
+	export_stage_stats stages[EXPORT_MAX_STAGES];
+	uint64_t peak_bytes;			// peak private bytes of the whole process
+};
+
+// Called every time a stage finishes, from the thread that ran it. 'stage' holds that single call
+typedef void (*export_stage_callback)(const export_stage_stats* stage, void* user_data);
+
+extern "C" FBXEXPORTER_API int set_export_stage_callback(export_stage_callback callback, void* user_data);
+
+// Totals per stage since the last 'reset_export_stats'
+// Returns 1 when more stages ran than 'stages' holds, the first EXPORT_MAX_STAGES are filled in and the rest counted in 'dropped_stages'
+extern "C" FBXEXPORTER_API int get_export_stats(export_stats* out_stats);
+
+extern "C" FBXEXPORTER_API int reset_export_stats();
+
+// Writes every stage call since the last reset as a Chrome trace_event json (chrome://tracing, ui.perfetto.dev)
+extern "C" FBXEXPORTER_API int write_export_trace(const char* trace_file_path);
@@ -0,0 +1,313 @@
+#include "pch.h"
+#include "anim_bounds.h"
+#include "profiler.h"
+#include "skinning.h"
+
+#include <cassert>
+#include <cmath>
+#include <cfloat>
+#include <atomic>
+#include <thread>
+#include <system_error>
+#include <algorithm>
+
+namespace end
+{
+	namespace
+	{
+		aabb Empty_Box()
+		{
+			aabb box;
+			box.min = { FLT_MAX, FLT_MAX, FLT_MAX };
+			box.max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			return box;
+		}
+
+		void Grow(aabb& box, float x, float y, float z, float radius)
+		{
+			box.min = { std::min(box.min.x, x - radius), std::min(box.min.y, y - radius), std::min(box.min.z, z - radius) };
+			box.max = { std::max(box.max.x, x + radius), std::max(box.max.y, y + radius), std::max(box.max.z, z + radius) };
+		}
+
+		void Grow(aabb& box, const aabb& other)
+		{
+			Grow(box, other.min.x, other.min.y, other.min.z, 0.0f);
+			Grow(box, other.max.x, other.max.y, other.max.z, 0.0f);
+		}
+
+		// how much the joint's transform stretches a vector at most, its longest basis row
+		float Max_Scale(const DirectX::XMFLOAT4X4& xform)
+		{
+			float scale = 0.0f;
+			for (int row = 0; row < 3; ++row)
+				scale = std::max(scale, std::sqrt(xform.m[row][0] * xform.m[row][0] + xform.m[row][1] * xform.m[row][1] + xform.m[row][2] * xform.m[row][2]));
+			return scale;
+		}
+
+		// the runtime decodes with exactly this, the writer checks its rounding against it.
+		// The ends are the clip box itself, min + (max - min) can round below max
+		float Dequantize(float min, float max, uint16_t value)
+		{
+			if (value == 65535)
+				return max;
+			return min + (max - min) * (value / 65535.0f);
+		}
+
+		uint16_t Quantize_Down(float min, float max, float value)
+		{
+			if (max <= min)
+				return 0;
+			double steps = std::floor((double(value) - min) / (double(max) - min) * 65535.0);
+			uint16_t q = static_cast<uint16_t>(std::clamp(steps, 0.0, 65535.0));
+			while (q > 0 && Dequantize(min, max, q) > value)
+				--q;
+			return q;
+		}
+
+		uint16_t Quantize_Up(float min, float max, float value)
+		{
+			if (max <= min)
+				return 65535;
+			double steps = std::ceil((double(value) - min) / (double(max) - min) * 65535.0);
+			uint16_t q = static_cast<uint16_t>(std::clamp(steps, 0.0, 65535.0));
+			while (q < 65535 && Dequantize(min, max, q) < value)
+				++q;
+			return q;
+		}
+	}
+
+	void Joint_Radii(const std::vector<bounds_mesh>& meshes, const std::vector<DirectX::XMFLOAT4X4>& inverse_bind, std::vector<float>& out_radii)
+	{
+		using namespace DirectX;
+
+		out_radii.assign(inverse_bind.size(), -1.0f);
+		for (const bounds_mesh& mesh : meshes)
+		{
+			for (size_t p = 0; p < mesh.positions.size(); ++p)
+			{
+				XMVECTOR position = XMLoadFloat3(&mesh.positions[p]);
+				for (const influence& inf : mesh.influences[p])
+				{
+					if (inf.weight <= 0.0f || inf.joint < 0 || static_cast<size_t>(inf.joint) >= inverse_bind.size())
+						continue;
+					XMVECTOR local = XMVector3Transform(position, XMLoadFloat4x4(&inverse_bind[inf.joint]));
+					out_radii[inf.joint] = std::max(out_radii[inf.joint], XMVectorGetX(XMVector3Length(local)));
+				}
+			}
+		}
+	}
+
+	int Build_Anim_Bounds(const AnimClip& clip, const std::vector<bounds_mesh>& meshes, const anim_bounds_options& options,
+		export_control* control, anim_bounds& out_bounds)
+	{
+		FBX_PROFILE_SCOPE(scope, "build_anim_bounds");
+		size_t frame_count = clip.frames.size();
+		size_t joint_count = frame_count ? clip.frames[0].joints.size() : 0;
+		out_bounds = anim_bounds();
+		out_bounds.frames.resize(frame_count);
+
+		// both sources only need the bind pose once
+		std::vector<DirectX::XMFLOAT4X4> inverse_bind(joint_count);
+		for (size_t j = 0; j < joint_count; ++j)
+			inverse_bind[j] = clip.frames[0].joints[j].inverse_xform;
+
+		size_t vert_count = 0;
+		for (const bounds_mesh& mesh : meshes)
+			vert_count += mesh.positions.size();
+		bool skinned = options.source == BOUNDS_SKINNED_MESH && vert_count > 0 && joint_count > 0;
+
+		skin_batch batch;
+		if (skinned)
+		{
+			std::vector<simple_vert> verts(vert_count);
+			size_t v = 0;
+			for (const bounds_mesh& mesh : meshes)
+			{
+				for (size_t p = 0; p < mesh.positions.size(); ++p, ++v)
+				{
+					verts[v] = simple_vert();
+					verts[v].pos = { mesh.positions[p].x, mesh.positions[p].y, mesh.positions[p].z, 1.0f };
+					for (int k = 0; k < MAX_INFLUENCES; ++k)
+					{
+						bool valid = mesh.influences[p][k].joint >= 0 && static_cast<size_t>(mesh.influences[p][k].joint) < joint_count;
+						verts[v].joint_index[k] = valid ? mesh.influences[p][k].joint : 0;
+						verts[v].weights[k] = valid ? mesh.influences[p][k].weight : 0.0f;
+					}
+				}
+			}
+			Make_Skin_Batch(verts.data(), verts.size(), batch);
+		}
+
+		// joints moving no vertex are left out, unless no joint moves any
+		std::vector<float> radii;
+		if (!skinned)
+		{
+			Joint_Radii(meshes, inverse_bind, radii);
+			if (std::all_of(radii.begin(), radii.end(), [](float radius) { return radius < 0.0f; }))
+				std::fill(radii.begin(), radii.end(), 0.0f);
+		}
+
+		// frames share nothing, each thread takes the next one left. Only the calling thread reports progress
+		std::atomic<size_t> next{ 0 };
+		std::atomic<bool> failed{ false };
+		auto frames = [&](bool report)
+		{
+			std::vector<DirectX::XMFLOAT4X4> model_pose(joint_count), palette;
+			skinned_batch posed;
+			for (size_t f = next++; f < frame_count; f = next++)
+			{
+				if (failed || (report ? Export_Checkpoint("build_anim_bounds", f, frame_count) : control && control->cancelled.load(std::memory_order_relaxed)))
+					return;
+
+				const myKeyFrame& frame = clip.frames[f];
+				aabb box = Empty_Box();
+				if (skinned)
+				{
+					for (size_t j = 0; j < joint_count; ++j)
+						model_pose[j] = frame.joints[j].global_xform;
+					Build_Skinning_Palette(model_pose, inverse_bind, palette);
+					for (auto* stream : { &posed.px, &posed.py, &posed.pz, &posed.nx, &posed.ny, &posed.nz })
+						stream->resize(batch.padded_count);
+					Skin_Range(palette, batch, 0, batch.vert_count, SKIN_BEST, posed);
+					for (size_t v = 0; v < batch.vert_count; ++v)
+						Grow(box, posed.px[v], posed.py[v], posed.pz[v], options.padding);
+				}
+				else
+				{
+					for (size_t j = 0; j < joint_count && j < frame.joints.size(); ++j)
+					{
+						if (radii[j] < 0.0f)
+							continue;
+						const DirectX::XMFLOAT4X4& xform = frame.joints[j].global_xform;
+						Grow(box, xform._41, xform._42, xform._43, radii[j] * Max_Scale(xform) + options.padding);
+					}
+				}
+				if (box.min.x > box.max.x)
+					box = aabb();
+				out_bounds.frames[f] = box;
+			}
+		};
+		// nothing would catch it on a helper thread, a bad_alloc there would end the whole process
+		auto work = [&](bool report)
+		{
+			try
+			{
+				frames(report);
+			}
+			catch (...)
+			{
+				failed = true;
+			}
+		};
+
+		// helpers run under the caller's control, it's the one a cancel sets
+		size_t thread_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), std::max<size_t>(frame_count, 1));
+		std::vector<std::thread> helpers;
+		try
+		{
+			for (size_t t = 1; t < thread_count; ++t)
+			{
+				helpers.emplace_back([&]
+				{
+					Set_Export_Control(control);
+					work(false);
+					Set_Export_Control(nullptr);
+				});
+			}
+		}
+		catch (const std::system_error&)
+		{
+			// out of threads, the ones started and this one share the frames
+		}
+		work(true);
+		for (std::thread& helper : helpers)
+			helper.join();
+		if (failed || Export_Cancelled())
+			return -1;
+		Export_Checkpoint("build_anim_bounds", frame_count, frame_count);
+
+		if (frame_count > 0)
+		{
+			out_bounds.clip = out_bounds.frames[0];
+			for (const aabb& box : out_bounds.frames)
+				Grow(out_bounds.clip, box);
+		}
+		FBX_PROFILE_ITEMS(scope, vert_count, frame_count);
+
+		return 0;
+	}
+
+	void Write_Anim_Bounds(std::ofstream& file, const anim_bounds& bounds)
+	{
+		anim_bounds_header header;
+		header.frame_count = static_cast<uint32_t>(bounds.frames.size());
+		header.clip_min = bounds.clip.min;
+		header.clip_max = bounds.clip.max;
+		anim_bounds_footer footer;
+		footer.header_offset = static_cast<uint64_t>(file.tellp());
+
+		const float* clip_min = &bounds.clip.min.x;
+		const float* clip_max = &bounds.clip.max.x;
+		std::vector<uint16_t> frames(bounds.frames.size() * 6);
+		for (size_t f = 0; f < bounds.frames.size(); ++f)
+		{
+			const float* min = &bounds.frames[f].min.x;
+			const float* max = &bounds.frames[f].max.x;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				frames[f * 6 + axis] = Quantize_Down(clip_min[axis], clip_max[axis], min[axis]);
+				frames[f * 6 + 3 + axis] = Quantize_Up(clip_min[axis], clip_max[axis], max[axis]);
+			}
+		}
+
+		file.write((char const*)&header, sizeof(anim_bounds_header));
+		file.write((char const*)frames.data(), sizeof(uint16_t) * frames.size());
+		file.write((char const*)&footer, sizeof(anim_bounds_footer));
+	}
+
+	int Load_Anim_Bounds(const char* anim_file_path, anim_bounds& out_bounds)
+	{
+		std::ifstream file(anim_file_path, std::ios::binary | std::ios::in | std::ios::ate);
+		if (!file.is_open())
+			return -1;
+
+		std::streamoff size = file.tellg();
+		if (size < static_cast<std::streamoff>(sizeof(anim_bounds_footer)))
+			return -1;
+		anim_bounds_footer footer;
+		file.seekg(size - static_cast<std::streamoff>(sizeof(anim_bounds_footer)));
+		file.read((char*)&footer, sizeof(anim_bounds_footer));
+		if (!file.good() || footer.magic != ANIM_BOUNDS_MAGIC || footer.version != ANIM_BOUNDS_VERSION)
+			return -1;
+
+		anim_bounds_header header;
+		file.seekg(static_cast<std::streamoff>(footer.header_offset));
+		file.read((char*)&header, sizeof(anim_bounds_header));
+		if (!file.good() || footer.header_offset + sizeof(anim_bounds_header) + sizeof(uint16_t) * 6 * uint64_t(header.frame_count) +
+			sizeof(anim_bounds_footer) != static_cast<uint64_t>(size))
+			return -1;
+
+		std::vector<uint16_t> frames(size_t(header.frame_count) * 6);
+		file.read((char*)frames.data(), sizeof(uint16_t) * frames.size());
+		if (!file.good())
+			return -1;
+
+		out_bounds = anim_bounds();
+		out_bounds.clip.min = header.clip_min;
+		out_bounds.clip.max = header.clip_max;
+		out_bounds.frames.resize(header.frame_count);
+		const float* clip_min = &header.clip_min.x;
+		const float* clip_max = &header.clip_max.x;
+		for (size_t f = 0; f < out_bounds.frames.size(); ++f)
+		{
+			float* min = &out_bounds.frames[f].min.x;
+			float* max = &out_bounds.frames[f].max.x;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				min[axis] = Dequantize(clip_min[axis], clip_max[axis], frames[f * 6 + axis]);
+				max[axis] = Dequantize(clip_min[axis], clip_max[axis], frames[f * 6 + 3 + axis]);
+			}
+		}
+		return 0;
+	}
+}
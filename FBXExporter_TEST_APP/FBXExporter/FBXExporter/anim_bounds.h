@@ -0,0 +1,88 @@
+#pragma once
+
+#include "simple_mesh.h"
+#include "mesh_processing.h"
+#include "export_progress.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <DirectXMath.h>
+
+// A box per sampled frame of a .anim, so the runtime can cull an animated character on the pose it's actually in
+// instead of one conservative box around the bind pose, and skip skinning it while it's out of view.
+// No Fbx sdk dependency
+namespace end
+{
+	enum anim_bounds_source : uint32_t
+	{
+		BOUNDS_SKINNED_MESH = 0,	// every skinned control point skinned to the frame's pose, exact
+		BOUNDS_JOINT_RADII			// every joint's position grown by how far its vertices reach, looser but cheaper
+	};
+
+	struct aabb
+	{
+		DirectX::XMFLOAT3 min = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 max = { 0.0f, 0.0f, 0.0f };
+	};
+
+	// a skinned mesh's control points and the joints moving them, what the bounds are built from
+	struct bounds_mesh
+	{
+		std::vector<DirectX::XMFLOAT3> positions;
+		std::pmr::vector<influence_set> influences;		// per position, joints index the clip's joints
+	};
+
+	struct anim_bounds_options
+	{
+		anim_bounds_source source = BOUNDS_SKINNED_MESH;
+		float padding = 0.0f;			// added on every side of every box, scene units
+	};
+
+	struct anim_bounds
+	{
+		aabb clip;						// union of every frame
+		std::vector<aabb> frames;		// one per frame of the clip
+	};
+
+	// Per joint, the furthest any vertex with a weight on it sits from it in the bind pose, measured in the joint's own space.
+	// Joints moving no vertex get -1
+	void Joint_Radii(const std::vector<bounds_mesh>& meshes, const std::vector<DirectX::XMFLOAT4X4>& inverse_bind, std::vector<float>& out_radii);
+
+	// Bounds of 'meshes' for every frame of 'clip', the frames split over every hardware thread.
+	// Without any mesh the joints' positions alone are boxed, grown by the padding.
+	// Returns 0 on success, -1 when the export was cancelled
+	int Build_Anim_Bounds(const AnimClip& clip, const std::vector<bounds_mesh>& meshes, const anim_bounds_options& options,
+		export_control* control, anim_bounds& out_bounds);
+
+	// Bounds trail the frames of a .anim, readers of the original layout stop before them
+	//	anim_bounds_header
+	//	uint16_t frames[frame_count][6]		min xyz then max xyz in 1/65535 steps of the clip box, mins rounded down and maxes up,
+	//										65535 is the clip box's max exactly
+	//	anim_bounds_footer					the last 16 bytes of the file
+	const uint32_t ANIM_BOUNDS_MAGIC = 0x444E4241; // "ABND"
+	const uint32_t ANIM_BOUNDS_VERSION = 1;
+
+	struct anim_bounds_header
+	{
+		uint32_t frame_count = 0;
+		uint32_t unused = 0;
+		DirectX::XMFLOAT3 clip_min;
+		DirectX::XMFLOAT3 clip_max;
+	};
+
+	struct anim_bounds_footer
+	{
+		uint64_t header_offset = 0;		// from the start of the file
+		uint32_t magic = ANIM_BOUNDS_MAGIC;
+		uint32_t version = ANIM_BOUNDS_VERSION;
+	};
+
+	// Appends the bounds to a .anim being written
+	void Write_Anim_Bounds(std::ofstream& file, const anim_bounds& bounds);
+
+	// The frame boxes come back decoded, never smaller than the ones written.
+	// Returns 0 on success, non-zero when the file has no bounds or can't be read
+	int Load_Anim_Bounds(const char* anim_file_path, anim_bounds& out_bounds);
+}
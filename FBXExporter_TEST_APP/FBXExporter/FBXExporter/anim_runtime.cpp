@@ -0,0 +1,297 @@
+#include "pch.h"
+#include "anim_runtime.h"
+#include "fnv1a.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace end
+{
+	namespace
+	{
+		DirectX::XMFLOAT3 Lerp(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, float t)
+		{
+			return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+		}
+
+		// normalized lerp along the shortest arc
+		DirectX::XMFLOAT4 Nlerp(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, float t)
+		{
+			float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+			float sign = dot < 0.0f ? -1.0f : 1.0f;
+
+			DirectX::XMFLOAT4 q = {
+				a.x + (sign * b.x - a.x) * t,
+				a.y + (sign * b.y - a.y) * t,
+				a.z + (sign * b.z - a.z) * t,
+				a.w + (sign * b.w - a.w) * t
+			};
+			float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+			if (length > 0.0f)
+			{
+				q.x /= length; q.y /= length; q.z /= length; q.w /= length;
+			}
+			return q;
+		}
+
+		// finds the pair of keys around 'time' and how far between them it is
+		void Find_Segment(const std::vector<float>& times, float time, size_t& first, size_t& second, float& t)
+		{
+			auto next = std::upper_bound(times.begin(), times.end(), time);
+			if (next == times.begin())
+			{
+				first = second = 0;
+				t = 0.0f;
+				return;
+			}
+			if (next == times.end())
+			{
+				first = second = times.size() - 1;
+				t = 0.0f;
+				return;
+			}
+			second = static_cast<size_t>(next - times.begin());
+			first = second - 1;
+			t = (time - times[first]) / (times[second] - times[first]);
+		}
+
+		DirectX::XMFLOAT3 Sample_Channel(const key_channel<DirectX::XMFLOAT3>& channel, float time, const DirectX::XMFLOAT3& fallback)
+		{
+			if (channel.times.empty())
+				return fallback;
+			size_t first, second;
+			float t;
+			Find_Segment(channel.times, time, first, second, t);
+			return Lerp(channel.values[first], channel.values[second], t);
+		}
+
+		DirectX::XMFLOAT4 Sample_Channel(const key_channel<DirectX::XMFLOAT4>& channel, float time, const DirectX::XMFLOAT4& fallback)
+		{
+			if (channel.times.empty())
+				return fallback;
+			size_t first, second;
+			float t;
+			Find_Segment(channel.times, time, first, second, t);
+			return Nlerp(channel.values[first], channel.values[second], t);
+		}
+
+		bool Read_Key_Header(std::ifstream& file, float sample_rate, std::vector<float>& times, uint8_t& format)
+		{
+			uint16_t key_count = 0;
+			uint8_t time_format = 0;
+			file.read((char*)&key_count, sizeof(uint16_t));
+			file.read((char*)&format, sizeof(uint8_t));
+			file.read((char*)&time_format, sizeof(uint8_t));
+
+			times.resize(key_count);
+			if (time_format == KEY_TIME_SECONDS)
+			{
+				file.read((char*)times.data(), sizeof(float) * key_count);
+				return file.good();
+			}
+			if (time_format != KEY_TIME_FRAMES16)
+				return false;
+
+			std::vector<uint16_t> frames(key_count);
+			file.read((char*)frames.data(), sizeof(uint16_t) * key_count);
+			for (size_t k = 0; k < key_count; ++k)
+				times[k] = frames[k] / sample_rate;
+			return file.good();
+		}
+
+		bool Read_Vec3_Channel(std::ifstream& file, float sample_rate, key_channel<DirectX::XMFLOAT3>& channel)
+		{
+			uint8_t format = 0;
+			if (!Read_Key_Header(file, sample_rate, channel.times, format))
+				return false;
+
+			size_t key_count = channel.times.size();
+			channel.values.resize(key_count);
+			if (format == TRACK_FLOAT3)
+			{
+				file.read((char*)channel.values.data(), sizeof(DirectX::XMFLOAT3) * key_count);
+				return file.good();
+			}
+			if (format != TRACK_QUANTIZED16)
+				return false;
+
+			DirectX::XMFLOAT3 low, extent;
+			file.read((char*)&low, sizeof(DirectX::XMFLOAT3));
+			file.read((char*)&extent, sizeof(DirectX::XMFLOAT3));
+			std::vector<uint16_t> packed(key_count * 3);
+			file.read((char*)packed.data(), sizeof(uint16_t) * packed.size());
+
+			for (size_t k = 0; k < key_count; ++k)
+			{
+				channel.values[k] = {
+					low.x + packed[k * 3 + 0] / float(UINT16_MAX) * extent.x,
+					low.y + packed[k * 3 + 1] / float(UINT16_MAX) * extent.y,
+					low.z + packed[k * 3 + 2] / float(UINT16_MAX) * extent.z
+				};
+			}
+			return file.good();
+		}
+
+		bool Read_Rotation_Channel(std::ifstream& file, float sample_rate, key_channel<DirectX::XMFLOAT4>& channel)
+		{
+			uint8_t format = 0;
+			if (!Read_Key_Header(file, sample_rate, channel.times, format) || format != TRACK_PACKED_QUAT)
+				return false;
+
+			std::vector<packed_quat> packed(channel.times.size());
+			file.read((char*)packed.data(), sizeof(packed_quat) * packed.size());
+
+			channel.values.resize(packed.size());
+			for (size_t k = 0; k < packed.size(); ++k)
+				channel.values[k] = Unpack_Quaternion(packed[k]);
+			return file.good();
+		}
+
+		int Read_Header(std::ifstream& file, track_file_header& header, std::vector<int>& parent_indices, std::vector<clip_directory_entry>& directory,
+			std::vector<std::string>& names)
+		{
+			file.read((char*)&header, sizeof(track_file_header));
+			if (!file.good() || header.magic != TRACK_FILE_MAGIC || header.version != TRACK_FILE_VERSION)
+				return -1;
+
+			parent_indices.resize(header.joint_count);
+			file.read((char*)parent_indices.data(), sizeof(int) * header.joint_count);
+			directory.resize(header.clip_count);
+			file.read((char*)directory.data(), sizeof(clip_directory_entry) * header.clip_count);
+			names.resize(header.clip_count);
+			for (auto& name : names)
+			{
+				uint16_t length = 0;
+				file.read((char*)&length, sizeof(uint16_t));
+				name.resize(file.good() ? length : 0);
+				file.read(&name[0], name.size());
+			}
+			return file.good() ? 0 : -1;
+		}
+
+		int Read_Clip(std::ifstream& file, const track_file_header& header, const clip_directory_entry& entry, const std::string& name,
+			const std::vector<int>& parent_indices, track_clip& out_clip)
+		{
+			if (entry.sample_rate <= 0.0f)
+				return -1;
+
+			out_clip.name = name;
+			out_clip.duration = entry.duration;
+			out_clip.sample_rate = entry.sample_rate;
+			out_clip.skeleton_hash = header.skeleton_hash;
+			out_clip.parent_indices = parent_indices;
+
+			file.seekg(entry.offset);
+			out_clip.tracks.clear();
+			out_clip.tracks.resize(parent_indices.size());
+			for (auto& track : out_clip.tracks)
+			{
+				if (!Read_Vec3_Channel(file, entry.sample_rate, track.translation)
+					|| !Read_Rotation_Channel(file, entry.sample_rate, track.rotation))
+					return -1;
+				if ((entry.flags & TRACK_HAS_SCALE) && !Read_Vec3_Channel(file, entry.sample_rate, track.scale))
+					return -1;
+			}
+			return 0;
+		}
+	}
+
+	int Load_Track_File(const char* file_path, std::vector<track_clip>& out_clips)
+	{
+		std::ifstream file(file_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+			return -1;
+
+		track_file_header header;
+		std::vector<int> parent_indices;
+		std::vector<clip_directory_entry> directory;
+		std::vector<std::string> names;
+		if (Read_Header(file, header, parent_indices, directory, names) != 0)
+			return -1;
+
+		out_clips.clear();
+		out_clips.resize(directory.size());
+		for (size_t c = 0; c < directory.size(); ++c)
+		{
+			if (Read_Clip(file, header, directory[c], names[c], parent_indices, out_clips[c]) != 0)
+				return -1;
+		}
+		return 0;
+	}
+
+	int Load_Track_File(const char* file_path, const char* clip_name, track_clip& out_clip)
+	{
+		std::ifstream file(file_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+			return -1;
+
+		track_file_header header;
+		std::vector<int> parent_indices;
+		std::vector<clip_directory_entry> directory;
+		std::vector<std::string> names;
+		if (Read_Header(file, header, parent_indices, directory, names) != 0)
+			return -1;
+
+		uint64_t hash = fnv1a(clip_name, strlen(clip_name));
+		for (size_t c = 0; c < directory.size(); ++c)
+		{
+			if (directory[c].name_hash == hash && names[c] == clip_name)
+				return Read_Clip(file, header, directory[c], names[c], parent_indices, out_clip);
+		}
+		return -1;
+	}
+
+	const track_clip* Find_Clip(const std::vector<track_clip>& clips, const char* clip_name)
+	{
+		for (auto& clip : clips)
+		{
+			if (clip.name == clip_name)
+				return &clip;
+		}
+		return nullptr;
+	}
+
+	void Sample_Clip(const track_clip& clip, float time, std::vector<trs>& out_pose)
+	{
+		const trs identity;
+		out_pose.resize(clip.tracks.size());
+		for (size_t j = 0; j < clip.tracks.size(); ++j)
+		{
+			const joint_track& track = clip.tracks[j];
+			out_pose[j].translation = Sample_Channel(track.translation, time, identity.translation);
+			out_pose[j].rotation = Sample_Channel(track.rotation, time, identity.rotation);
+			out_pose[j].scale = Sample_Channel(track.scale, time, identity.scale);
+		}
+	}
+
+	void Blend_Poses(const std::vector<trs>& a, const std::vector<trs>& b, float weight, std::vector<trs>& out_pose)
+	{
+		size_t joint_count = std::min(a.size(), b.size());
+		out_pose.resize(joint_count);
+		for (size_t j = 0; j < joint_count; ++j)
+		{
+			out_pose[j].translation = Lerp(a[j].translation, b[j].translation, weight);
+			out_pose[j].rotation = Nlerp(a[j].rotation, b[j].rotation, weight);
+			out_pose[j].scale = Lerp(a[j].scale, b[j].scale, weight);
+		}
+	}
+
+	void Local_To_Model(const std::vector<int>& parent_indices, const std::vector<trs>& pose, std::vector<DirectX::XMFLOAT4X4>& out_model)
+	{
+		using namespace DirectX;
+
+		out_model.resize(pose.size());
+		for (size_t j = 0; j < pose.size(); ++j)
+		{
+			XMMATRIX local = XMMatrixAffineTransformation(
+				XMLoadFloat3(&pose[j].scale), XMVectorZero(), XMLoadFloat4(&pose[j].rotation), XMLoadFloat3(&pose[j].translation));
+
+			int parent = parent_indices[j];
+			if (parent >= 0)
+				local = XMMatrixMultiply(local, XMLoadFloat4x4(&out_model[parent]));
+			XMStoreFloat4x4(&out_model[j], local);
+		}
+	}
+}
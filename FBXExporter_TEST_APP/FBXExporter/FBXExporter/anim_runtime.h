@@ -0,0 +1,28 @@
+#pragma once
+
+#include "anim_tracks.h"
+
+// Runtime side of the .anim track files.
+// Nothing in here needs the Fbx sdk, engines can compile this file straight into their own projects.
+namespace end
+{
+	// Reads every clip of a track file written by 'export_animation_tracks'
+	// Returns 0 on success, non-zero to indicate failure
+	int Load_Track_File(const char* file_path, std::vector<track_clip>& out_clips);
+
+	// Reads only the clip called 'clip_name', using the file's clip directory to skip the rest
+	int Load_Track_File(const char* file_path, const char* clip_name, track_clip& out_clip);
+
+	// Returns the clip called 'clip_name' or null
+	const track_clip* Find_Clip(const std::vector<track_clip>& clips, const char* clip_name);
+
+	// Samples every joint of 'clip' at 'time' (seconds) into a local space pose
+	void Sample_Clip(const track_clip& clip, float time, std::vector<trs>& out_pose);
+
+	// Blends two local space poses, a 'weight' of 0 gives 'a' and 1 gives 'b'
+	void Blend_Poses(const std::vector<trs>& a, const std::vector<trs>& b, float weight, std::vector<trs>& out_pose);
+
+	// Concatenates a local space pose down the hierarchy into model space matrices
+	// Parents must come before their children, which is how the exporter writes them
+	void Local_To_Model(const std::vector<int>& parent_indices, const std::vector<trs>& pose, std::vector<DirectX::XMFLOAT4X4>& out_model);
+}
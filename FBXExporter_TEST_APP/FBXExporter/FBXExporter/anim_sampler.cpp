@@ -0,0 +1,254 @@
+#include "pch.h"
+#include "anim_sampler.h"
+
+#include <algorithm>
+#include <new>
+#include <immintrin.h>
+
+namespace end
+{
+	namespace
+	{
+		const size_t STREAM_ALIGNMENT = 32;
+
+		size_t Align_Up(size_t bytes) { return (bytes + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1); }
+
+#if defined(__AVX__)
+		const size_t LANES = 8;
+		using lane = __m256;
+		inline lane Load(const float* p) { return _mm256_loadu_ps(p); }
+		inline void Store(float* p, lane v) { _mm256_storeu_ps(p, v); }
+		inline lane Set(float v) { return _mm256_set1_ps(v); }
+		inline lane Add(lane a, lane b) { return _mm256_add_ps(a, b); }
+		inline lane Sub(lane a, lane b) { return _mm256_sub_ps(a, b); }
+		inline lane Mul(lane a, lane b) { return _mm256_mul_ps(a, b); }
+		inline lane Div(lane a, lane b) { return _mm256_div_ps(a, b); }
+		inline lane Sqrt(lane a) { return _mm256_sqrt_ps(a); }
+		inline lane Xor(lane a, lane b) { return _mm256_xor_ps(a, b); }
+		inline lane And(lane a, lane b) { return _mm256_and_ps(a, b); }
+		inline lane Less(lane a, lane b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+#else
+		const size_t LANES = 4;
+		using lane = __m128;
+		inline lane Load(const float* p) { return _mm_loadu_ps(p); }
+		inline void Store(float* p, lane v) { _mm_storeu_ps(p, v); }
+		inline lane Set(float v) { return _mm_set1_ps(v); }
+		inline lane Add(lane a, lane b) { return _mm_add_ps(a, b); }
+		inline lane Sub(lane a, lane b) { return _mm_sub_ps(a, b); }
+		inline lane Mul(lane a, lane b) { return _mm_mul_ps(a, b); }
+		inline lane Div(lane a, lane b) { return _mm_div_ps(a, b); }
+		inline lane Sqrt(lane a) { return _mm_sqrt_ps(a); }
+		inline lane Xor(lane a, lane b) { return _mm_xor_ps(a, b); }
+		inline lane And(lane a, lane b) { return _mm_and_ps(a, b); }
+		inline lane Less(lane a, lane b) { return _mm_cmplt_ps(a, b); }
+#endif
+
+		inline lane Lerp(lane a, lane b, lane t) { return Add(a, Mul(Sub(b, a), t)); }
+
+		// finds the key at or before 'time', starting from where the previous sample left off
+		uint32_t Find_Key(const float* times, uint32_t count, float time, uint32_t& cursor)
+		{
+			if (cursor >= count || times[cursor] > time)
+			{
+				uint32_t after = static_cast<uint32_t>(std::upper_bound(times, times + count, time) - times);
+				cursor = after > 0 ? after - 1 : 0;
+			}
+			while (cursor + 1 < count && times[cursor + 1] <= time)
+				++cursor;
+			return cursor;
+		}
+
+		// writes the two keys around 'time' and the blend factor between them into the gather streams
+		template<size_t N>
+		void Gather(const float* times, const float* const (&components)[N], const packed_clip::range& range, float time,
+			uint32_t& cursor, const float(&identity)[N], float* const (&from)[N], float* const (&to)[N], float* alpha, size_t joint)
+		{
+			if (range.count == 0)
+			{
+				for (size_t c = 0; c < N; ++c)
+					from[c][joint] = to[c][joint] = identity[c];
+				alpha[joint] = 0.0f;
+				return;
+			}
+
+			const float* keys = times + range.first;
+			uint32_t first = Find_Key(keys, range.count, time, cursor);
+			uint32_t second = std::min(first + 1, range.count - 1);
+
+			float span = keys[second] - keys[first];
+			alpha[joint] = span > 0.0f ? std::clamp((time - keys[first]) / span, 0.0f, 1.0f) : 0.0f;
+			for (size_t c = 0; c < N; ++c)
+			{
+				from[c][joint] = components[c][range.first + first];
+				to[c][joint] = components[c][range.first + second];
+			}
+		}
+	}
+
+	void packed_clip::aligned_delete::operator()(uint8_t* p) const
+	{
+		::operator delete(p, std::align_val_t(STREAM_ALIGNMENT));
+	}
+
+	void Pack_Clip(const track_clip& clip, packed_clip& out_clip)
+	{
+		uint32_t joint_count = static_cast<uint32_t>(clip.tracks.size());
+		size_t translation_keys = 0, rotation_keys = 0, scale_keys = 0;
+		for (auto& track : clip.tracks)
+		{
+			translation_keys += track.translation.times.size();
+			rotation_keys += track.rotation.times.size();
+			scale_keys += track.scale.times.size();
+		}
+
+		// lay every array out in one block, each starting on its own alignment boundary
+		size_t size = 0;
+		auto place = [&size](size_t bytes) { size_t offset = size; size += Align_Up(bytes); return offset; };
+		size_t parents_at = place(sizeof(int) * joint_count);
+		size_t ranges_at[3] = { place(sizeof(packed_clip::range) * joint_count), place(sizeof(packed_clip::range) * joint_count), place(sizeof(packed_clip::range) * joint_count) };
+		size_t translation_at[4], rotation_at[5], scale_at[4];
+		for (auto& at : translation_at) at = place(sizeof(float) * translation_keys);
+		for (auto& at : rotation_at) at = place(sizeof(float) * rotation_keys);
+		for (auto& at : scale_at) at = place(sizeof(float) * scale_keys);
+
+		uint8_t* memory = static_cast<uint8_t*>(::operator new(std::max<size_t>(size, 1), std::align_val_t(STREAM_ALIGNMENT)));
+		out_clip.memory.reset(memory);
+		out_clip.memory_size = size;
+		out_clip.duration = static_cast<float>(clip.duration);
+		out_clip.joint_count = joint_count;
+
+		int* parents = reinterpret_cast<int*>(memory + parents_at);
+		packed_clip::range* ranges[3];
+		for (int c = 0; c < 3; ++c)
+			ranges[c] = reinterpret_cast<packed_clip::range*>(memory + ranges_at[c]);
+		float* translation[4];
+		float* rotation[5];
+		float* scale[4];
+		for (int c = 0; c < 4; ++c) translation[c] = reinterpret_cast<float*>(memory + translation_at[c]);
+		for (int c = 0; c < 5; ++c) rotation[c] = reinterpret_cast<float*>(memory + rotation_at[c]);
+		for (int c = 0; c < 4; ++c) scale[c] = reinterpret_cast<float*>(memory + scale_at[c]);
+
+		uint32_t next_translation = 0, next_rotation = 0, next_scale = 0;
+		for (uint32_t j = 0; j < joint_count; ++j)
+		{
+			const joint_track& track = clip.tracks[j];
+			parents[j] = j < clip.parent_indices.size() ? clip.parent_indices[j] : -1;
+
+			ranges[0][j] = { next_translation, static_cast<uint32_t>(track.translation.times.size()) };
+			for (size_t k = 0; k < track.translation.times.size(); ++k, ++next_translation)
+			{
+				translation[0][next_translation] = track.translation.times[k];
+				translation[1][next_translation] = track.translation.values[k].x;
+				translation[2][next_translation] = track.translation.values[k].y;
+				translation[3][next_translation] = track.translation.values[k].z;
+			}
+
+			ranges[1][j] = { next_rotation, static_cast<uint32_t>(track.rotation.times.size()) };
+			for (size_t k = 0; k < track.rotation.times.size(); ++k, ++next_rotation)
+			{
+				rotation[0][next_rotation] = track.rotation.times[k];
+				rotation[1][next_rotation] = track.rotation.values[k].x;
+				rotation[2][next_rotation] = track.rotation.values[k].y;
+				rotation[3][next_rotation] = track.rotation.values[k].z;
+				rotation[4][next_rotation] = track.rotation.values[k].w;
+			}
+
+			ranges[2][j] = { next_scale, static_cast<uint32_t>(track.scale.times.size()) };
+			for (size_t k = 0; k < track.scale.times.size(); ++k, ++next_scale)
+			{
+				scale[0][next_scale] = track.scale.times[k];
+				scale[1][next_scale] = track.scale.values[k].x;
+				scale[2][next_scale] = track.scale.values[k].y;
+				scale[3][next_scale] = track.scale.values[k].z;
+			}
+		}
+
+		out_clip.parent_indices = parents;
+		out_clip.translation_ranges = ranges[0];
+		out_clip.rotation_ranges = ranges[1];
+		out_clip.scale_ranges = ranges[2];
+		out_clip.translation = { translation[0], translation[1], translation[2], translation[3] };
+		out_clip.rotation = { rotation[0], rotation[1], rotation[2], rotation[3], rotation[4] };
+		out_clip.scale = { scale[0], scale[1], scale[2], scale[3] };
+	}
+
+	clip_sampler::clip_sampler(const packed_clip& clip)
+		: clip(&clip)
+		, lane_count((clip.joint_count + LANES - 1) / LANES * LANES)
+		, cursors(clip.joint_count * 3, 0)
+		, scratch(lane_count * STREAM_COUNT, 0.0f)
+	{
+	}
+
+	void clip_sampler::Sample(float time, std::vector<trs>& out_pose)
+	{
+		const packed_clip& c = *clip;
+		const float translation_identity[3] = { 0.0f, 0.0f, 0.0f };
+		const float rotation_identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		const float scale_identity[3] = { 1.0f, 1.0f, 1.0f };
+
+		const float* const translation[3] = { c.translation.x, c.translation.y, c.translation.z };
+		const float* const rotation[4] = { c.rotation.x, c.rotation.y, c.rotation.z, c.rotation.w };
+		const float* const scale[3] = { c.scale.x, c.scale.y, c.scale.z };
+
+		float* const t_from[3] = { Stream(T_FROM), Stream(T_FROM + 1), Stream(T_FROM + 2) };
+		float* const t_to[3] = { Stream(T_TO), Stream(T_TO + 1), Stream(T_TO + 2) };
+		float* const r_from[4] = { Stream(R_FROM), Stream(R_FROM + 1), Stream(R_FROM + 2), Stream(R_FROM + 3) };
+		float* const r_to[4] = { Stream(R_TO), Stream(R_TO + 1), Stream(R_TO + 2), Stream(R_TO + 3) };
+		float* const s_from[3] = { Stream(S_FROM), Stream(S_FROM + 1), Stream(S_FROM + 2) };
+		float* const s_to[3] = { Stream(S_TO), Stream(S_TO + 1), Stream(S_TO + 2) };
+
+		// gather the surrounding keys of every channel into lanes
+		for (uint32_t j = 0; j < c.joint_count; ++j)
+		{
+			Gather(c.translation.time, translation, c.translation_ranges[j], time, cursors[j * 3 + 0], translation_identity, t_from, t_to, Stream(T_ALPHA), j);
+			Gather(c.rotation.time, rotation, c.rotation_ranges[j], time, cursors[j * 3 + 1], rotation_identity, r_from, r_to, Stream(R_ALPHA), j);
+			Gather(c.scale.time, scale, c.scale_ranges[j], time, cursors[j * 3 + 2], scale_identity, s_from, s_to, Stream(S_ALPHA), j);
+		}
+
+		// interpolate LANES joints at a time, the padding lanes are zero and harmless
+		const lane zero = Set(0.0f);
+		const lane sign_bit = Set(-0.0f);
+		for (size_t i = 0; i < lane_count; i += LANES)
+		{
+			lane t = Load(Stream(T_ALPHA) + i);
+			for (int k = 0; k < 3; ++k)
+				Store(Stream(T_OUT + k) + i, Lerp(Load(t_from[k] + i), Load(t_to[k] + i), t));
+
+			lane s = Load(Stream(S_ALPHA) + i);
+			for (int k = 0; k < 3; ++k)
+				Store(Stream(S_OUT + k) + i, Lerp(Load(s_from[k] + i), Load(s_to[k] + i), s));
+
+			// normalized lerp, flipping the second key onto the first one's hemisphere
+			lane r = Load(Stream(R_ALPHA) + i);
+			lane a[4], b[4];
+			lane dot = zero;
+			for (int k = 0; k < 4; ++k)
+			{
+				a[k] = Load(r_from[k] + i);
+				b[k] = Load(r_to[k] + i);
+				dot = Add(dot, Mul(a[k], b[k]));
+			}
+			lane flip = And(Less(dot, zero), sign_bit);
+			lane q[4];
+			lane length_sq = zero;
+			for (int k = 0; k < 4; ++k)
+			{
+				q[k] = Lerp(a[k], Xor(b[k], flip), r);
+				length_sq = Add(length_sq, Mul(q[k], q[k]));
+			}
+			// padding lanes have zero length, keep them finite
+			lane length = Sqrt(Add(length_sq, And(Less(length_sq, Set(1e-20f)), Set(1.0f))));
+			for (int k = 0; k < 4; ++k)
+				Store(Stream(R_OUT + k) + i, Div(q[k], length));
+		}
+
+		out_pose.resize(c.joint_count);
+		for (uint32_t j = 0; j < c.joint_count; ++j)
+		{
+			out_pose[j].translation = { Stream(T_OUT)[j], Stream(T_OUT + 1)[j], Stream(T_OUT + 2)[j] };
+			out_pose[j].rotation = { Stream(R_OUT)[j], Stream(R_OUT + 1)[j], Stream(R_OUT + 2)[j], Stream(R_OUT + 3)[j] };
+			out_pose[j].scale = { Stream(S_OUT)[j], Stream(S_OUT + 1)[j], Stream(S_OUT + 2)[j] };
+		}
+	}
+}
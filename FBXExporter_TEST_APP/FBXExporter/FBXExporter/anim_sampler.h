@@ -0,0 +1,86 @@
+#pragma once
+
+#include "anim_tracks.h"
+
+#include <memory>
+
+// Structure of arrays clip layout and a SIMD pose sampler for it.
+// Like 'anim_runtime.h' this has no Fbx sdk dependency.
+namespace end
+{
+	// A track_clip flattened into a single allocation.
+	// The keys of every joint's channel sit back to back in shared per component streams,
+	// a joint's channel is the [first, first + count) range of those streams
+	struct packed_clip
+	{
+		struct range
+		{
+			uint32_t first = 0;
+			uint32_t count = 0;
+		};
+
+		struct vec3_stream
+		{
+			const float* time = nullptr;
+			const float* x = nullptr;
+			const float* y = nullptr;
+			const float* z = nullptr;
+		};
+
+		struct quat_stream
+		{
+			const float* time = nullptr;
+			const float* x = nullptr;
+			const float* y = nullptr;
+			const float* z = nullptr;
+			const float* w = nullptr;
+		};
+
+		float duration = 0.0f;
+		uint32_t joint_count = 0;
+
+		const int* parent_indices = nullptr;
+		const range* translation_ranges = nullptr;
+		const range* rotation_ranges = nullptr;
+		const range* scale_ranges = nullptr;
+
+		vec3_stream translation;
+		quat_stream rotation;
+		vec3_stream scale;
+
+		// every pointer above points in here
+		struct aligned_delete { void operator()(uint8_t* p) const; };
+		std::unique_ptr<uint8_t, aligned_delete> memory;
+		size_t memory_size = 0;
+	};
+
+	void Pack_Clip(const track_clip& clip, packed_clip& out_clip);
+
+	// Evaluates every joint of a packed clip at once.
+	// Key lookups are scalar and remember the last segment per channel so forward playback is a short walk,
+	// the interpolation itself runs 8 joints at a time with AVX or 4 at a time with SSE
+	class clip_sampler
+	{
+	public:
+		explicit clip_sampler(const packed_clip& clip);
+
+		void Sample(float time, std::vector<trs>& out_pose);
+
+	private:
+		enum e_stream
+		{
+			T_FROM = 0, T_TO = T_FROM + 3, T_ALPHA = T_TO + 3,
+			R_FROM, R_TO = R_FROM + 4, R_ALPHA = R_TO + 4,
+			S_FROM, S_TO = S_FROM + 3, S_ALPHA = S_TO + 3,
+			T_OUT, R_OUT = T_OUT + 3, S_OUT = R_OUT + 4,
+			STREAM_COUNT = S_OUT + 3
+		};
+
+		float* Stream(int stream) { return scratch.data() + stream * lane_count; }
+
+		const packed_clip* clip;
+		size_t lane_count;
+		std::vector<uint32_t> cursors;
+		std::vector<float> scratch;
+	};
+}
@@ -0,0 +1,388 @@
+#include "pch.h"
+#include "anim_tracks.h"
+#include "fnv1a.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <cassert>
+#include <cstring>
+
+namespace end
+{
+	namespace
+	{
+		struct position_channel
+		{
+			using value = DirectX::XMFLOAT3;
+
+			static const value& Get(const trs& pose) { return pose.translation; }
+
+			static value Interpolate(const value& a, const value& b, float t)
+			{
+				return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+			}
+
+			static float Error(const value& a, const value& b)
+			{
+				float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+				return std::sqrt(dx * dx + dy * dy + dz * dz);
+			}
+		};
+
+		struct scale_channel : position_channel
+		{
+			static const value& Get(const trs& pose) { return pose.scale; }
+		};
+
+		struct rotation_channel
+		{
+			using value = DirectX::XMFLOAT4;
+
+			static const value& Get(const trs& pose) { return pose.rotation; }
+
+			// normalized lerp, the runtime sampler blends the same way so the error bound holds there too
+			static value Interpolate(const value& a, const value& b, float t)
+			{
+				value q = { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+				float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+				if (length > 0.0f)
+				{
+					q.x /= length; q.y /= length; q.z /= length; q.w /= length;
+				}
+				return q;
+			}
+
+			// angle in radians between the two orientations
+			static float Error(const value& a, const value& b)
+			{
+				float dot = std::fabs(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+				return 2.0f * std::acos(std::min(dot, 1.0f));
+			}
+		};
+
+		// a segment never spans more samples than this, every candidate re-checks the samples back to its anchor
+		// so without the cap a long, nearly linear channel costs the square of its length
+		const size_t MAX_SEGMENT_SAMPLES = 128;
+
+		template<typename Channel>
+		void Reduce_Channel(const std::vector<trs>& samples, const std::vector<float>& sample_times, size_t joint_count,
+			size_t joint, float tolerance, key_channel<typename Channel::value>& out_channel)
+		{
+			size_t frame_count = sample_times.size();
+			out_channel.times.clear();
+			out_channel.values.clear();
+			if (frame_count == 0)
+				return;
+
+			auto value_at = [&](size_t frame) -> const typename Channel::value& { return Channel::Get(samples[frame * joint_count + joint]); };
+			auto add_key = [&](size_t frame)
+			{
+				out_channel.times.push_back(sample_times[frame]);
+				out_channel.values.push_back(value_at(frame));
+			};
+
+			// a joint that never moves collapses to a single key
+			bool constant = true;
+			for (size_t f = 1; f < frame_count && constant; ++f)
+				constant = Channel::Error(value_at(0), value_at(f)) <= tolerance;
+			if (constant)
+			{
+				add_key(0);
+				return;
+			}
+
+			// grow a segment from the last kept key until one of the skipped samples
+			// can no longer be rebuilt from the segment end points or the segment reaches MAX_SEGMENT_SAMPLES
+			size_t anchor = 0;
+			add_key(anchor);
+			for (size_t candidate = 2; candidate < frame_count; ++candidate)
+			{
+				float span = sample_times[candidate] - sample_times[anchor];
+				bool fits = true;
+				for (size_t f = anchor + 1; f < candidate && fits; ++f)
+				{
+					float t = (sample_times[f] - sample_times[anchor]) / span;
+					typename Channel::value rebuilt = Channel::Interpolate(value_at(anchor), value_at(candidate), t);
+					fits = Channel::Error(rebuilt, value_at(f)) <= tolerance;
+				}
+				if (!fits || candidate - anchor > MAX_SEGMENT_SAMPLES)
+				{
+					anchor = candidate - 1;
+					add_key(anchor);
+				}
+			}
+			add_key(frame_count - 1);
+		}
+	}
+
+	void Reduce_Tracks(const std::vector<trs>& samples, const std::vector<float>& sample_times, size_t joint_count,
+		const reduction_tolerance& tolerance, std::vector<joint_track>& out_tracks)
+	{
+		out_tracks.clear();
+		out_tracks.resize(joint_count);
+
+		for (size_t joint = 0; joint < joint_count; ++joint)
+		{
+			joint_track& track = out_tracks[joint];
+			Reduce_Channel<position_channel>(samples, sample_times, joint_count, joint, tolerance.position, track.translation);
+			Reduce_Channel<rotation_channel>(samples, sample_times, joint_count, joint, tolerance.rotation, track.rotation);
+			Reduce_Channel<scale_channel>(samples, sample_times, joint_count, joint, tolerance.scale, track.scale);
+		}
+	}
+
+	void Reduce_Joint_Track(const std::vector<trs>& samples, const std::vector<float>& sample_times,
+		const reduction_tolerance& tolerance, joint_track& out_track)
+	{
+		Reduce_Channel<position_channel>(samples, sample_times, 1, 0, tolerance.position, out_track.translation);
+		Reduce_Channel<rotation_channel>(samples, sample_times, 1, 0, tolerance.rotation, out_track.rotation);
+		Reduce_Channel<scale_channel>(samples, sample_times, 1, 0, tolerance.scale, out_track.scale);
+	}
+
+	namespace
+	{
+		// the three smallest components of a unit quaternion are all within +-1/sqrt(2)
+		const float SMALLEST_THREE_RANGE = 0.70710678f;
+		const float SMALLEST_THREE_STEPS = 32767.0f;
+	}
+
+	packed_quat Pack_Quaternion(const DirectX::XMFLOAT4& q)
+	{
+		float components[4] = { q.x, q.y, q.z, q.w };
+
+		uint16_t largest = 0;
+		for (uint16_t i = 1; i < 4; ++i)
+		{
+			if (std::fabs(components[i]) > std::fabs(components[largest]))
+				largest = i;
+		}
+		// q and -q are the same rotation, keep the dropped component positive so it can be rebuilt
+		float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+		packed_quat packed;
+		for (uint16_t i = 0, slot = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+			float normalized = std::clamp(sign * components[i] / SMALLEST_THREE_RANGE, -1.0f, 1.0f) * 0.5f + 0.5f;
+			packed.data[slot++] = static_cast<uint16_t>(normalized * SMALLEST_THREE_STEPS + 0.5f);
+		}
+		packed.data[0] |= (largest & 1) << 15;
+		packed.data[1] |= (largest >> 1) << 15;
+		return packed;
+	}
+
+	DirectX::XMFLOAT4 Unpack_Quaternion(const packed_quat& packed)
+	{
+		uint16_t largest = (packed.data[0] >> 15) | ((packed.data[1] >> 15) << 1);
+
+		float components[4];
+		float sum = 0.0f;
+		for (uint16_t i = 0, slot = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+			float normalized = (packed.data[slot++] & 0x7FFF) / SMALLEST_THREE_STEPS;
+			components[i] = (normalized * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+			sum += components[i] * components[i];
+		}
+		components[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+		return { components[0], components[1], components[2], components[3] };
+	}
+
+	void Make_Rotations_Continuous(std::vector<trs>& samples, size_t joint_count)
+	{
+		for (size_t i = joint_count; i < samples.size(); ++i)
+		{
+			const DirectX::XMFLOAT4& prev = samples[i - joint_count].rotation;
+			DirectX::XMFLOAT4& curr = samples[i].rotation;
+			if (prev.x * curr.x + prev.y * curr.y + prev.z * curr.z + prev.w * curr.w < 0.0f)
+				curr = { -curr.x, -curr.y, -curr.z, -curr.w };
+		}
+	}
+
+	size_t Count_Track_Keys(const track_clip& clip)
+	{
+		size_t count = 0;
+		for (auto& track : clip.tracks)
+			count += track.translation.times.size() + track.rotation.times.size() + track.scale.times.size();
+		return count;
+	}
+
+	namespace
+	{
+		void Write_Key_Header(std::ofstream& file, const std::vector<float>& times, float sample_rate, uint8_t format)
+		{
+			assert(times.size() <= MAX_TRACK_KEYS);
+
+			// fixed rate keys are whole frames and fit in 16 bits, keys read from curves may fall between frames
+			std::vector<uint16_t> frames(times.size());
+			uint8_t time_format = KEY_TIME_FRAMES16;
+			for (size_t k = 0; k < times.size(); ++k)
+			{
+				float frame = std::round(times[k] * sample_rate);
+				if (std::fabs(times[k] * sample_rate - frame) > 0.001f || frame > UINT16_MAX)
+				{
+					time_format = KEY_TIME_SECONDS;
+					break;
+				}
+				frames[k] = static_cast<uint16_t>(frame);
+			}
+
+			uint16_t key_count = static_cast<uint16_t>(times.size());
+			file.write((char const*)&key_count, sizeof(uint16_t));
+			file.write((char const*)&format, sizeof(uint8_t));
+			file.write((char const*)&time_format, sizeof(uint8_t));
+			if (time_format == KEY_TIME_FRAMES16)
+				file.write((char const*)frames.data(), sizeof(uint16_t) * key_count);
+			else
+				file.write((char const*)times.data(), sizeof(float) * key_count);
+		}
+
+		void Write_Vec3_Channel(std::ofstream& file, const key_channel<DirectX::XMFLOAT3>& channel, float sample_rate, float tolerance)
+		{
+			size_t key_count = channel.values.size();
+
+			DirectX::XMFLOAT3 low = key_count ? channel.values[0] : DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+			DirectX::XMFLOAT3 high = low;
+			for (auto& v : channel.values)
+			{
+				low = { std::min(low.x, v.x), std::min(low.y, v.y), std::min(low.z, v.z) };
+				high = { std::max(high.x, v.x), std::max(high.y, v.y), std::max(high.z, v.z) };
+			}
+			DirectX::XMFLOAT3 extent = { high.x - low.x, high.y - low.y, high.z - low.z };
+
+			// quantize to 16 bits only while the rounding error stays well under the reduction tolerance,
+			// and never for one or two keys where the range header costs more than it saves
+			float largest = std::max(extent.x, std::max(extent.y, extent.z));
+			float worst_rounding = largest / UINT16_MAX * 0.5f * 1.7320508f;
+			uint8_t format = (key_count > 2 && worst_rounding <= tolerance * 0.25f) ? TRACK_QUANTIZED16 : TRACK_FLOAT3;
+
+			Write_Key_Header(file, channel.times, sample_rate, format);
+
+			if (format == TRACK_FLOAT3)
+			{
+				file.write((char const*)channel.values.data(), sizeof(DirectX::XMFLOAT3) * key_count);
+				return;
+			}
+
+			file.write((char const*)&low, sizeof(DirectX::XMFLOAT3));
+			file.write((char const*)&extent, sizeof(DirectX::XMFLOAT3));
+
+			auto quantize = [](float v, float low, float extent) -> uint16_t
+			{
+				return extent > 0.0f ? static_cast<uint16_t>((v - low) / extent * UINT16_MAX + 0.5f) : 0;
+			};
+			std::vector<uint16_t> packed(key_count * 3);
+			for (size_t k = 0; k < key_count; ++k)
+			{
+				packed[k * 3 + 0] = quantize(channel.values[k].x, low.x, extent.x);
+				packed[k * 3 + 1] = quantize(channel.values[k].y, low.y, extent.y);
+				packed[k * 3 + 2] = quantize(channel.values[k].z, low.z, extent.z);
+			}
+			file.write((char const*)packed.data(), sizeof(uint16_t) * packed.size());
+		}
+
+		void Write_Rotation_Channel(std::ofstream& file, const key_channel<DirectX::XMFLOAT4>& channel, float sample_rate)
+		{
+			Write_Key_Header(file, channel.times, sample_rate, TRACK_PACKED_QUAT);
+
+			std::vector<packed_quat> packed;
+			packed.reserve(channel.values.size());
+			for (auto& q : channel.values)
+				packed.push_back(Pack_Quaternion(q));
+			file.write((char const*)packed.data(), sizeof(packed_quat) * packed.size());
+		}
+
+		void Write_Clip_Tracks(std::ofstream& file, const track_clip& clip, uint32_t flags, const reduction_tolerance& tolerance)
+		{
+			for (auto& track : clip.tracks)
+			{
+				Write_Vec3_Channel(file, track.translation, clip.sample_rate, tolerance.position);
+				Write_Rotation_Channel(file, track.rotation, clip.sample_rate);
+				if (flags & TRACK_HAS_SCALE)
+					Write_Vec3_Channel(file, track.scale, clip.sample_rate, tolerance.scale);
+			}
+		}
+	}
+
+	int Write_Track_File(const std::vector<track_clip>& clips, const reduction_tolerance& tolerance, const char* output_file_path)
+	{
+		if (clips.empty())
+			return -1;
+
+		// a longer channel would leave its key count truncated and everything after it unreadable
+		for (auto& clip : clips)
+		{
+			if (clip.name.size() > UINT16_MAX)
+				return -1;
+			for (auto& track : clip.tracks)
+			{
+				if (track.translation.times.size() > MAX_TRACK_KEYS || track.rotation.times.size() > MAX_TRACK_KEYS
+					|| track.scale.times.size() > MAX_TRACK_KEYS)
+					return -1;
+			}
+		}
+
+		FBX_PROFILE_SCOPE(scope, "write_track_file");
+		FBX_PROFILE_ITEMS(scope, clips.size(), clips.size());
+		track_file_header header;
+		header.joint_count = static_cast<uint32_t>(clips[0].parent_indices.size());
+		header.clip_count = static_cast<uint32_t>(clips.size());
+		header.skeleton_hash = clips[0].skeleton_hash;
+
+		std::vector<clip_directory_entry> directory(clips.size());
+		for (size_t c = 0; c < clips.size(); ++c)
+		{
+			clip_directory_entry& entry = directory[c];
+			entry.name_hash = fnv1a(clips[c].name.c_str(), clips[c].name.size());
+			entry.duration = static_cast<float>(clips[c].duration);
+			entry.sample_rate = clips[c].sample_rate;
+
+			// scale is only written when some joint actually scales
+			for (auto& track : clips[c].tracks)
+			{
+				for (auto& s : track.scale.values)
+				{
+					if (std::fabs(s.x - 1.0f) > tolerance.scale || std::fabs(s.y - 1.0f) > tolerance.scale || std::fabs(s.z - 1.0f) > tolerance.scale)
+						entry.flags |= TRACK_HAS_SCALE;
+				}
+			}
+		}
+
+		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+		if (!file.is_open())
+			return -1;
+
+		file.write((char const*)&header, sizeof(track_file_header));
+		file.write((char const*)clips[0].parent_indices.data(), sizeof(int) * header.joint_count);
+
+		// the directory goes in first so readers can find a clip without reading the others,
+		// it is written again once the clip offsets are known
+		std::streampos directory_at = file.tellp();
+		file.write((char const*)directory.data(), sizeof(clip_directory_entry) * directory.size());
+		for (auto& clip : clips)
+		{
+			uint16_t length = static_cast<uint16_t>(clip.name.size());
+			file.write((char const*)&length, sizeof(uint16_t));
+			file.write(clip.name.c_str(), length);
+		}
+
+		for (size_t c = 0; c < clips.size(); ++c)
+		{
+			std::streampos clip_at = file.tellp();
+			Write_Clip_Tracks(file, clips[c], directory[c].flags, tolerance);
+			directory[c].offset = static_cast<uint64_t>(clip_at);
+			directory[c].size = static_cast<uint64_t>(file.tellp() - clip_at);
+		}
+
+		FBX_PROFILE_BYTES(scope, file.tellp());
+		file.seekp(directory_at);
+		file.write((char const*)directory.data(), sizeof(clip_directory_entry) * directory.size());
+
+		// close flushes, a full disk can still fail here
+		file.close();
+		return file.fail() ? -1 : 0;
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <DirectXMath.h>
+
+namespace end
+{
+	// local space transform of one joint at one point in time
+	struct trs
+	{
+		DirectX::XMFLOAT3 translation = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT4 rotation = { 0.0f, 0.0f, 0.0f, 1.0f };
+		DirectX::XMFLOAT3 scale = { 1.0f, 1.0f, 1.0f };
+	};
+
+	// keys of a single channel
+	// every channel owns its key times so each one can be keyed at its own rate
+	template<typename T>
+	struct key_channel
+	{
+		std::vector<float> times;
+		std::vector<T> values;
+	};
+
+	struct joint_track
+	{
+		key_channel<DirectX::XMFLOAT3> translation;
+		key_channel<DirectX::XMFLOAT4> rotation;
+		key_channel<DirectX::XMFLOAT3> scale;
+	};
+
+	struct track_clip
+	{
+		std::string name;
+		double duration = 0;
+		float sample_rate = 24.0f;
+		uint64_t skeleton_hash = 0;		// the .skel the clip was exported against, 0 when unknown
+		std::vector<int> parent_indices;
+		std::vector<joint_track> tracks;
+	};
+
+	// largest error a dropped key may have when rebuilt by interpolating its neighbours
+	struct reduction_tolerance
+	{
+		float position = 0.001f;	// scene units
+		float rotation = 0.0005f;	// radians
+		float scale = 0.0001f;
+	};
+
+	// .anim track file layout
+	//	track_file_header
+	//	int parent_indices[joint_count]		- the hierarchy, shared by every clip in the file
+	//										  names and bind pose live in the .skel named by 'skeleton_hash' 
+	//	clip_directory_entry[clip_count]
+	//	per clip, in directory order: uint16_t name_length, char name[name_length]
+	//	per clip, at its directory entry's offset
+	//		per joint: translation, rotation, then scale when TRACK_HAS_SCALE is set
+	//			uint16_t key_count, uint8_t format, uint8_t time_format
+	//			key times						- see e_key_time_format
+	//			values							- see e_track_format, rotations are always packed_quat
+	const uint32_t TRACK_FILE_MAGIC = 0x4B415254; // "TRAK"
+	const uint32_t TRACK_FILE_VERSION = 5;
+
+	enum e_track_flags : uint32_t { TRACK_HAS_SCALE = 1 };
+
+	// key counts are stored in 16 bits
+	const size_t MAX_TRACK_KEYS = UINT16_MAX;
+
+	enum e_track_format : uint8_t
+	{
+		TRACK_FLOAT3 = 0,		// float[3] per key
+		TRACK_QUANTIZED16,		// float3 min, float3 extent, then uint16_t[3] per key
+		TRACK_PACKED_QUAT,		// packed_quat per key
+	};
+
+	enum e_key_time_format : uint8_t
+	{
+		KEY_TIME_FRAMES16 = 0,	// uint16_t frame numbers at the clip's 'sample_rate'
+		KEY_TIME_SECONDS,		// float seconds, for keys read from curves that don't land on frames
+	};
+
+	struct track_file_header
+	{
+		uint32_t magic = TRACK_FILE_MAGIC;
+		uint32_t version = TRACK_FILE_VERSION;
+		uint32_t joint_count = 0;
+		uint32_t clip_count = 0;
+		uint64_t skeleton_hash = 0;
+	};
+
+	struct clip_directory_entry
+	{
+		uint64_t name_hash = 0;		// fnv1a of the clip's name
+		uint64_t offset = 0;		// from the start of the file
+		uint64_t size = 0;
+		float duration = 0.0f;
+		float sample_rate = 0.0f;
+		uint32_t flags = 0;
+		uint32_t unused = 0;
+	};
+
+	// unit quaternion stored with the smallest three method in 48 bits
+	// The largest component is dropped and rebuilt from the others, the remaining three get 15 bits each.
+	// The index of the dropped component lives in the top bits of data[0] and data[1]
+	struct packed_quat
+	{
+		uint16_t data[3];
+	};
+
+	packed_quat Pack_Quaternion(const DirectX::XMFLOAT4& q);
+
+	DirectX::XMFLOAT4 Unpack_Quaternion(const packed_quat& packed);
+
+	// samples - fixed rate local poses, frame major (sample_times.size() * joint_count entries)
+	// Rotations are expected to be on a continuous hemisphere from one frame to the next
+	void Reduce_Tracks(const std::vector<trs>& samples, const std::vector<float>& sample_times, size_t joint_count,
+		const reduction_tolerance& tolerance, std::vector<joint_track>& out_tracks);
+
+	// Reduces a single joint sampled at its own, possibly irregular, 'sample_times'
+	void Reduce_Joint_Track(const std::vector<trs>& samples, const std::vector<float>& sample_times,
+		const reduction_tolerance& tolerance, joint_track& out_track);
+
+	// Flips rotations so consecutive samples of a joint never take the long way around
+	void Make_Rotations_Continuous(std::vector<trs>& samples, size_t joint_count);
+
+	// Keys left in every channel of every track of 'clip'
+	size_t Count_Track_Keys(const track_clip& clip);
+
+	// Writes 'clips' to one track file, every clip has to share the first clip's skeleton
+	// Channels are quantized where the rounding stays well under 'tolerance'.
+	// Returns 0 on success, non-zero when the file can't be opened or written, or when a channel has more keys than
+	// a track can hold or a name is longer than 65535 characters, nothing is written then
+	int Write_Track_File(const std::vector<track_clip>& clips, const reduction_tolerance& tolerance, const char* output_file_path);
+}
@@ -0,0 +1,678 @@
+#include "pch.h"
+#include "collision.h"
+#include "profiler.h"
+
+#include <fstream>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <set>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <system_error>
+
+namespace end
+{
+	namespace
+	{
+		// hull math runs in doubles, float cross products of nearly coplanar faces flip sign too easily
+		struct vec3
+		{
+			double x, y, z;
+		};
+
+		vec3 To_Vec3(const DirectX::XMFLOAT3& p) { return { p.x, p.y, p.z }; }
+		vec3 Sub(const vec3& a, const vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+		vec3 Cross(const vec3& a, const vec3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+		double Dot(const vec3& a, const vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		double Length_Sq(const vec3& a) { return Dot(a, a); }
+
+		double Axis(const DirectX::XMFLOAT3& p, int axis) { return axis == 0 ? p.x : axis == 1 ? p.y : p.z; }
+
+		struct hull_face
+		{
+			uint32_t v[3];
+			vec3 normal;
+			double offset;
+			size_t neighbours[3] = {};			// the face across the edge from v[e] to v[e + 1]
+			std::vector<uint32_t> outside;		// points in front of this face and no face before it
+			uint32_t furthest = 0;
+			double furthest_distance = 0.0;
+			uint64_t visited = 0;				// the last step that looked at this face
+			bool alive = true;
+		};
+
+		hull_face Make_Face(const std::vector<vec3>& points, uint32_t a, uint32_t b, uint32_t c)
+		{
+			hull_face face;
+			face.v[0] = a;
+			face.v[1] = b;
+			face.v[2] = c;
+			vec3 normal = Cross(Sub(points[b], points[a]), Sub(points[c], points[a]));
+			double length = std::sqrt(Length_Sq(normal));
+			face.normal = length > 0.0 ? vec3{ normal.x / length, normal.y / length, normal.z / length } : vec3{ 0.0, 0.0, 0.0 };
+			face.offset = Dot(face.normal, points[a]);
+			return face;
+		}
+
+		double Distance(const hull_face& face, const vec3& p)
+		{
+			return Dot(face.normal, p) - face.offset;
+		}
+
+		// Hands 'point' to the first face it is in front of, points behind every face are inside for good
+		void Assign_Point(std::vector<hull_face>& faces, size_t first_face, const std::vector<vec3>& points, uint32_t point, double epsilon)
+		{
+			for (size_t f = first_face; f < faces.size(); ++f)
+			{
+				hull_face& face = faces[f];
+				if (!face.alive)
+					continue;
+				double distance = Distance(face, points[point]);
+				if (distance > epsilon)
+				{
+					face.outside.push_back(point);
+					if (distance > face.furthest_distance)
+					{
+						face.furthest_distance = distance;
+						face.furthest = point;
+					}
+					return;
+				}
+			}
+		}
+
+		void Bounds(const std::vector<DirectX::XMFLOAT3>& vertices, DirectX::XMFLOAT3& out_min, DirectX::XMFLOAT3& out_max)
+		{
+			out_min = out_max = vertices.empty() ? DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f } : vertices[0];
+			for (const DirectX::XMFLOAT3& p : vertices)
+			{
+				out_min = { std::min(out_min.x, p.x), std::min(out_min.y, p.y), std::min(out_min.z, p.z) };
+				out_max = { std::max(out_max.x, p.x), std::max(out_max.y, p.y), std::max(out_max.z, p.z) };
+			}
+		}
+
+		// every edge has its twin running the other way
+		bool Is_Closed(const collision_mesh& mesh)
+		{
+			std::set<uint64_t> edges;
+			for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+				for (size_t e = 0; e < 3; ++e)
+					edges.insert(uint64_t(mesh.indices[i + e]) << 32 | mesh.indices[i + (e + 1) % 3]);
+			for (uint64_t edge : edges)
+				if (edges.count(edge << 32 | edge >> 32) == 0)
+					return false;
+			return !edges.empty();
+		}
+	}
+
+	int Build_Convex_Hull(const DirectX::XMFLOAT3* points, size_t count, uint32_t max_vertices, convex_hull& out_hull)
+	{
+		FBX_PROFILE_SCOPE(scope, "build_convex_hull");
+		out_hull = convex_hull();
+		if (count < 4 || max_vertices < 4)
+			return -1;
+
+		std::vector<vec3> p(count);
+		for (size_t i = 0; i < count; ++i)
+			p[i] = To_Vec3(points[i]);
+
+		// extreme points along each axis, the furthest apart pair starts the simplex
+		uint32_t extremes[6] = {};
+		for (uint32_t i = 1; i < count; ++i)
+		{
+			if (p[i].x < p[extremes[0]].x) extremes[0] = i;
+			if (p[i].x > p[extremes[1]].x) extremes[1] = i;
+			if (p[i].y < p[extremes[2]].y) extremes[2] = i;
+			if (p[i].y > p[extremes[3]].y) extremes[3] = i;
+			if (p[i].z < p[extremes[4]].z) extremes[4] = i;
+			if (p[i].z > p[extremes[5]].z) extremes[5] = i;
+		}
+		double span = std::max({ p[extremes[1]].x - p[extremes[0]].x, p[extremes[3]].y - p[extremes[2]].y, p[extremes[5]].z - p[extremes[4]].z });
+		if (span <= 0.0)
+			return -1;
+		const double epsilon = span * 1e-6;
+
+		uint32_t s0 = 0, s1 = 0;
+		double best = -1.0;
+		for (int a = 0; a < 6; ++a)
+			for (int b = a + 1; b < 6; ++b)
+			{
+				double distance = Length_Sq(Sub(p[extremes[a]], p[extremes[b]]));
+				if (distance > best)
+				{
+					best = distance;
+					s0 = extremes[a];
+					s1 = extremes[b];
+				}
+			}
+
+		uint32_t s2 = 0;
+		best = 0.0;
+		vec3 line = Sub(p[s1], p[s0]);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			double distance = Length_Sq(Cross(line, Sub(p[i], p[s0])));
+			if (distance > best)
+			{
+				best = distance;
+				s2 = i;
+			}
+		}
+		if (std::sqrt(best) <= epsilon * std::sqrt(Length_Sq(line)))
+			return -1;
+
+		hull_face base = Make_Face(p, s0, s1, s2);
+		uint32_t s3 = 0;
+		best = 0.0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			double distance = std::abs(Distance(base, p[i]));
+			if (distance > best)
+			{
+				best = distance;
+				s3 = i;
+			}
+		}
+		if (best <= epsilon)
+			return -1;
+
+		// the simplex's faces wound so its centroid is behind each of them
+		vec3 centroid = { (p[s0].x + p[s1].x + p[s2].x + p[s3].x) * 0.25, (p[s0].y + p[s1].y + p[s2].y + p[s3].y) * 0.25,
+			(p[s0].z + p[s1].z + p[s2].z + p[s3].z) * 0.25 };
+		std::vector<hull_face> faces;
+		const uint32_t simplex[4][3] = { { s0, s1, s2 }, { s0, s3, s1 }, { s1, s3, s2 }, { s2, s3, s0 } };
+		for (const uint32_t* f : simplex)
+		{
+			hull_face face = Make_Face(p, f[0], f[1], f[2]);
+			if (Distance(face, centroid) > 0.0)
+				face = Make_Face(p, f[0], f[2], f[1]);
+			faces.push_back(std::move(face));
+		}
+		std::unordered_map<uint64_t, size_t> edge_faces;
+		for (size_t f = 0; f < faces.size(); ++f)
+			for (int e = 0; e < 3; ++e)
+				edge_faces[uint64_t(faces[f].v[e]) << 32 | faces[f].v[(e + 1) % 3]] = f;
+		for (hull_face& face : faces)
+			for (int e = 0; e < 3; ++e)
+				face.neighbours[e] = edge_faces[uint64_t(face.v[(e + 1) % 3]) << 32 | face.v[e]];
+
+		for (uint32_t i = 0; i < count; ++i)
+			if (i != s0 && i != s1 && i != s2 && i != s3)
+				Assign_Point(faces, 0, p, i, epsilon);
+
+		struct horizon_edge
+		{
+			uint32_t a, b;
+			size_t beyond;		// the face that stays on the other side
+			int beyond_edge;
+		};
+
+		uint32_t hull_vertex_count = 4;
+		uint64_t step = 0;
+		std::vector<size_t> visible;
+		std::vector<std::pair<size_t, int>> walk;
+		std::vector<horizon_edge> horizon;
+		std::unordered_map<uint32_t, size_t> new_face_from, new_face_to;
+		std::vector<uint32_t> orphans;
+		while (hull_vertex_count < max_vertices)
+		{
+			// the furthest point of all goes in next so a capped hull keeps the points that matter most
+			size_t next_face = faces.size();
+			for (size_t f = 0; f < faces.size(); ++f)
+				if (faces[f].alive && !faces[f].outside.empty()
+					&& (next_face == faces.size() || faces[f].furthest_distance > faces[next_face].furthest_distance))
+					next_face = f;
+			if (next_face == faces.size())
+				break;
+
+			// the faces the eye sees are walked out from its own face across their edges, so they stay one connected
+			// patch even where nearly flat faces elsewhere are within rounding of seeing it. Edges the walk stops at
+			// make the horizon
+			uint32_t eye = faces[next_face].furthest;
+			++step;
+			visible.clear();
+			horizon.clear();
+			walk.clear();
+			faces[next_face].visited = step;
+			visible.push_back(next_face);
+			walk.push_back({ next_face, 0 });
+			while (!walk.empty())
+			{
+				size_t f = walk.back().first;
+				int e = walk.back().second;
+				if (e == 3)
+				{
+					walk.pop_back();
+					continue;
+				}
+				++walk.back().second;
+
+				size_t beyond = faces[f].neighbours[e];
+				if (faces[beyond].visited == step)
+					continue;
+				if (Distance(faces[beyond], p[eye]) > epsilon)
+				{
+					faces[beyond].visited = step;
+					visible.push_back(beyond);
+					walk.push_back({ beyond, 0 });
+					continue;
+				}
+				uint32_t a = faces[f].v[e], b = faces[f].v[(e + 1) % 3];
+				int beyond_edge = 0;
+				while (beyond_edge < 2 && !(faces[beyond].v[beyond_edge] == b && faces[beyond].v[(beyond_edge + 1) % 3] == a))
+					++beyond_edge;
+				horizon.push_back({ a, b, beyond, beyond_edge });
+			}
+
+			orphans.clear();
+			for (size_t f : visible)
+			{
+				faces[f].alive = false;
+				for (uint32_t point : faces[f].outside)
+					if (point != eye)
+						orphans.push_back(point);
+				faces[f].outside = std::vector<uint32_t>();
+			}
+
+			// a face from every horizon edge up to the eye, stitched to the face beyond the edge and to each other
+			size_t first_new = faces.size();
+			new_face_from.clear();
+			new_face_to.clear();
+			for (const horizon_edge& edge : horizon)
+			{
+				size_t f = faces.size();
+				faces.push_back(Make_Face(p, edge.a, edge.b, eye));
+				faces[f].neighbours[0] = edge.beyond;
+				faces[edge.beyond].neighbours[edge.beyond_edge] = f;
+				new_face_from[edge.a] = f;
+				new_face_to[edge.b] = f;
+			}
+			for (size_t f = first_new; f < faces.size(); ++f)
+			{
+				faces[f].neighbours[1] = new_face_from[faces[f].v[1]];
+				faces[f].neighbours[2] = new_face_to[faces[f].v[0]];
+			}
+
+			for (uint32_t point : orphans)
+				Assign_Point(faces, first_new, p, point, epsilon);
+			++hull_vertex_count;
+		}
+
+		std::unordered_map<uint32_t, uint32_t> remap;
+		for (const hull_face& face : faces)
+		{
+			if (!face.alive)
+				continue;
+			for (uint32_t v : face.v)
+			{
+				auto inserted = remap.emplace(v, static_cast<uint32_t>(out_hull.vertices.size()));
+				if (inserted.second)
+					out_hull.vertices.push_back(points[v]);
+				out_hull.indices.push_back(inserted.first->second);
+			}
+		}
+		FBX_PROFILE_ITEMS(scope, count, out_hull.vertices.size());
+		return 0;
+	}
+
+	double Hull_Volume(const convex_hull& hull)
+	{
+		double volume = 0.0;
+		for (size_t i = 0; i + 2 < hull.indices.size(); i += 3)
+		{
+			vec3 a = To_Vec3(hull.vertices[hull.indices[i]]);
+			vec3 b = To_Vec3(hull.vertices[hull.indices[i + 1]]);
+			vec3 c = To_Vec3(hull.vertices[hull.indices[i + 2]]);
+			volume += Dot(a, Cross(b, c));
+		}
+		return volume / 6.0;
+	}
+
+	double Mesh_Volume(const collision_mesh& mesh)
+	{
+		double volume = 0.0;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			vec3 a = To_Vec3(mesh.vertices[mesh.indices[i]]);
+			vec3 b = To_Vec3(mesh.vertices[mesh.indices[i + 1]]);
+			vec3 c = To_Vec3(mesh.vertices[mesh.indices[i + 2]]);
+			volume += Dot(a, Cross(b, c));
+		}
+		// meshes wound the other way come out negative
+		return std::abs(volume / 6.0);
+	}
+
+	void Decompose_Convex(const collision_mesh& mesh, const collision_settings& settings, std::vector<convex_hull>& out_hulls)
+	{
+		FBX_PROFILE_SCOPE(scope, "decompose_convex");
+		out_hulls.clear();
+
+		struct part
+		{
+			std::vector<uint32_t> triangles;
+			convex_hull hull;
+			double volume = 0.0;
+			bool splittable = true;
+		};
+
+		std::vector<DirectX::XMFLOAT3> part_points;
+		std::vector<uint32_t> seen(mesh.vertices.size(), UINT32_MAX);
+		uint32_t part_id = 0;
+		auto build_hull = [&](part& out_part)
+		{
+			// only the vertices the part's triangles use
+			part_points.clear();
+			for (uint32_t t : out_part.triangles)
+				for (int c = 0; c < 3; ++c)
+				{
+					uint32_t v = mesh.indices[t * 3 + c];
+					if (seen[v] != part_id)
+					{
+						seen[v] = part_id;
+						part_points.push_back(mesh.vertices[v]);
+					}
+				}
+			++part_id;
+			if (Build_Convex_Hull(part_points.data(), part_points.size(), settings.max_hull_vertices, out_part.hull) == 0)
+				out_part.volume = Hull_Volume(out_part.hull);
+			else
+				out_part.splittable = false;
+		};
+
+		std::vector<part> parts(1);
+		parts[0].triangles.resize(mesh.indices.size() / 3);
+		for (uint32_t t = 0; t < parts[0].triangles.size(); ++t)
+			parts[0].triangles[t] = t;
+		build_hull(parts[0]);
+
+		// an open mesh encloses nothing to compare the hulls with, one hull is all it gets
+		double hull_volume = parts[0].volume;
+		double target = settings.max_hulls > 1 && Is_Closed(mesh) ? Mesh_Volume(mesh) * (1.0 + settings.concavity) : hull_volume;
+
+		while (parts.size() < settings.max_hulls && hull_volume > target)
+		{
+			size_t biggest = parts.size();
+			for (size_t i = 0; i < parts.size(); ++i)
+				if (parts[i].splittable && (biggest == parts.size() || parts[i].volume > parts[biggest].volume))
+					biggest = i;
+			if (biggest == parts.size())
+				break;
+
+			// split at the mean triangle centroid along the part's longest side
+			part& whole = parts[biggest];
+			DirectX::XMFLOAT3 low, high;
+			Bounds(whole.hull.vertices, low, high);
+			int axis = 0;
+			if (high.y - low.y > high.x - low.x) axis = 1;
+			if (high.z - low.z > std::max(high.x - low.x, high.y - low.y)) axis = 2;
+
+			auto centroid = [&](uint32_t t)
+			{
+				return Axis(mesh.vertices[mesh.indices[t * 3]], axis) + Axis(mesh.vertices[mesh.indices[t * 3 + 1]], axis)
+					+ Axis(mesh.vertices[mesh.indices[t * 3 + 2]], axis);
+			};
+			double split = 0.0;
+			for (uint32_t t : whole.triangles)
+				split += centroid(t);
+			split /= static_cast<double>(whole.triangles.size());
+
+			part below, above;
+			for (uint32_t t : whole.triangles)
+				(centroid(t) < split ? below : above).triangles.push_back(t);
+			if (below.triangles.empty() || above.triangles.empty())
+			{
+				whole.splittable = false;
+				continue;
+			}
+			build_hull(below);
+			build_hull(above);
+
+			hull_volume += below.volume + above.volume - whole.volume;
+			whole = std::move(below);
+			parts.push_back(std::move(above));
+		}
+
+		// flat leftovers have no hull, the simplified mesh still covers them
+		for (part& piece : parts)
+			if (!piece.hull.indices.empty())
+				out_hulls.push_back(std::move(piece.hull));
+		FBX_PROFILE_ITEMS(scope, mesh.indices.size() / 3, out_hulls.size());
+	}
+
+	void Simplify_Collision_Mesh(const collision_mesh& mesh, uint32_t cells, collision_mesh& out_mesh)
+	{
+		FBX_PROFILE_SCOPE(scope, "simplify_collision_mesh");
+		DirectX::XMFLOAT3 low, high;
+		Bounds(mesh.vertices, low, high);
+		float longest = std::max({ high.x - low.x, high.y - low.y, high.z - low.z });
+		if (cells == 0 || longest <= 0.0f)
+		{
+			out_mesh = mesh;
+			return;
+		}
+		// cell coordinates are packed 21 bits each into the cell key, more cells would alias distinct ones
+		cells = std::min(cells, MAX_SIMPLIFY_CELLS);
+		float inverse_cell = static_cast<float>(cells) / longest;
+
+		struct cluster
+		{
+			double x = 0.0, y = 0.0, z = 0.0;
+			uint32_t count = 0;
+		};
+		std::vector<cluster> clusters;
+		std::unordered_map<uint64_t, uint32_t> cell_clusters;
+		std::vector<uint32_t> remap(mesh.vertices.size());
+		for (size_t v = 0; v < mesh.vertices.size(); ++v)
+		{
+			const DirectX::XMFLOAT3& p = mesh.vertices[v];
+			uint64_t x = std::min<uint64_t>(static_cast<uint64_t>((p.x - low.x) * inverse_cell), cells);
+			uint64_t y = std::min<uint64_t>(static_cast<uint64_t>((p.y - low.y) * inverse_cell), cells);
+			uint64_t z = std::min<uint64_t>(static_cast<uint64_t>((p.z - low.z) * inverse_cell), cells);
+			auto inserted = cell_clusters.emplace(x | y << 21 | z << 42, static_cast<uint32_t>(clusters.size()));
+			if (inserted.second)
+				clusters.emplace_back();
+			cluster& c = clusters[inserted.first->second];
+			c.x += p.x;
+			c.y += p.y;
+			c.z += p.z;
+			++c.count;
+			remap[v] = inserted.first->second;
+		}
+
+		out_mesh.vertices.resize(clusters.size());
+		for (size_t c = 0; c < clusters.size(); ++c)
+			out_mesh.vertices[c] = { static_cast<float>(clusters[c].x / clusters[c].count),
+				static_cast<float>(clusters[c].y / clusters[c].count), static_cast<float>(clusters[c].z / clusters[c].count) };
+
+		// rotated so the smallest index leads, the same triangle keeps its winding and compares equal
+		std::set<std::array<uint32_t, 3>> kept;
+		out_mesh.indices.clear();
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			std::array<uint32_t, 3> t = { remap[mesh.indices[i]], remap[mesh.indices[i + 1]], remap[mesh.indices[i + 2]] };
+			if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2])
+				continue;
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+			if (kept.insert(t).second)
+				out_mesh.indices.insert(out_mesh.indices.end(), t.begin(), t.end());
+		}
+
+		// clusters only collapsed triangles used are dropped, copied out since the first use of a cluster
+		// can come after a higher numbered one and moving it in place would overwrite one not moved yet
+		std::vector<uint32_t> used(out_mesh.vertices.size(), UINT32_MAX);
+		std::vector<DirectX::XMFLOAT3> used_vertices;
+		used_vertices.reserve(out_mesh.vertices.size());
+		for (uint32_t& index : out_mesh.indices)
+		{
+			if (used[index] == UINT32_MAX)
+			{
+				used[index] = static_cast<uint32_t>(used_vertices.size());
+				used_vertices.push_back(out_mesh.vertices[index]);
+			}
+			index = used[index];
+		}
+		out_mesh.vertices.swap(used_vertices);
+		FBX_PROFILE_ITEMS(scope, mesh.indices.size() / 3, out_mesh.indices.size() / 3);
+	}
+
+	void Build_Collision(const collision_mesh& mesh, const collision_settings& settings, collision_submesh& out_submesh)
+	{
+		FBX_PROFILE_SCOPE(scope, "build_collision");
+		Decompose_Convex(mesh, settings, out_submesh.hulls);
+		Simplify_Collision_Mesh(mesh, settings.simplify_cells, out_submesh.mesh);
+	}
+
+	int Build_Collisions(const std::vector<collision_mesh>& meshes, const collision_settings& settings,
+		std::vector<collision_submesh>& out_submeshes, export_control* control)
+	{
+		out_submeshes.resize(meshes.size());
+
+		// submeshes share nothing, each thread takes the next one left
+		std::atomic<size_t> next{ 0 };
+		std::atomic<bool> failed{ false };
+		auto work = [&]()
+		{
+			for (size_t i = next++; i < meshes.size(); i = next++)
+			{
+				if (failed || (control && control->cancelled.load(std::memory_order_relaxed)))
+					return;
+				// nothing would catch it on a helper thread, a bad_alloc there would end the whole process
+				try
+				{
+					Build_Collision(meshes[i], settings, out_submeshes[i]);
+				}
+				catch (...)
+				{
+					failed = true;
+					return;
+				}
+			}
+		};
+
+		// helpers report to the caller's control, their checkpoints see a cancel as soon as it does
+		size_t thread_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), meshes.size());
+		std::vector<std::thread> helpers;
+		try
+		{
+			for (size_t t = 1; t < thread_count; ++t)
+			{
+				helpers.emplace_back([&]
+				{
+					Set_Export_Control(control);
+					work();
+					Set_Export_Control(nullptr);
+				});
+			}
+		}
+		catch (const std::system_error&)
+		{
+			// out of threads, the ones started and this one share the work
+		}
+		work();
+		for (std::thread& helper : helpers)
+			helper.join();
+
+		if (failed || (control && control->cancelled.load(std::memory_order_relaxed)))
+			return -1;
+		return 0;
+	}
+
+	namespace
+	{
+		void Write_Triangles(std::ofstream& file, const std::vector<DirectX::XMFLOAT3>& vertices, const std::vector<uint32_t>& indices)
+		{
+			uint32_t vertex_count = static_cast<uint32_t>(vertices.size());
+			uint32_t index_count = static_cast<uint32_t>(indices.size());
+			file.write((char const*)&vertex_count, sizeof(uint32_t));
+			file.write((char const*)vertices.data(), sizeof(DirectX::XMFLOAT3) * vertex_count);
+			file.write((char const*)&index_count, sizeof(uint32_t));
+			file.write((char const*)indices.data(), sizeof(uint32_t) * index_count);
+		}
+
+		void Read_Triangles(std::ifstream& file, std::vector<DirectX::XMFLOAT3>& vertices, std::vector<uint32_t>& indices)
+		{
+			uint32_t vertex_count = 0;
+			uint32_t index_count = 0;
+			file.read((char*)&vertex_count, sizeof(uint32_t));
+			if (!file.good())
+				return;
+			vertices.resize(vertex_count);
+			file.read((char*)vertices.data(), sizeof(DirectX::XMFLOAT3) * vertex_count);
+			file.read((char*)&index_count, sizeof(uint32_t));
+			if (!file.good())
+				return;
+			indices.resize(index_count);
+			file.read((char*)indices.data(), sizeof(uint32_t) * index_count);
+		}
+	}
+
+	void Write_Collision_File(const std::vector<collision_submesh>& submeshes, const char* output_file_path)
+	{
+		FBX_PROFILE_SCOPE(scope, "write_collision_file");
+		collision_file_header header;
+		header.submesh_count = static_cast<uint32_t>(submeshes.size());
+
+		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+
+		assert(file.is_open());
+
+		if (file.is_open())
+		{
+			file.write((char const*)&header, sizeof(collision_file_header));
+			for (const collision_submesh& submesh : submeshes)
+			{
+				uint16_t name_length = static_cast<uint16_t>(std::min<size_t>(submesh.name.size(), UINT16_MAX));
+				file.write((char const*)&name_length, sizeof(uint16_t));
+				file.write(submesh.name.data(), name_length);
+
+				uint32_t hull_count = static_cast<uint32_t>(submesh.hulls.size());
+				file.write((char const*)&hull_count, sizeof(uint32_t));
+				for (const convex_hull& hull : submesh.hulls)
+					Write_Triangles(file, hull.vertices, hull.indices);
+				Write_Triangles(file, submesh.mesh.vertices, submesh.mesh.indices);
+			}
+			FBX_PROFILE_BYTES(scope, file.tellp());
+		}
+
+		file.close();
+	}
+
+	int Load_Collision_File(const char* file_path, std::vector<collision_submesh>& out_submeshes)
+	{
+		std::ifstream file(file_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+			return -1;
+
+		collision_file_header header;
+		file.read((char*)&header, sizeof(collision_file_header));
+		if (!file.good() || header.magic != COLLISION_FILE_MAGIC || header.version != COLLISION_FILE_VERSION)
+			return -1;
+
+		out_submeshes.clear();
+		out_submeshes.resize(header.submesh_count);
+		for (collision_submesh& submesh : out_submeshes)
+		{
+			uint16_t name_length = 0;
+			file.read((char*)&name_length, sizeof(uint16_t));
+			if (!file.good())
+				return -1;
+			submesh.name.resize(name_length);
+			file.read(&submesh.name[0], name_length);
+
+			uint32_t hull_count = 0;
+			file.read((char*)&hull_count, sizeof(uint32_t));
+			if (!file.good())
+				return -1;
+			submesh.hulls.resize(hull_count);
+			for (convex_hull& hull : submesh.hulls)
+				Read_Triangles(file, hull.vertices, hull.indices);
+			Read_Triangles(file, submesh.mesh.vertices, submesh.mesh.indices);
+			if (!file.good())
+				return -1;
+		}
+		return 0;
+	}
+}
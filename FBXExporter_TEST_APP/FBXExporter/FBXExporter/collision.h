@@ -0,0 +1,91 @@
+#pragma once
+
+#include "export_progress.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <DirectXMath.h>
+
+// Collision geometry baked at export time so the physics runtime doesn't build it at load.
+// Every submesh gets convex hulls (one, or an approximate convex decomposition for concave ones)
+// and a simplified triangle mesh, all in the mesh's own space. No Fbx sdk dependency
+namespace end
+{
+	// triangles wound counter clockwise seen from outside
+	struct convex_hull
+	{
+		std::vector<DirectX::XMFLOAT3> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	struct collision_mesh
+	{
+		std::vector<DirectX::XMFLOAT3> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	struct collision_submesh
+	{
+		std::string name;
+		std::vector<convex_hull> hulls;
+		collision_mesh mesh;					// simplified
+	};
+
+	struct collision_settings
+	{
+		uint32_t max_hull_vertices = 64;		// the hull stops growing there, the furthest points go in first
+		uint32_t max_hulls = 1;					// above 1 concave meshes are split into up to this many hulls
+		float concavity = 0.1f;					// stop splitting once the hulls' volume is within this much of the mesh's
+		uint32_t simplify_cells = 32;			// grid cells along the longest side the simplified mesh snaps to, 0 keeps it whole
+	};
+
+	// Quickhull. Returns 0 on success, non-zero when the points are too few or too flat to enclose a volume
+	int Build_Convex_Hull(const DirectX::XMFLOAT3* points, size_t count, uint32_t max_vertices, convex_hull& out_hull);
+
+	double Hull_Volume(const convex_hull& hull);
+
+	// Volume enclosed by a closed mesh, about 0 for open ones
+	double Mesh_Volume(const collision_mesh& mesh);
+
+	// Splits the triangles in two along the longest side of the part whose hull is biggest, until the hulls
+	// hug the mesh within 'concavity' or there are 'max_hulls' of them. Open meshes get a single hull
+	void Decompose_Convex(const collision_mesh& mesh, const collision_settings& settings, std::vector<convex_hull>& out_hulls);
+
+	// cells along the longest side are capped so a cell's coordinates fit the 21 bits each its key has
+	const uint32_t MAX_SIMPLIFY_CELLS = (1u << 21) - 1;
+
+	// Vertex clustering: vertices in the same grid cell merge at their average, collapsed and repeated triangles go.
+	// 'cells' above MAX_SIMPLIFY_CELLS is clamped
+	void Simplify_Collision_Mesh(const collision_mesh& mesh, uint32_t cells, collision_mesh& out_mesh);
+
+	// Hulls and simplified mesh of one submesh, 'out_submesh.name' is left alone
+	void Build_Collision(const collision_mesh& mesh, const collision_settings& settings, collision_submesh& out_submesh);
+
+	// Build_Collision for every mesh at once, one submesh per thread, the helpers run under 'control' too.
+	// Returns 0 on success, non-zero once 'control' got cancelled or a submesh failed, e.g. ran out of memory
+	int Build_Collisions(const std::vector<collision_mesh>& meshes, const collision_settings& settings,
+		std::vector<collision_submesh>& out_submeshes, export_control* control = nullptr);
+
+	// .coll file layout
+	//	collision_file_header
+	//	per submesh: uint16_t name_length, char name[name_length], uint32_t hull_count
+	//		per hull: uint32_t vertex_count, DirectX::XMFLOAT3 vertices[vertex_count], uint32_t index_count, uint32_t indices[index_count]
+	//		uint32_t vertex_count, DirectX::XMFLOAT3 vertices[vertex_count], uint32_t index_count, uint32_t indices[index_count]
+	const uint32_t COLLISION_FILE_MAGIC = 0x4C4C4F43; // "COLL"
+	const uint32_t COLLISION_FILE_VERSION = 1;
+
+	struct collision_file_header
+	{
+		uint32_t magic = COLLISION_FILE_MAGIC;
+		uint32_t version = COLLISION_FILE_VERSION;
+		uint32_t submesh_count = 0;
+		uint32_t unused = 0;
+	};
+
+	void Write_Collision_File(const std::vector<collision_submesh>& submeshes, const char* output_file_path);
+
+	// Returns 0 on success, non-zero to indicate failure
+	int Load_Collision_File(const char* file_path, std::vector<collision_submesh>& out_submeshes);
+}
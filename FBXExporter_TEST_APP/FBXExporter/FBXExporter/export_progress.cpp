@@ -0,0 +1,40 @@
+#include "pch.h"
+#include "export_progress.h"
+
+namespace end
+{
+	namespace
+	{
+		thread_local export_control* current_control = nullptr;
+	}
+
+	void Set_Export_Control(export_control* control)
+	{
+		current_control = control;
+	}
+
+	export_control* Get_Export_Control()
+	{
+		return current_control;
+	}
+
+	bool Export_Checkpoint(const char* stage, size_t done, size_t total)
+	{
+		export_control* control = current_control;
+		if (!control)
+			return false;
+
+		if (control->callback)
+		{
+			float fraction = total > 0 ? static_cast<float>(static_cast<double>(done) / total) : 1.0f;
+			control->callback(stage, fraction, control->user_data);
+		}
+		return control->cancelled.load(std::memory_order_relaxed);
+	}
+
+	bool Export_Cancelled()
+	{
+		export_control* control = current_control;
+		return control && control->cancelled.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Progress reporting and cooperative cancellation for the export running on the calling thread.
+// The async jobs install an export_control on the worker running them, blocking calls run without one
+// and every checkpoint is then a no-op.
+//
+//	for (size_t v = 0; v < vert_count; ++v)
+//	{
+//		if ((v & 4095) == 0 && end::Export_Checkpoint("compactify", v, vert_count))
+//			return;		// cancelled, the caller throws away whatever was done so far
+//		...
+//	}
+namespace end
+{
+	using export_progress_callback = void(*)(const char* stage, float fraction, void* user_data);
+
+	struct export_control
+	{
+		std::atomic<bool> cancelled{ false };
+		export_progress_callback callback = nullptr;	// called from the exporting thread
+		void* user_data = nullptr;
+	};
+
+	// Every export run on this thread reports to 'control' until it is set back to null
+	void Set_Export_Control(export_control* control);
+
+	// The calling thread's control, null outside an async job. Helper threads of an export share it to see cancellation
+	export_control* Get_Export_Control();
+
+	// Reports 'done' out of 'total' for the stage and returns true once the export has been cancelled.
+	// Costs a call and an atomic load, hot loops only call it every few thousand items
+	bool Export_Checkpoint(const char* stage, size_t done, size_t total);
+
+	bool Export_Cancelled();
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 
 namespace end
 {
@@ -10,13 +11,12 @@ namespace end
 	//	and not accessed directly.
 	namespace detail
 	{
-		uint64_t fnv1a_hash(const uint8_t* bytes, size_t count)
+		const uint64_t FNV_offset_basis = 0xcbf29ce484222325;
+
+		inline uint64_t fnv1a_hash(const uint8_t* bytes, size_t count, uint64_t hash = FNV_offset_basis)
 		{
-			const uint64_t FNV_offset_basis = 0xcbf29ce484222325;
 			const uint64_t FNV_prime = 0x100000001b3;
 
-			uint64_t hash = FNV_offset_basis;
-
 			for (size_t i = 0; i < count; ++i)
 				hash = (hash ^ bytes[i]) * FNV_prime;
 
@@ -39,4 +39,16 @@ namespace end
 	{
 		return detail::fnv1a_hash((const uint8_t*)arr, N - 1);
 	}
+
+	// Calculate the fnv1a hash for a run of bytes
+	inline uint64_t fnv1a(const void* data, size_t count)
+	{
+		return detail::fnv1a_hash((const uint8_t*)data, count);
+	}
+
+	// Continues 'hash' over another run of bytes, for hashing things that aren't contiguous
+	inline uint64_t fnv1a(const void* data, size_t count, uint64_t hash)
+	{
+		return detail::fnv1a_hash((const uint8_t*)data, count, hash);
+	}
 }
\ No newline at end of file
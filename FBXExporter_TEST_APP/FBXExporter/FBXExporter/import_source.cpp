@@ -0,0 +1,175 @@
+#include "pch.h"
+#include "import_source.h"
+#include "profiler.h"
+
+#include <fstream>
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace end
+{
+	void mapped_file::Close()
+	{
+#ifdef _WIN32
+		if (view)
+			UnmapViewOfFile(view);
+		if (mapping)
+			CloseHandle(mapping);
+#else
+		if (view)
+			munmap(view, static_cast<size_t>(size));
+#endif
+		view = nullptr;
+		mapping = nullptr;
+		buffer = std::vector<uint8_t>();
+		data = nullptr;
+		size = 0;
+	}
+
+	namespace
+	{
+		// 0 when the whole file is mapped, the view is only valid while 'out_file' holds it
+		int Map_View(const char* file_path, mapped_file& out_file)
+		{
+#ifdef _WIN32
+			HANDLE file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				return -1;
+			LARGE_INTEGER size = {};
+			HANDLE mapping = nullptr;
+			if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+				mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			// the mapping keeps the file open
+			CloseHandle(file);
+			if (!mapping)
+				return -1;
+			void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (!view)
+			{
+				CloseHandle(mapping);
+				return -1;
+			}
+
+			// one request for all of it instead of a page fault at a time while the sdk parses
+			WIN32_MEMORY_RANGE_ENTRY range = { view, static_cast<SIZE_T>(size.QuadPart) };
+			PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+
+			out_file.view = view;
+			out_file.mapping = mapping;
+			out_file.size = static_cast<uint64_t>(size.QuadPart);
+#else
+			int file = open(file_path, O_RDONLY);
+			if (file < 0)
+				return -1;
+			struct stat info = {};
+			void* view = MAP_FAILED;
+			if (fstat(file, &info) == 0 && info.st_size > 0)
+				view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			close(file);
+			if (view == MAP_FAILED)
+				return -1;
+
+			madvise(view, static_cast<size_t>(info.st_size), MADV_WILLNEED);
+
+			out_file.view = view;
+			out_file.size = static_cast<uint64_t>(info.st_size);
+#endif
+			out_file.data = static_cast<const uint8_t*>(view);
+			return 0;
+		}
+	}
+
+	int Map_File(const char* file_path, mapped_file& out_file, size_t read_block)
+	{
+		FBX_PROFILE_SCOPE(scope, "map_file");
+		out_file.Close();
+		if (Map_View(file_path, out_file) == 0)
+		{
+			FBX_PROFILE_ITEMS(scope, out_file.size, 1);
+			return 0;
+		}
+
+		// some shares can't be mapped, a few large reads still beat the sdk's small ones
+		std::ifstream file(file_path, std::ios::binary | std::ios::in | std::ios::ate);
+		if (!file.is_open())
+			return -1;
+		std::streamoff size = file.tellg();
+		if (size <= 0)
+			return -1;
+		file.seekg(0);
+		out_file.buffer.resize(static_cast<size_t>(size));
+		for (uint64_t offset = 0; offset < out_file.buffer.size() && file;)
+		{
+			size_t count = static_cast<size_t>(std::min<uint64_t>(read_block, out_file.buffer.size() - offset));
+			file.read((char*)out_file.buffer.data() + offset, static_cast<std::streamsize>(count));
+			offset += static_cast<uint64_t>(file.gcount());
+		}
+		if (!file.good())
+		{
+			out_file.Close();
+			return -1;
+		}
+		out_file.data = out_file.buffer.data();
+		out_file.size = out_file.buffer.size();
+		FBX_PROFILE_ITEMS(scope, out_file.size, 0);
+		return 0;
+	}
+
+	namespace
+	{
+		struct blob_registry
+		{
+			std::mutex lock;
+			std::unordered_map<std::string, import_blob> blobs;
+			uint64_t generation = 0;
+		};
+
+		blob_registry& Blobs()
+		{
+			static blob_registry registry;
+			return registry;
+		}
+	}
+
+	int Register_Import_Blob(const char* name, const void* data, uint64_t size)
+	{
+		if (!name || !data || size == 0)
+			return -1;
+
+		blob_registry& registry = Blobs();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		import_blob& blob = registry.blobs[name];
+		blob.data = static_cast<const uint8_t*>(data);
+		blob.size = size;
+		blob.generation = ++registry.generation;
+		return 0;
+	}
+
+	int Release_Import_Blob(const char* name)
+	{
+		if (!name)
+			return -1;
+
+		blob_registry& registry = Blobs();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		return registry.blobs.erase(name) ? 0 : -1;
+	}
+
+	bool Find_Import_Blob(const char* name, import_blob& out_blob)
+	{
+		blob_registry& registry = Blobs();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		auto found = registry.blobs.find(name);
+		if (found == registry.blobs.end())
+			return false;
+		out_blob = found->second;
+		return true;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// The bytes the importer reads an fbx from, handed to the sdk through an FbxStream instead of a path so it doesn't
+// do its own small buffered reads, which are slow on network storage. Either the file mapped into memory with the
+// whole of it prefetched up front, the file read in a few large reads when it can't be mapped, or a blob the caller
+// already has in memory, registered under a name. No Fbx sdk dependency
+namespace end
+{
+	// a file's bytes for as long as it's open, mapped or read whole
+	struct mapped_file
+	{
+		const uint8_t* data = nullptr;
+		uint64_t size = 0;
+
+		mapped_file() = default;
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+		~mapped_file() { Close(); }
+
+		void Close();
+
+		std::vector<uint8_t> buffer;		// when the file was read instead of mapped
+		void* view = nullptr;				// the mapping, null when read
+		void* mapping = nullptr;			// windows file mapping handle
+	};
+
+	// Maps the whole file read only and starts reading all of it in ahead of the importer,
+	// falls back to reading it in 'read_block' sized reads. Returns 0 on success, non-zero when it can't be read
+	int Map_File(const char* file_path, mapped_file& out_file, size_t read_block = size_t(16) << 20);
+
+	// an fbx in the caller's memory, not copied
+	struct import_blob
+	{
+		const uint8_t* data = nullptr;
+		uint64_t size = 0;
+		uint64_t generation = 0;			// different for every registration, even of the same name
+	};
+
+	// Every import of 'name' reads 'data' from then on, until it's released or registered again
+	// Returns 0 on success, non-zero to indicate failure
+	int Register_Import_Blob(const char* name, const void* data, uint64_t size);
+
+	// Returns 0 when 'name' was registered
+	int Release_Import_Blob(const char* name);
+
+	bool Find_Import_Blob(const char* name, import_blob& out_blob);
+}
@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "mesh_instances.h"
+#include "fnv1a.h"
+#include "profiler.h"
+
+#include <fstream>
+#include <cstdio>
+#include <cassert>
+
+namespace end
+{
+	uint64_t Mesh_Content_Hash(const simple_mesh& mesh, uint64_t skeleton_hash)
+	{
+		// the counts go in too so the boundary between indices and vertices can't shift
+		uint64_t hash = fnv1a("MESH");
+		hash = fnv1a(&mesh.index_count, sizeof(uint32_t), hash);
+		hash = fnv1a(mesh.indices, sizeof(uint32_t) * mesh.index_count, hash);
+		hash = fnv1a(&mesh.vert_count, sizeof(uint32_t), hash);
+		hash = fnv1a(mesh.verts, sizeof(simple_vert) * mesh.vert_count, hash);
+		return fnv1a(&skeleton_hash, sizeof(uint64_t), hash);
+	}
+
+	std::string Mesh_File_Name(uint64_t hash)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.mesh", static_cast<unsigned long long>(hash));
+		return name;
+	}
+
+	uint64_t Mesh_File_Size(const simple_mesh& mesh)
+	{
+		return sizeof(uint32_t) + sizeof(uint32_t) * uint64_t(mesh.index_count)
+			+ sizeof(uint32_t) + sizeof(simple_vert) * uint64_t(mesh.vert_count)
+			+ sizeof(uint64_t);
+	}
+
+	void Write_Instance_File(const instance_table& table, const char* output_file_path)
+	{
+		FBX_PROFILE_SCOPE(scope, "write_instance_file");
+		FBX_PROFILE_ITEMS(scope, table.instances.size(), table.meshes.size());
+		instance_file_header header;
+		header.mesh_count = static_cast<uint32_t>(table.meshes.size());
+		header.instance_count = static_cast<uint32_t>(table.instances.size());
+
+		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+
+		assert(file.is_open());
+
+		if (file.is_open())
+		{
+			file.write((char const*)&header, sizeof(instance_file_header));
+			file.write((char const*)table.meshes.data(), sizeof(uint64_t) * header.mesh_count);
+			file.write((char const*)table.instances.data(), sizeof(mesh_instance) * header.instance_count);
+			FBX_PROFILE_BYTES(scope, file.tellp());
+		}
+
+		file.close();
+	}
+
+	int Load_Instance_File(const char* file_path, instance_table& out_table)
+	{
+		std::ifstream file(file_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+			return -1;
+
+		instance_file_header header;
+		file.read((char*)&header, sizeof(instance_file_header));
+		if (!file.good() || header.magic != INSTANCE_FILE_MAGIC || header.version != INSTANCE_FILE_VERSION)
+			return -1;
+
+		out_table.meshes.resize(header.mesh_count);
+		out_table.instances.resize(header.instance_count);
+		file.read((char*)out_table.meshes.data(), sizeof(uint64_t) * header.mesh_count);
+		file.read((char*)out_table.instances.data(), sizeof(mesh_instance) * header.instance_count);
+		if (!file.good())
+			return -1;
+
+		for (auto& instance : out_table.instances)
+		{
+			if (instance.mesh >= header.mesh_count)
+				return -1;
+		}
+		return 0;
+	}
+}
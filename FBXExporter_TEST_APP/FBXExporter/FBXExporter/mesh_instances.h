@@ -0,0 +1,57 @@
+#pragma once
+
+#include "simple_mesh.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <DirectXMath.h>
+
+// Scenes placed out of the same few meshes (environment kits, props) export every distinct mesh once,
+// named after a hash of its welded buffers like the skeletons are, plus one table of where each node puts which mesh.
+// Nodes sharing an FbxMesh and nodes with copies of the same geometry end up on the same .mesh,
+// meshes from other files with the same content too. No Fbx sdk dependency, the runtime can read it directly
+namespace end
+{
+	struct mesh_instance
+	{
+		uint32_t mesh = 0;						// index into instance_table::meshes
+		DirectX::XMFLOAT4X4 world;				// the node's global transform with its geometric offset
+	};
+
+	struct instance_table
+	{
+		std::vector<uint64_t> meshes;			// content hash of every distinct mesh, see Mesh_Content_Hash
+		std::vector<mesh_instance> instances;
+	};
+
+	// .inst file layout
+	//	instance_file_header
+	//	uint64_t meshes[mesh_count]			each one is '<16 hex digits>.mesh' next to the table
+	//	mesh_instance instances[instance_count]
+	const uint32_t INSTANCE_FILE_MAGIC = 0x54534E49; // "INST"
+	const uint32_t INSTANCE_FILE_VERSION = 1;
+
+	struct instance_file_header
+	{
+		uint32_t magic = INSTANCE_FILE_MAGIC;
+		uint32_t version = INSTANCE_FILE_VERSION;
+		uint32_t mesh_count = 0;
+		uint32_t instance_count = 0;
+	};
+
+	// Hashes the welded vertices and indices, and the skeleton hash the .mesh ends with
+	uint64_t Mesh_Content_Hash(const simple_mesh& mesh, uint64_t skeleton_hash = 0);
+
+	// "<16 hex digits>.mesh", the name every instance table gives the mesh with 'hash'
+	std::string Mesh_File_Name(uint64_t hash);
+
+	// Bytes Write_Mesh_File writes for 'mesh'
+	uint64_t Mesh_File_Size(const simple_mesh& mesh);
+
+	void Write_Instance_File(const instance_table& table, const char* output_file_path);
+
+	// Returns 0 on success, non-zero to indicate failure
+	int Load_Instance_File(const char* file_path, instance_table& out_table);
+}
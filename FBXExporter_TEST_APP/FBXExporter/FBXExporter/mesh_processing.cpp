@@ -0,0 +1,331 @@
+#include "pch.h"
+#include "mesh_processing.h"
+#include "profiler.h"
+#include "export_progress.h"
+
+#include <fstream>
+#include <cassert>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+namespace end
+{
+	void Bind_Skin(const std::vector<skin_cluster>& clusters, size_t control_point_count, std::pmr::vector<influence_set>& out_influences)
+	{
+		FBX_PROFILE_SCOPE(scope, "bind_skin");
+		FBX_PROFILE_ITEMS(scope, clusters.size(), control_point_count);
+		out_influences.assign(control_point_count, influence_set());
+
+		for (auto& cluster : clusters)
+		{
+			// get the influences for the control points
+			size_t ctrl_pnt_count = cluster.control_points.size();
+			for (size_t c = 0; c < ctrl_pnt_count; ++c)
+			{
+				influence inf_to_add;
+				inf_to_add.joint = cluster.joint;
+				inf_to_add.weight = cluster.weights[c];
+				// potentially doing this wrong
+				influence_set& inf_set = out_influences[cluster.control_points[c]];
+				for (size_t inf = 0; inf < MAX_INFLUENCES; ++inf)
+				{
+					// if this one is stronger than any other kick out the weakest
+					if (inf_to_add.weight - inf_set[inf].weight > 0.0001f)
+					{
+						inf_set[inf] = inf_to_add;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	namespace
+	{
+		// open addressing slots of the weld table, a power of two at least twice the vertex count
+		size_t Weld_Table_Size(size_t vert_count)
+		{
+			size_t size = 16;
+			while (size < vert_count * 2)
+				size *= 2;
+			return size;
+		}
+
+		uint32_t Float_Bits(float f)
+		{
+			// +0 and -0 compare equal so they have to hash the same
+			f += 0.0f;
+			uint32_t bits;
+			memcpy(&bits, &f, sizeof(uint32_t));
+			return bits;
+		}
+
+		uint64_t Weld_Hash(const simple_vert& v)
+		{
+			const uint32_t bits[8] = {
+				Float_Bits(v.pos.x), Float_Bits(v.pos.y), Float_Bits(v.pos.z),
+				Float_Bits(v.norm.x), Float_Bits(v.norm.y), Float_Bits(v.norm.z),
+				Float_Bits(v.tex_coord.x), Float_Bits(v.tex_coord.y)
+			};
+			uint64_t hash = 0x9E3779B97F4A7C15ull;
+			for (uint32_t b : bits)
+				hash = (hash ^ b) * 0xFF51AFD7ED558CCDull;
+			return hash ^ (hash >> 29);
+		}
+
+		bool Weld_Equal(const simple_vert& a, const simple_vert& b)
+		{
+			return	a.pos.x == b.pos.x && a.pos.y == b.pos.y && a.pos.z == b.pos.z
+				&&	a.norm.x == b.norm.x && a.norm.y == b.norm.y && a.norm.z == b.norm.z
+				&&	a.tex_coord.x == b.tex_coord.x && a.tex_coord.y == b.tex_coord.y;
+		}
+	}
+
+	size_t Mesh_Arena_Size(size_t control_point_count, size_t corner_count)
+	{
+		size_t bytes = control_point_count * (sizeof(DirectX::XMFLOAT4) + sizeof(influence_set))
+			+ corner_count * (sizeof(int) + sizeof(DirectX::XMFLOAT3) + sizeof(DirectX::XMFLOAT2) + sizeof(simple_vert) + sizeof(uint32_t))
+			+ Weld_Table_Size(corner_count) * sizeof(uint32_t);
+		// alignment padding between the buffers
+		return bytes + 16 * 64;
+	}
+
+	void Set_Influences(simple_vert& vert, const influence_set& influences)
+	{
+		for (size_t i = 0; i < 4; ++i)
+		{
+			vert.joint_index[i] = influences[i].joint;
+			vert.weights[i] = influences[i].weight;
+		}
+		float sum = vert.weights[0] + vert.weights[1] + vert.weights[2] + vert.weights[3];
+		// a control point no skin cluster reaches follows its first joint, like a rigid mesh
+		if (sum <= 0.0f)
+		{
+			vert.weights[0] = 1.0f;
+			sum = 1.0f;
+		}
+		for (size_t i = 0; i < 4; ++i)
+		{
+			vert.weights[i] /= sum;
+		}
+	}
+
+	void Expand_Vertices(const raw_mesh& mesh, mesh_buffers& out_mesh)
+	{
+		FBX_PROFILE_SCOPE(scope, "expand_vertices");
+		size_t corner_count = mesh.polygon_vertices.size();
+		FBX_PROFILE_ITEMS(scope, corner_count, corner_count);
+		out_mesh.verts.resize(corner_count);
+
+		for (size_t corner = 0; corner < corner_count; ++corner)
+		{
+			// the current vertex we are writing to
+			simple_vert& out_vert = out_mesh.verts[corner];
+
+			int ctrlPointIndex = mesh.polygon_vertices[corner];
+			out_vert.pos = mesh.control_points[ctrlPointIndex];
+			out_vert.color = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+			Set_Influences(out_vert, mesh.influences[ctrlPointIndex]);
+
+			out_vert.norm = mesh.normals[corner];
+			out_vert.tex_coord = mesh.uvs[corner];
+		}
+	}
+
+	void Compactify(mesh_buffers& mesh)
+	{
+		FBX_PROFILE_SCOPE(scope, "compactify");
+		size_t vert_count = mesh.verts.size();
+		mesh.indices.resize(vert_count);
+
+		// slots hold a compacted index + 1, 0 is empty
+		// the table lives in the same arena as the mesh and goes away with it
+		std::pmr::vector<uint32_t> table(Weld_Table_Size(vert_count), 0, mesh.verts.get_allocator());
+		size_t mask = table.size() - 1;
+
+		// compacted vertices are only ever written at or before the one being read, so it can all happen in place
+		uint32_t compactedIndex = 0;
+		for (size_t v = 0; v < vert_count; ++v)
+		{
+			if ((v & 4095) == 0 && Export_Checkpoint("compactify", v, vert_count))
+			{
+				// half welded is no use to anyone
+				mesh.verts.clear();
+				mesh.indices.clear();
+				return;
+			}
+
+			const simple_vert& vert = mesh.verts[v];
+			size_t slot = Weld_Hash(vert) & mask;
+			while (table[slot] != 0 && !Weld_Equal(mesh.verts[table[slot] - 1], vert))
+				slot = (slot + 1) & mask;
+
+			if (table[slot] == 0)
+			{
+				if (compactedIndex != v)
+					mesh.verts[compactedIndex] = vert;
+				table[slot] = ++compactedIndex;
+			}
+			mesh.indices[v] = table[slot] - 1;
+		}
+
+		mesh.verts.resize(compactedIndex);
+		Export_Checkpoint("compactify", vert_count, vert_count);
+		FBX_PROFILE_ITEMS(scope, vert_count, compactedIndex);
+	}
+
+	void Write_Mesh_File(const simple_mesh& mesh, const char* output_file_path, uint64_t skeleton_hash)
+	{
+		FBX_PROFILE_SCOPE(scope, "write_mesh_file");
+		FBX_PROFILE_ITEMS(scope, mesh.vert_count, mesh.index_count);
+		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+
+		assert(file.is_open());
+
+		if (file.is_open())
+		{
+			Write_Mesh(file, mesh, skeleton_hash);
+			FBX_PROFILE_BYTES(scope, file.tellp());
+		}
+
+		file.close();
+	}
+
+	void Write_Mesh(std::ostream& file, const simple_mesh& mesh, uint64_t skeleton_hash)
+	{
+		file.write((char const*)&mesh.index_count, sizeof(uint32_t));
+		file.write((char const*)mesh.indices, sizeof(uint32_t) * mesh.index_count);
+		file.write((char const*)&mesh.vert_count, sizeof(uint32_t));
+		file.write((char const*)mesh.verts, sizeof(simple_vert) * mesh.vert_count);
+		// trails the vertices so readers of the original layout are unaffected
+		file.write((char const*)&skeleton_hash, sizeof(uint64_t));
+	}
+
+	void mesh_stream_writer::weld_entry::Set(const simple_vert& v)
+	{
+		const float values[8] = { v.pos.x, v.pos.y, v.pos.z, v.norm.x, v.norm.y, v.norm.z, v.tex_coord.x, v.tex_coord.y };
+		memcpy(key, values, sizeof(key));
+	}
+
+	bool mesh_stream_writer::weld_entry::Matches(const simple_vert& v) const
+	{
+		return	key[0] == v.pos.x && key[1] == v.pos.y && key[2] == v.pos.z
+			&&	key[3] == v.norm.x && key[4] == v.norm.y && key[5] == v.norm.z
+			&&	key[6] == v.tex_coord.x && key[7] == v.tex_coord.y;
+	}
+
+	size_t mesh_stream_writer::Weld_Entry_Size()
+	{
+		return sizeof(weld_entry);
+	}
+
+	mesh_stream_writer::~mesh_stream_writer()
+	{
+		// a writer that never got closed leaves no spill file behind
+		if (spill.is_open())
+		{
+			spill.close();
+			std::remove(spill_path.c_str());
+		}
+	}
+
+	int mesh_stream_writer::Open(const char* output_file_path, uint32_t total_index_count, size_t weld_table_bytes)
+	{
+		file.open(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+		output_path = output_file_path;
+		spill_path = output_path + ".verts";
+		spill.open(spill_path, std::ios::trunc | std::ios::binary | std::ios::out);
+		if (!file.is_open() || !spill.is_open())
+			return -1;
+
+		index_count = total_index_count;
+		indices_written = 0;
+		vertex_count = 0;
+		weld_resets = 0;
+		file.write((char const*)&index_count, sizeof(uint32_t));
+
+		// the largest power of two that fits, never bigger than the mesh needs
+		size_t slots = 16;
+		while (slots * 2 * sizeof(weld_entry) <= weld_table_bytes && slots < size_t(index_count) * 2)
+			slots *= 2;
+		table.assign(slots, weld_entry());
+		table_used = 0;
+		return 0;
+	}
+
+	void mesh_stream_writer::Write_Chunk(const simple_vert* verts, size_t count)
+	{
+		FBX_PROFILE_SCOPE(scope, "weld_chunk");
+		size_t mask = table.size() - 1;
+		chunk_indices.resize(count);
+
+		for (size_t v = 0; v < count; ++v)
+		{
+			// past half full probing gets slow, start over
+			if (table_used * 2 >= table.size())
+			{
+				std::fill(table.begin(), table.end(), weld_entry());
+				table_used = 0;
+				++weld_resets;
+			}
+
+			const simple_vert& vert = verts[v];
+			size_t slot = Weld_Hash(vert) & mask;
+			while (table[slot].index_plus_one != 0 && !table[slot].Matches(vert))
+				slot = (slot + 1) & mask;
+
+			if (table[slot].index_plus_one == 0)
+			{
+				spill.write((char const*)&vert, sizeof(simple_vert));
+				table[slot].index_plus_one = ++vertex_count;
+				table[slot].Set(vert);
+				++table_used;
+			}
+			chunk_indices[v] = table[slot].index_plus_one - 1;
+		}
+
+		file.write((char const*)chunk_indices.data(), sizeof(uint32_t) * count);
+		indices_written += static_cast<uint32_t>(count);
+		// out is the running total of welded vertices
+		FBX_PROFILE_ITEMS(scope, count, vertex_count);
+	}
+
+	int mesh_stream_writer::Close(uint64_t skeleton_hash)
+	{
+		FBX_PROFILE_SCOPE(scope, "write_mesh_file");
+		spill.close();
+		table.clear();
+		table.shrink_to_fit();
+
+		int result = indices_written == index_count && file.good() ? 0 : -1;
+		if (result == 0)
+		{
+			file.write((char const*)&vertex_count, sizeof(uint32_t));
+
+			// bring the vertices over in pieces, never the whole section at once
+			std::ifstream vertices(spill_path, std::ios::binary | std::ios::in);
+			std::vector<char> buffer(1 << 20);
+			while (vertices)
+			{
+				vertices.read(buffer.data(), buffer.size());
+				file.write(buffer.data(), vertices.gcount());
+			}
+			file.write((char const*)&skeleton_hash, sizeof(uint64_t));
+			FBX_PROFILE_BYTES(scope, file.tellp());
+			result = file.good() ? 0 : -1;
+		}
+		file.close();
+		std::remove(spill_path.c_str());
+		return result;
+	}
+
+	void mesh_stream_writer::Discard()
+	{
+		file.close();
+		spill.close();
+		std::remove(output_path.c_str());
+		std::remove(spill_path.c_str());
+	}
+}
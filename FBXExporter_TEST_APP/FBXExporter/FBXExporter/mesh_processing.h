@@ -0,0 +1,145 @@
+#pragma once
+
+#include "simple_mesh.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <fstream>
+#include <string>
+
+// Mesh processing once the Fbx sdk is out of the picture.
+// Process_Mesh copies what it needs out of the FbxMesh into a raw_mesh and everything after that lives here,
+// so the stages can be run and timed on generated data.
+// The buffers are pmr vectors so one export can carve all of them out of a single arena sized up front
+// (see Mesh_Arena_Size) and give the memory back in one go, each stage works in place on the previous one's output.
+namespace end
+{
+	const int MAX_INFLUENCES = 4; // max number of joints influencing a single vertex
+
+	struct influence
+	{
+		int joint = 0;
+		float weight = 0.0f;
+	};
+
+	using influence_set = std::array<influence, MAX_INFLUENCES>;
+
+	// the control points one joint moves and by how much, as read from an FbxCluster
+	struct skin_cluster
+	{
+		int joint = 0;
+		std::vector<int> control_points;
+		std::vector<float> weights;
+	};
+
+	// a triangulated mesh laid out the way the sdk hands it over
+	struct raw_mesh
+	{
+		explicit raw_mesh(std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+			: control_points(memory), polygon_vertices(memory), normals(memory), uvs(memory), influences(memory) {}
+
+		std::pmr::vector<DirectX::XMFLOAT4> control_points;
+		std::pmr::vector<int> polygon_vertices;			// control point of every triangle corner
+		std::pmr::vector<DirectX::XMFLOAT3> normals;	// per triangle corner
+		std::pmr::vector<DirectX::XMFLOAT2> uvs;		// per triangle corner
+		std::pmr::vector<influence_set> influences;		// per control point
+	};
+
+	// the welded vertex and index buffers, 'View' hands them to the writers without copying
+	struct mesh_buffers
+	{
+		explicit mesh_buffers(std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+			: verts(memory), indices(memory) {}
+
+		std::pmr::vector<simple_vert> verts;
+		std::pmr::vector<uint32_t> indices;
+
+		simple_mesh View()
+		{
+			return { static_cast<uint32_t>(verts.size()), static_cast<uint32_t>(indices.size()), verts.data(), indices.data() };
+		}
+	};
+
+	// Bytes one export of a mesh this size allocates from its arena, every buffer included
+	size_t Mesh_Arena_Size(size_t control_point_count, size_t corner_count);
+
+	// Gathers the strongest MAX_INFLUENCES joints of every control point
+	void Bind_Skin(const std::vector<skin_cluster>& clusters, size_t control_point_count, std::pmr::vector<influence_set>& out_influences);
+
+	// Copies the influences into 'vert' with the weights normalized, all of it on the first joint when they sum to 0
+	void Set_Influences(simple_vert& vert, const influence_set& influences);
+
+	// One vertex per triangle corner, weights normalized, written into 'out_mesh.verts'
+	void Expand_Vertices(const raw_mesh& mesh, mesh_buffers& out_mesh);
+
+	// Welds vertices with the same position, normal and uv in place, the first one keeps its slot,
+	// and fills 'indices' with one entry per original vertex.
+	// An export cancelled part way through leaves the mesh empty, see 'export_progress.h'
+	void Compactify(mesh_buffers& mesh);
+
+	// .mesh file layout
+	//	uint32_t index_count, uint32_t indices[index_count]
+	//	uint32_t vert_count, simple_vert verts[vert_count]
+	//	uint64_t skeleton_hash				- see skeleton.h
+	void Write_Mesh_File(const simple_mesh& mesh, const char* output_file_path, uint64_t skeleton_hash = 0);
+
+	// The same bytes as Write_Mesh_File into a stream that's already open, for files holding several meshes
+	void Write_Mesh(std::ostream& file, const simple_mesh& mesh, uint64_t skeleton_hash = 0);
+
+	// Writes a .mesh a chunk of expanded vertices at a time, for meshes too big to expand whole.
+	// Vertices are welded against a table of at most 'weld_table_bytes'; while it has room the output is the
+	// same as Compactify's. Once it fills up it starts over, vertices matching one from before that point are
+	// written again, so the mesh only gets a little bigger, never wrong.
+	// Indices go straight into the file, new vertices are spilled to '<output>.verts' and appended on Close.
+	class mesh_stream_writer
+	{
+	public:
+		mesh_stream_writer() = default;
+		~mesh_stream_writer();
+
+		mesh_stream_writer(const mesh_stream_writer&) = delete;
+		mesh_stream_writer& operator=(const mesh_stream_writer&) = delete;
+
+		// Returns 0 on success, non-zero to indicate failure
+		int Open(const char* output_file_path, uint32_t index_count, size_t weld_table_bytes);
+
+		void Write_Chunk(const simple_vert* verts, size_t count);
+
+		// Finishes the file, returns 0 on success, non-zero to indicate failure
+		int Close(uint64_t skeleton_hash = 0);
+
+		// Gives up on the file, neither it nor the spill is left behind
+		void Discard();
+
+		uint32_t Vertex_Count() const { return vertex_count; }
+
+		// Times the weld table filled up and started over
+		uint32_t Weld_Resets() const { return weld_resets; }
+
+		// Bytes a weld table entry takes
+		static size_t Weld_Entry_Size();
+
+	private:
+		// the welded attributes are kept in the table itself, the vertices are already on disk
+		struct weld_entry
+		{
+			uint32_t index_plus_one = 0;	// 0 is empty
+			float key[8];					// position, normal, uv
+
+			void Set(const simple_vert& v);
+			bool Matches(const simple_vert& v) const;
+		};
+
+		std::ofstream file;
+		std::ofstream spill;
+		std::string output_path;
+		std::string spill_path;
+		uint32_t index_count = 0;
+		uint32_t indices_written = 0;
+		uint32_t vertex_count = 0;
+		uint32_t weld_resets = 0;
+		std::vector<weld_entry> table;
+		size_t table_used = 0;
+		std::vector<uint32_t> chunk_indices;
+	};
+}
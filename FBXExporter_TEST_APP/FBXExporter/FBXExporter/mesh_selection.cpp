@@ -0,0 +1,204 @@
+#include "pch.h"
+#include "mesh_selection.h"
+#include "profiler.h"
+#include "mesh_instances.h"
+
+#include <fstream>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+
+namespace end
+{
+	bool Glob_Match(const char* pattern, const char* name)
+	{
+		// on a mismatch the last '*' takes one more character, no recursion
+		const char* star = nullptr;
+		const char* resume = nullptr;
+		while (*name)
+		{
+			if (*pattern == '*')
+			{
+				star = pattern++;
+				resume = name;
+			}
+			else if (*pattern == '?' || *pattern == *name)
+			{
+				++pattern;
+				++name;
+			}
+			else if (star)
+			{
+				pattern = star + 1;
+				name = ++resume;
+			}
+			else
+				return false;
+		}
+		while (*pattern == '*')
+			++pattern;
+		return *pattern == '\0';
+	}
+
+	bool Has_Wildcards(const char* pattern)
+	{
+		return strpbrk(pattern, "*?") != nullptr;
+	}
+
+	void Add_Mesh_Node(mesh_name_index& index, const std::string& node_name, const std::string& mesh_name)
+	{
+		uint32_t node = static_cast<uint32_t>(index.node_names.size());
+		index.node_names.push_back(node_name);
+		index.mesh_names.push_back(mesh_name == node_name ? std::string() : mesh_name);
+		index.lookup[node_name].push_back(node);
+		if (!index.mesh_names.back().empty())
+			index.lookup[mesh_name].push_back(node);
+	}
+
+	void Select_Mesh_Nodes(const mesh_name_index& index, const char* const* patterns, uint32_t pattern_count, std::vector<uint32_t>& out_nodes)
+	{
+		FBX_PROFILE_SCOPE(scope, "select_meshes");
+		out_nodes.clear();
+		std::unordered_set<uint32_t> selected;
+		for (uint32_t p = 0; p < pattern_count; ++p)
+		{
+			const char* pattern = patterns[p];
+			if (!pattern)
+				continue;
+
+			if (!Has_Wildcards(pattern))
+			{
+				auto found = index.lookup.find(pattern);
+				if (found == index.lookup.end())
+					continue;
+				for (uint32_t node : found->second)
+					if (selected.insert(node).second)
+						out_nodes.push_back(node);
+				continue;
+			}
+
+			for (uint32_t node = 0; node < index.node_names.size(); ++node)
+			{
+				if (!Glob_Match(pattern, index.node_names[node].c_str()) &&
+					(index.mesh_names[node].empty() || !Glob_Match(pattern, index.mesh_names[node].c_str())))
+					continue;
+				if (selected.insert(node).second)
+					out_nodes.push_back(node);
+			}
+		}
+		FBX_PROFILE_ITEMS(scope, index.node_names.size(), out_nodes.size());
+	}
+
+	int64_t Find_Mesh_Node(const mesh_name_index& index, const char* name)
+	{
+		if (!name)
+			return -1;
+		// nodes go into the lookup in scene order, the first one is the earliest
+		auto found = index.lookup.find(name);
+		if (found == index.lookup.end() || found->second.empty())
+			return -1;
+		return found->second.front();
+	}
+
+	std::string Selected_Mesh_File_Name(const std::string& node_name, std::unordered_map<std::string, uint32_t>& used)
+	{
+		std::string base = node_name.empty() ? std::string("mesh") : node_name;
+		for (char& c : base)
+		{
+			if (strchr("<>:\"/\\|?*", c) || static_cast<unsigned char>(c) < 32)
+				c = '_';
+		}
+
+		// names are compared the way a case insensitive file system would
+		std::string name = base;
+		for (uint32_t suffix = 1;; ++suffix)
+		{
+			std::string key = name;
+			std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+			if (used.emplace(key, 0).second)
+				break;
+			name = base + "_" + std::to_string(suffix);
+		}
+		return name + ".mesh";
+	}
+
+	void Write_Multi_Mesh_File(const std::vector<selected_mesh>& meshes, const char* output_file_path)
+	{
+		FBX_PROFILE_SCOPE(scope, "write_multi_mesh_file");
+		multi_mesh_file_header header;
+		header.mesh_count = static_cast<uint32_t>(meshes.size());
+
+		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+
+		assert(file.is_open());
+
+		if (file.is_open())
+		{
+			file.write((char const*)&header, sizeof(multi_mesh_file_header));
+			for (const selected_mesh& mesh : meshes)
+			{
+				simple_mesh view = { static_cast<uint32_t>(mesh.welded.verts.size()), static_cast<uint32_t>(mesh.welded.indices.size()),
+					const_cast<simple_vert*>(mesh.welded.verts.data()), const_cast<uint32_t*>(mesh.welded.indices.data()) };
+				uint16_t length = static_cast<uint16_t>(std::min<size_t>(mesh.name.size(), UINT16_MAX));
+				uint64_t size = Mesh_File_Size(view);
+				file.write((char const*)&length, sizeof(uint16_t));
+				file.write(mesh.name.data(), length);
+				file.write((char const*)&size, sizeof(uint64_t));
+				Write_Mesh(file, view, mesh.skeleton_hash);
+			}
+			FBX_PROFILE_ITEMS(scope, meshes.size(), meshes.size());
+			FBX_PROFILE_BYTES(scope, file.tellp());
+		}
+
+		file.close();
+	}
+
+	int Load_Multi_Mesh_File(const char* file_path, std::vector<named_mesh>& out_meshes)
+	{
+		std::ifstream file(file_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+			return -1;
+
+		multi_mesh_file_header header;
+		file.read((char*)&header, sizeof(multi_mesh_file_header));
+		if (!file.good() || header.magic != MULTI_MESH_FILE_MAGIC || header.version != MULTI_MESH_FILE_VERSION)
+			return -1;
+
+		out_meshes.clear();
+		out_meshes.resize(header.mesh_count);
+		for (named_mesh& mesh : out_meshes)
+		{
+			uint16_t length = 0;
+			uint64_t size = 0;
+			file.read((char*)&length, sizeof(uint16_t));
+			mesh.name.resize(file.good() ? length : 0);
+			file.read(&mesh.name[0], mesh.name.size());
+			file.read((char*)&size, sizeof(uint64_t));
+
+			uint32_t index_count = 0, vert_count = 0;
+			file.read((char*)&index_count, sizeof(uint32_t));
+			if (!file.good())
+				return -1;
+			mesh.indices.resize(index_count);
+			file.read((char*)mesh.indices.data(), sizeof(uint32_t) * uint64_t(index_count));
+			file.read((char*)&vert_count, sizeof(uint32_t));
+			if (!file.good())
+				return -1;
+			mesh.verts.resize(vert_count);
+			file.read((char*)mesh.verts.data(), sizeof(simple_vert) * uint64_t(vert_count));
+			file.read((char*)&mesh.skeleton_hash, sizeof(uint64_t));
+			if (!file.good())
+				return -1;
+
+			// the size lets a reader skip a mesh, it has to agree with what was read
+			simple_mesh view = { vert_count, index_count, mesh.verts.data(), mesh.indices.data() };
+			if (size != Mesh_File_Size(view))
+				return -1;
+			for (uint32_t index : mesh.indices)
+				if (index >= vert_count)
+					return -1;
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "mesh_processing.h"
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// Pulling a handful of meshes (lods, collision proxies) out of a big master file by name in one import.
+// The names of every mesh node go into a hash index once per scene, exact names are looked up in it and
+// glob patterns run over it in scene order. No Fbx sdk dependency
+namespace end
+{
+	// '*' matches any run of characters, '?' any one, everything else itself. Case sensitive like node names are
+	bool Glob_Match(const char* pattern, const char* name);
+
+	bool Has_Wildcards(const char* pattern);
+
+	// every mesh node of a scene, a node is found by its own name or its mesh's
+	struct mesh_name_index
+	{
+		std::vector<std::string> node_names;								// scene order
+		std::vector<std::string> mesh_names;								// empty when the mesh has no name of its own
+		std::unordered_map<std::string, std::vector<uint32_t>> lookup;		// either name to every node with it
+	};
+
+	void Add_Mesh_Node(mesh_name_index& index, const std::string& node_name, const std::string& mesh_name);
+
+	// Every node matching one of 'patterns', each once: in the order of the patterns, scene order within one
+	void Select_Mesh_Nodes(const mesh_name_index& index, const char* const* patterns, uint32_t pattern_count, std::vector<uint32_t>& out_nodes);
+
+	// The first node in scene order named 'name', or whose mesh is. '*' and '?' are plain characters here.
+	// Returns -1 when there is none
+	int64_t Find_Mesh_Node(const mesh_name_index& index, const char* name);
+
+	// '<node name>.mesh' with the characters a path can't hold replaced, "_1", "_2".. after names already in 'used'
+	std::string Selected_Mesh_File_Name(const std::string& node_name, std::unordered_map<std::string, uint32_t>& used);
+
+	// one match read and welded, the weld runs on a helper thread once every match is read
+	struct selected_mesh
+	{
+		std::string name;
+		raw_mesh raw;
+		mesh_buffers welded;
+		uint64_t skeleton_hash = 0;			// 0 unless the mesh is skinned
+	};
+
+	// .mmsh file layout
+	//	multi_mesh_file_header
+	//	per mesh: uint16_t name_length, char name[name_length], uint64_t size, then 'size' bytes laid out like a .mesh
+	const uint32_t MULTI_MESH_FILE_MAGIC = 0x48534D4D; // "MMSH"
+	const uint32_t MULTI_MESH_FILE_VERSION = 1;
+
+	struct multi_mesh_file_header
+	{
+		uint32_t magic = MULTI_MESH_FILE_MAGIC;
+		uint32_t version = MULTI_MESH_FILE_VERSION;
+		uint32_t mesh_count = 0;
+		uint32_t unused = 0;
+	};
+
+	void Write_Multi_Mesh_File(const std::vector<selected_mesh>& meshes, const char* output_file_path);
+
+	// a mesh read back out of a .mmsh
+	struct named_mesh
+	{
+		std::string name;
+		std::vector<simple_vert> verts;
+		std::vector<uint32_t> indices;
+		uint64_t skeleton_hash = 0;
+	};
+
+	// Returns 0 on success, non-zero to indicate failure
+	int Load_Multi_Mesh_File(const char* file_path, std::vector<named_mesh>& out_meshes);
+}
@@ -0,0 +1,241 @@
+#include "pch.h"
+#include "morph_targets.h"
+#include "profiler.h"
+
+#include <fstream>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+
+namespace end
+{
+	void Split_Shared_Control_Points(mesh_buffers& mesh, const std::pmr::vector<int>& polygon_vertices, std::vector<uint32_t>& out_source_corners)
+	{
+		const uint32_t NONE = UINT32_MAX;
+		out_source_corners.assign(mesh.verts.size(), NONE);
+
+		// (vertex, control point) -> the vertex split off for that control point
+		std::unordered_map<uint64_t, uint32_t> splits;
+		for (size_t corner = 0; corner < mesh.indices.size(); ++corner)
+		{
+			uint32_t vert = mesh.indices[corner];
+			uint32_t& source = out_source_corners[vert];
+			if (source == NONE)
+			{
+				source = static_cast<uint32_t>(corner);
+				continue;
+			}
+			int control_point = polygon_vertices[corner];
+			if (polygon_vertices[source] == control_point)
+				continue;
+
+			uint64_t key = (uint64_t(vert) << 32) | static_cast<uint32_t>(control_point);
+			auto split = splits.find(key);
+			if (split == splits.end())
+			{
+				simple_vert copy = mesh.verts[vert];
+				mesh.verts.push_back(copy);
+				out_source_corners.push_back(static_cast<uint32_t>(corner));
+				split = splits.emplace(key, static_cast<uint32_t>(mesh.verts.size() - 1)).first;
+			}
+			mesh.indices[corner] = split->second;
+		}
+	}
+
+	void Build_Morph_Shape(const raw_mesh& base, const mesh_buffers& welded, const std::vector<uint32_t>& source_corners,
+		const std::vector<DirectX::XMFLOAT4>& target_points, const std::vector<DirectX::XMFLOAT3>& target_normals,
+		float full_weight, const morph_tolerance& tolerance, morph_shape& out_shape)
+	{
+		FBX_PROFILE_SCOPE(scope, "build_morph_shape");
+		out_shape = morph_shape();
+		out_shape.full_weight = full_weight;
+
+		// full precision first, the scale depends on the largest delta
+		std::vector<DirectX::XMFLOAT3> position_deltas;
+		std::vector<DirectX::XMFLOAT3> normal_deltas;
+		float largest = 0.0f;
+		for (size_t v = 0; v < welded.verts.size(); ++v)
+		{
+			uint32_t corner = source_corners[v];
+			int control_point = base.polygon_vertices[corner];
+			if (control_point < 0 || static_cast<size_t>(control_point) >= target_points.size())
+				continue;
+
+			const DirectX::XMFLOAT4& from = base.control_points[control_point];
+			const DirectX::XMFLOAT4& to = target_points[control_point];
+			DirectX::XMFLOAT3 position = { to.x - from.x, to.y - from.y, to.z - from.z };
+			DirectX::XMFLOAT3 normal = { 0.0f, 0.0f, 0.0f };
+			if (corner < target_normals.size())
+			{
+				const DirectX::XMFLOAT3& n = welded.verts[v].norm;
+				normal = { target_normals[corner].x - n.x, target_normals[corner].y - n.y, target_normals[corner].z - n.z };
+			}
+
+			float moved = std::max({ std::fabs(position.x), std::fabs(position.y), std::fabs(position.z) });
+			float turned = std::max({ std::fabs(normal.x), std::fabs(normal.y), std::fabs(normal.z) });
+			if (moved <= tolerance.position && turned <= tolerance.normal)
+				continue;
+
+			out_shape.vertices.push_back(static_cast<uint32_t>(v));
+			position_deltas.push_back(position);
+			normal_deltas.push_back(normal);
+			largest = std::max(largest, moved);
+		}
+
+		out_shape.position_scale = largest > 0.0f ? largest / 32767.0f : 0.0f;
+		float to_position = largest > 0.0f ? 1.0f / out_shape.position_scale : 0.0f;
+		out_shape.positions.reserve(position_deltas.size() * 3);
+		out_shape.normals.reserve(normal_deltas.size() * 3);
+		for (size_t i = 0; i < position_deltas.size(); ++i)
+		{
+			const float* p = &position_deltas[i].x;
+			const float* n = &normal_deltas[i].x;
+			for (int c = 0; c < 3; ++c)
+			{
+				out_shape.positions.push_back(static_cast<int16_t>(std::lround(std::clamp(p[c] * to_position, -32767.0f, 32767.0f))));
+				out_shape.normals.push_back(static_cast<int8_t>(std::lround(std::clamp(n[c] / MORPH_NORMAL_SCALE, -127.0f, 127.0f))));
+			}
+		}
+		FBX_PROFILE_ITEMS(scope, welded.verts.size(), out_shape.vertices.size());
+	}
+
+	namespace
+	{
+		void Add_Morph_Shape(const morph_shape& shape, float amount, simple_vert* verts, size_t vert_count)
+		{
+			if (amount == 0.0f)
+				return;
+			float position = shape.position_scale * amount;
+			float normal = MORPH_NORMAL_SCALE * amount;
+			for (size_t i = 0; i < shape.vertices.size(); ++i)
+			{
+				if (shape.vertices[i] >= vert_count)
+					continue;
+				simple_vert& vert = verts[shape.vertices[i]];
+				vert.pos.x += shape.positions[i * 3 + 0] * position;
+				vert.pos.y += shape.positions[i * 3 + 1] * position;
+				vert.pos.z += shape.positions[i * 3 + 2] * position;
+				vert.norm.x += shape.normals[i * 3 + 0] * normal;
+				vert.norm.y += shape.normals[i * 3 + 1] * normal;
+				vert.norm.z += shape.normals[i * 3 + 2] * normal;
+			}
+		}
+	}
+
+	void Apply_Morph_Channel(const morph_channel& channel, float weight, simple_vert* verts, size_t vert_count)
+	{
+		const std::vector<morph_shape>& shapes = channel.shapes;
+		if (shapes.empty() || weight == 0.0f)
+			return;
+
+		// up to the first shape it fades in from the base mesh
+		if (weight <= shapes[0].full_weight || shapes.size() == 1)
+		{
+			if (shapes[0].full_weight > 0.0f)
+				Add_Morph_Shape(shapes[0], weight / shapes[0].full_weight, verts, vert_count);
+			return;
+		}
+
+		// between two in-betweens it blends from one to the next, past the last it keeps going
+		size_t next = 1;
+		while (next + 1 < shapes.size() && weight > shapes[next].full_weight)
+			++next;
+		const morph_shape& from = shapes[next - 1];
+		const morph_shape& to = shapes[next];
+		float span = to.full_weight - from.full_weight;
+		float t = span > 0.0f ? (weight - from.full_weight) / span : 1.0f;
+		Add_Morph_Shape(from, 1.0f - t, verts, vert_count);
+		Add_Morph_Shape(to, t, verts, vert_count);
+	}
+
+	void Write_Morph_File(const std::vector<morph_channel>& channels, uint32_t vert_count, uint64_t mesh_hash, const char* output_file_path)
+	{
+		FBX_PROFILE_SCOPE(scope, "write_morph_file");
+		morph_file_header header;
+		header.channel_count = static_cast<uint32_t>(channels.size());
+		header.vert_count = vert_count;
+		header.mesh_hash = mesh_hash;
+
+		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+
+		assert(file.is_open());
+
+		if (file.is_open())
+		{
+			file.write((char const*)&header, sizeof(morph_file_header));
+			for (auto& channel : channels)
+			{
+				uint16_t length = static_cast<uint16_t>(std::min<size_t>(channel.name.size(), UINT16_MAX));
+				uint32_t shape_count = static_cast<uint32_t>(channel.shapes.size());
+				file.write((char const*)&length, sizeof(uint16_t));
+				file.write(channel.name.c_str(), length);
+				file.write((char const*)&channel.default_weight, sizeof(float));
+				file.write((char const*)&shape_count, sizeof(uint32_t));
+				for (auto& shape : channel.shapes)
+				{
+					uint32_t count = static_cast<uint32_t>(shape.vertices.size());
+					file.write((char const*)&shape.full_weight, sizeof(float));
+					file.write((char const*)&shape.position_scale, sizeof(float));
+					file.write((char const*)&count, sizeof(uint32_t));
+					file.write((char const*)shape.vertices.data(), sizeof(uint32_t) * count);
+					file.write((char const*)shape.positions.data(), sizeof(int16_t) * 3 * count);
+					file.write((char const*)shape.normals.data(), sizeof(int8_t) * 3 * count);
+				}
+			}
+			FBX_PROFILE_BYTES(scope, file.tellp());
+		}
+
+		file.close();
+	}
+
+	int Load_Morph_File(const char* file_path, std::vector<morph_channel>& out_channels, morph_file_header* out_header)
+	{
+		std::ifstream file(file_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+			return -1;
+
+		morph_file_header header;
+		file.read((char*)&header, sizeof(morph_file_header));
+		if (!file.good() || header.magic != MORPH_FILE_MAGIC || header.version != MORPH_FILE_VERSION)
+			return -1;
+
+		out_channels.clear();
+		out_channels.resize(header.channel_count);
+		for (auto& channel : out_channels)
+		{
+			uint16_t length = 0;
+			uint32_t shape_count = 0;
+			file.read((char*)&length, sizeof(uint16_t));
+			channel.name.resize(length);
+			file.read(&channel.name[0], length);
+			file.read((char*)&channel.default_weight, sizeof(float));
+			file.read((char*)&shape_count, sizeof(uint32_t));
+			if (!file.good())
+				return -1;
+
+			channel.shapes.resize(shape_count);
+			for (auto& shape : channel.shapes)
+			{
+				uint32_t count = 0;
+				file.read((char*)&shape.full_weight, sizeof(float));
+				file.read((char*)&shape.position_scale, sizeof(float));
+				file.read((char*)&count, sizeof(uint32_t));
+				if (!file.good() || count > header.vert_count)
+					return -1;
+				shape.vertices.resize(count);
+				shape.positions.resize(size_t(count) * 3);
+				shape.normals.resize(size_t(count) * 3);
+				file.read((char*)shape.vertices.data(), sizeof(uint32_t) * count);
+				file.read((char*)shape.positions.data(), sizeof(int16_t) * 3 * count);
+				file.read((char*)shape.normals.data(), sizeof(int8_t) * 3 * count);
+			}
+		}
+		if (!file.good())
+			return -1;
+
+		if (out_header)
+			*out_header = header;
+		return 0;
+	}
+}
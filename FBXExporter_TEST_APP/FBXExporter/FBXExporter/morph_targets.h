@@ -0,0 +1,79 @@
+#pragma once
+
+#include "simple_mesh.h"
+#include "mesh_processing.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <DirectXMath.h>
+
+// Blend shapes (morph targets) stored as sparse deltas against the welded .mesh they were exported with.
+// A shape only keeps the vertices it moves, position deltas as int16 scaled per shape and normal deltas as int8,
+// so a face with a hundred targets costs a fraction of a hundred copies of the vertex buffer.
+// No Fbx sdk dependency, the runtime can read and apply them directly
+namespace end
+{
+	// one target of a channel, fully applied at 'full_weight'
+	struct morph_shape
+	{
+		float full_weight = 1.0f;				// 0 to 1, in-betweens sit below 1
+		float position_scale = 0.0f;			// position delta = positions * position_scale
+		std::vector<uint32_t> vertices;			// welded vertex of every delta, ascending
+		std::vector<int16_t> positions;			// xyz per vertex
+		std::vector<int8_t> normals;			// xyz per vertex, normal delta = normals * MORPH_NORMAL_SCALE
+	};
+
+	// what the animator drives, one weight blending through the channel's shapes in order
+	struct morph_channel
+	{
+		std::string name;
+		float default_weight = 0.0f;			// 0 to 1
+		std::vector<morph_shape> shapes;		// ascending full weights
+	};
+
+	const float MORPH_NORMAL_SCALE = 2.0f / 127.0f;
+
+	struct morph_tolerance
+	{
+		float position = 0.0001f;				// scene units, smaller moves are left out
+		float normal = 0.001f;
+	};
+
+	// Welding may have merged corners of different control points sitting on the same spot, which a shape
+	// can pull apart. Gives those corners vertices of their own (appended, the rest keep their index) and
+	// fills 'out_source_corners' with a triangle corner of every vertex, all of a vertex's corners share a control point
+	void Split_Shared_Control_Points(mesh_buffers& mesh, const std::pmr::vector<int>& polygon_vertices, std::vector<uint32_t>& out_source_corners);
+
+	// Deltas of one target against the welded mesh. 'target_points' are absolute, per control point like
+	// raw_mesh::control_points, 'target_normals' per triangle corner or empty when the target leaves normals alone
+	void Build_Morph_Shape(const raw_mesh& base, const mesh_buffers& welded, const std::vector<uint32_t>& source_corners,
+		const std::vector<DirectX::XMFLOAT4>& target_points, const std::vector<DirectX::XMFLOAT3>& target_normals,
+		float full_weight, const morph_tolerance& tolerance, morph_shape& out_shape);
+
+	// Adds the channel at 'weight' onto 'verts', blending between the two shapes around it
+	void Apply_Morph_Channel(const morph_channel& channel, float weight, simple_vert* verts, size_t vert_count);
+
+	// .morph file layout
+	//	morph_file_header
+	//	per channel: uint16_t name_length, char name[name_length], float default_weight, uint32_t shape_count
+	//		per shape: float full_weight, float position_scale, uint32_t count,
+	//			uint32_t vertices[count], int16_t positions[count * 3], int8_t normals[count * 3]
+	const uint32_t MORPH_FILE_MAGIC = 0x4850524D; // "MRPH"
+	const uint32_t MORPH_FILE_VERSION = 1;
+
+	struct morph_file_header
+	{
+		uint32_t magic = MORPH_FILE_MAGIC;
+		uint32_t version = MORPH_FILE_VERSION;
+		uint32_t channel_count = 0;
+		uint32_t vert_count = 0;				// of the .mesh the deltas index into
+		uint64_t mesh_hash = 0;					// Mesh_Content_Hash of that .mesh
+	};
+
+	void Write_Morph_File(const std::vector<morph_channel>& channels, uint32_t vert_count, uint64_t mesh_hash, const char* output_file_path);
+
+	// Returns 0 on success, non-zero to indicate failure
+	int Load_Morph_File(const char* file_path, std::vector<morph_channel>& out_channels, morph_file_header* out_header = nullptr);
+}
@@ -0,0 +1,120 @@
+#include "pch.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <unordered_map>
+#ifdef _WIN32
+#include <psapi.h>
+#endif
+
+namespace end
+{
+	namespace
+	{
+		struct profile_state
+		{
+			std::mutex lock;
+			std::vector<profile_event> events;
+			std::unordered_map<std::thread::id, uint32_t> threads;
+			profile_callback callback = nullptr;
+			void* user_data = nullptr;
+			std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+		};
+
+		profile_state& State()
+		{
+			static profile_state state;
+			return state;
+		}
+
+		int64_t Now_Us()
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - State().epoch).count();
+		}
+	}
+
+	profile_scope::profile_scope(const char* name)
+	{
+		event.name = name;
+		event.start_us = Now_Us();
+	}
+
+	profile_scope::~profile_scope()
+	{
+		event.duration_us = Now_Us() - event.start_us;
+		event.peak_bytes = Peak_Process_Bytes();
+
+		profile_state& state = State();
+		profile_callback callback = nullptr;
+		void* user_data = nullptr;
+		{
+			std::lock_guard<std::mutex> guard(state.lock);
+			auto thread = state.threads.emplace(std::this_thread::get_id(), static_cast<uint32_t>(state.threads.size())).first;
+			event.thread = thread->second;
+			state.events.push_back(event);
+			callback = state.callback;
+			user_data = state.user_data;
+		}
+		if (callback)
+			callback(event, user_data);
+	}
+
+	void Set_Profile_Callback(profile_callback callback, void* user_data)
+	{
+		profile_state& state = State();
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.callback = callback;
+		state.user_data = user_data;
+	}
+
+	void Reset_Profile()
+	{
+		profile_state& state = State();
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.events.clear();
+	}
+
+	void Get_Profile_Events(std::vector<profile_event>& out_events)
+	{
+		profile_state& state = State();
+		std::lock_guard<std::mutex> guard(state.lock);
+		out_events = state.events;
+	}
+
+	uint64_t Peak_Process_Bytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters = {};
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.PeakPagefileUsage;
+#endif
+		return 0;
+	}
+
+	int Write_Profile_Trace(const char* output_file_path)
+	{
+		std::vector<profile_event> events;
+		Get_Profile_Events(events);
+
+		std::ofstream file(output_file_path, std::ios::trunc | std::ios::out);
+		if (!file.is_open())
+			return -1;
+
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		for (size_t i = 0; i < events.size(); ++i)
+		{
+			const profile_event& e = events[i];
+			file << "{\"name\":\"" << e.name << "\",\"cat\":\"export\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+				<< ",\"ts\":" << e.start_us << ",\"dur\":" << e.duration_us
+				<< ",\"args\":{\"items_in\":" << e.items_in << ",\"items_out\":" << e.items_out
+				<< ",\"bytes_written\":" << e.bytes_written << ",\"peak_bytes\":" << e.peak_bytes << "}}"
+				<< (i + 1 < events.size() ? ",\n" : "\n");
+		}
+		file << "]}\n";
+
+		return file.good() ? 0 : -1;
+	}
+}
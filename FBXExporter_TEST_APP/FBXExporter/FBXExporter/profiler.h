@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Scoped timing and counters for the export stages.
+// Only compiled in when FBXEXPORTER_PROFILING is defined (add it to the project's preprocessor definitions),
+// otherwise the FBX_PROFILE_* macros expand to nothing and their arguments are never evaluated.
+//
+//	FBX_PROFILE_SCOPE(scope, "compactify");
+//	...
+//	FBX_PROFILE_ITEMS(scope, vertices_in, vertices_out);
+//	FBX_PROFILE_BYTES(scope, bytes_written);
+namespace end
+{
+	struct profile_event
+	{
+		const char* name = nullptr;		// string literal, events with the same pointer are the same stage
+		int64_t start_us = 0;			// since the first event of the process
+		int64_t duration_us = 0;
+		uint32_t thread = 0;
+		uint64_t items_in = 0;
+		uint64_t items_out = 0;
+		uint64_t bytes_written = 0;
+		uint64_t peak_bytes = 0;		// process high water mark when the stage finished
+	};
+
+	using profile_callback = void(*)(const profile_event& event, void* user_data);
+
+	class profile_scope
+	{
+	public:
+		explicit profile_scope(const char* name);
+		~profile_scope();
+
+		profile_scope(const profile_scope&) = delete;
+		profile_scope& operator=(const profile_scope&) = delete;
+
+		void Items(uint64_t items_in, uint64_t items_out) { event.items_in = items_in; event.items_out = items_out; }
+		void Bytes(uint64_t bytes_written) { event.bytes_written += bytes_written; }
+
+	private:
+		profile_event event;
+	};
+
+	// Called once per finished scope, from the thread that ran it
+	void Set_Profile_Callback(profile_callback callback, void* user_data);
+
+	void Reset_Profile();
+
+	// Copies every event recorded since the last reset
+	void Get_Profile_Events(std::vector<profile_event>& out_events);
+
+	// Peak private bytes of the process so far, 0 where the platform can't tell
+	uint64_t Peak_Process_Bytes();
+
+	// Chrome trace_event json, open it in chrome://tracing or ui.perfetto.dev
+	// Returns 0 on success, non-zero to indicate failure
+	int Write_Profile_Trace(const char* output_file_path);
+}
+
+#ifdef FBXEXPORTER_PROFILING
+#define FBX_PROFILE_SCOPE(scope, name) end::profile_scope scope(name)
+#define FBX_PROFILE_ITEMS(scope, items_in, items_out) scope.Items(static_cast<uint64_t>(items_in), static_cast<uint64_t>(items_out))
+#define FBX_PROFILE_BYTES(scope, bytes_written) scope.Bytes(static_cast<uint64_t>(bytes_written))
+#else
+#define FBX_PROFILE_SCOPE(scope, name)
+#define FBX_PROFILE_ITEMS(scope, items_in, items_out)
+#define FBX_PROFILE_BYTES(scope, bytes_written)
+#endif
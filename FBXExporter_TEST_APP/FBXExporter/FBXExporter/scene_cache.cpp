@@ -0,0 +1,316 @@
+#include "pch.h"
+#include "scene_cache.h"
+#include "profiler.h"
+#include "fnv1a.h"
+
+#include <fstream>
+#include <cstdio>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+namespace end
+{
+	int Source_File_Hash(const char* file_path, uint64_t& out_hash)
+	{
+		FBX_PROFILE_SCOPE(scope, "source_file_hash");
+		std::ifstream file(file_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+			return -1;
+
+		std::vector<char> block(1 << 20);
+		uint64_t hash = detail::FNV_offset_basis;
+		while (file)
+		{
+			file.read(block.data(), block.size());
+			hash = fnv1a(block.data(), static_cast<size_t>(file.gcount()), hash);
+		}
+		if (file.bad())
+			return -1;
+		out_hash = hash;
+		return 0;
+	}
+
+	std::string Scene_Cache_File_Name(uint64_t source_hash)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.fbxcache", static_cast<unsigned long long>(source_hash));
+		return name;
+	}
+
+	void Raw_Mesh_From_Cache(const cached_mesh& mesh, raw_mesh& out_raw)
+	{
+		size_t corner_count = mesh.polygon_vertices.size();
+		out_raw.control_points.resize(mesh.control_points.size());
+		for (size_t c = 0; c < mesh.control_points.size(); ++c)
+			out_raw.control_points[c] = { mesh.control_points[c].x, mesh.control_points[c].y, mesh.control_points[c].z, 1.0f };
+
+		if (mesh.skinned)
+			Bind_Skin(mesh.clusters, mesh.control_points.size(), out_raw.influences);
+		else
+		{
+			// nothing deforms it, the whole mesh follows the first joint
+			influence_set rigid;
+			rigid[0].weight = 1.0f;
+			out_raw.influences.assign(mesh.control_points.size(), rigid);
+		}
+
+		out_raw.polygon_vertices.assign(mesh.polygon_vertices.begin(), mesh.polygon_vertices.end());
+		if (mesh.normals.empty())
+			out_raw.normals.assign(corner_count, DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f });
+		else
+			out_raw.normals.assign(mesh.normals.begin(), mesh.normals.end());
+		if (mesh.uv_sets.empty())
+			out_raw.uvs.assign(corner_count, DirectX::XMFLOAT2{ 0.0f, 0.0f });
+		else
+			out_raw.uvs.assign(mesh.uv_sets[0].begin(), mesh.uv_sets[0].end());
+	}
+
+	void Attribute_Mesh_From_Cache(const cached_mesh& mesh, uint32_t joint_count, attribute_mesh& out_mesh)
+	{
+		size_t corner_count = mesh.polygon_vertices.size();
+		out_mesh = attribute_mesh();
+		out_mesh.positions.resize(corner_count);
+		for (size_t corner = 0; corner < corner_count; ++corner)
+			out_mesh.positions[corner] = mesh.control_points[mesh.polygon_vertices[corner]];
+		out_mesh.normals = mesh.normals;
+		out_mesh.colors = mesh.colors;
+		out_mesh.uv_sets = mesh.uv_sets;
+
+		if (mesh.skinned)
+		{
+			std::pmr::vector<influence_set> influences;
+			Bind_Skin(mesh.clusters, mesh.control_points.size(), influences);
+			out_mesh.influences.resize(corner_count);
+			for (size_t corner = 0; corner < corner_count; ++corner)
+				out_mesh.influences[corner] = influences[mesh.polygon_vertices[corner]];
+			out_mesh.joint_count = joint_count;
+		}
+	}
+
+	void Collision_Mesh_From_Cache(const cached_mesh& mesh, collision_mesh& out_mesh)
+	{
+		out_mesh.vertices = mesh.control_points;
+		out_mesh.indices.assign(mesh.polygon_vertices.begin(), mesh.polygon_vertices.end());
+	}
+
+	namespace
+	{
+		template<typename T>
+		void Write_Array(std::ofstream& file, const std::vector<T>& values)
+		{
+			file.write((char const*)values.data(), sizeof(T) * values.size());
+		}
+
+		template<typename T>
+		void Read_Array(std::ifstream& file, std::vector<T>& values, size_t count)
+		{
+			values.resize(count);
+			file.read((char*)values.data(), sizeof(T) * count);
+		}
+
+		void Write_Name(std::ofstream& file, const std::string& name)
+		{
+			uint16_t length = static_cast<uint16_t>(std::min<size_t>(name.size(), UINT16_MAX));
+			file.write((char const*)&length, sizeof(uint16_t));
+			file.write(name.data(), length);
+		}
+
+		void Read_Name(std::ifstream& file, std::string& name)
+		{
+			uint16_t length = 0;
+			file.read((char*)&length, sizeof(uint16_t));
+			name.resize(file.good() ? length : 0);
+			file.read(&name[0], name.size());
+		}
+
+		struct cached_mesh_header
+		{
+			uint32_t control_point_count = 0;
+			uint32_t corner_count = 0;
+			uint32_t uv_set_count = 0;
+			uint32_t cluster_count = 0;
+			uint8_t has_normals = 0;
+			uint8_t has_colors = 0;
+			uint8_t skinned = 0;
+			uint8_t unused = 0;
+		};
+	}
+
+	int Write_Scene_Cache_File(const scene_cache& cache, const char* output_file_path)
+	{
+		FBX_PROFILE_SCOPE(scope, "write_scene_cache_file");
+		scene_cache_header header;
+		header.source_hash = cache.source_hash;
+		header.mesh_count = static_cast<uint32_t>(cache.meshes.size());
+		header.node_count = static_cast<uint32_t>(cache.nodes.size());
+		header.joint_count = cache.has_skeleton ? static_cast<uint32_t>(cache.skel.names.size()) : 0;
+		header.frame_count = cache.has_animation ? static_cast<uint32_t>(cache.clip.frames.size()) : 0;
+		header.has_skeleton = cache.has_skeleton;
+		header.has_animation = cache.has_animation;
+
+		// per thread, two jobs exporting the same file can both miss and build it
+		std::string temporary_path = std::string(output_file_path) + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		std::ofstream file(temporary_path, std::ios::trunc | std::ios::binary | std::ios::out);
+		if (!file.is_open())
+			return -1;
+
+		file.write((char const*)&header, sizeof(scene_cache_header));
+		if (cache.has_skeleton)
+		{
+			Write_Array(file, cache.skel.parent_indices);
+			Write_Array(file, cache.skel.inverse_bind);
+			for (const std::string& name : cache.skel.names)
+				Write_Name(file, name);
+		}
+
+		for (const cached_mesh& mesh : cache.meshes)
+		{
+			cached_mesh_header mesh_header;
+			mesh_header.control_point_count = static_cast<uint32_t>(mesh.control_points.size());
+			mesh_header.corner_count = static_cast<uint32_t>(mesh.polygon_vertices.size());
+			mesh_header.uv_set_count = static_cast<uint32_t>(mesh.uv_sets.size());
+			mesh_header.cluster_count = static_cast<uint32_t>(mesh.clusters.size());
+			mesh_header.has_normals = !mesh.normals.empty();
+			mesh_header.has_colors = !mesh.colors.empty();
+			mesh_header.skinned = mesh.skinned;
+			file.write((char const*)&mesh_header, sizeof(cached_mesh_header));
+
+			Write_Array(file, mesh.control_points);
+			Write_Array(file, mesh.polygon_vertices);
+			Write_Array(file, mesh.normals);
+			Write_Array(file, mesh.colors);
+			for (const std::vector<DirectX::XMFLOAT2>& uvs : mesh.uv_sets)
+				Write_Array(file, uvs);
+			for (const skin_cluster& cluster : mesh.clusters)
+			{
+				uint32_t count = static_cast<uint32_t>(cluster.control_points.size());
+				file.write((char const*)&cluster.joint, sizeof(int));
+				file.write((char const*)&count, sizeof(uint32_t));
+				Write_Array(file, cluster.control_points);
+				Write_Array(file, cluster.weights);
+			}
+		}
+
+		for (const cached_node& node : cache.nodes)
+		{
+			Write_Name(file, node.name);
+			Write_Name(file, node.mesh_name);
+			file.write((char const*)&node.mesh, sizeof(uint32_t));
+			file.write((char const*)&node.root_child, sizeof(int));
+		}
+
+		if (cache.has_animation)
+		{
+			file.write((char const*)&cache.clip.duration, sizeof(double));
+			for (const myKeyFrame& frame : cache.clip.frames)
+			{
+				file.write((char const*)&frame.time, sizeof(double));
+				Write_Array(file, frame.joints);
+			}
+		}
+		FBX_PROFILE_ITEMS(scope, header.mesh_count, header.frame_count);
+		FBX_PROFILE_BYTES(scope, file.tellp());
+
+		bool written = file.good();
+		file.close();
+		std::error_code error;
+		if (written)
+			std::filesystem::rename(temporary_path, output_file_path, error);
+		if (!written || error)
+		{
+			std::filesystem::remove(temporary_path, error);
+			return -1;
+		}
+		return 0;
+	}
+
+	int Load_Scene_Cache_File(const char* file_path, scene_cache& out_cache)
+	{
+		FBX_PROFILE_SCOPE(scope, "load_scene_cache_file");
+		std::ifstream file(file_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+			return -1;
+
+		scene_cache_header header;
+		file.read((char*)&header, sizeof(scene_cache_header));
+		if (!file.good() || header.magic != SCENE_CACHE_FILE_MAGIC || header.version != SCENE_CACHE_FILE_VERSION)
+			return -1;
+
+		out_cache = scene_cache();
+		out_cache.source_hash = header.source_hash;
+		out_cache.has_skeleton = header.has_skeleton != 0;
+		out_cache.has_animation = header.has_animation != 0;
+		if (out_cache.has_skeleton)
+		{
+			Read_Array(file, out_cache.skel.parent_indices, header.joint_count);
+			Read_Array(file, out_cache.skel.inverse_bind, header.joint_count);
+			out_cache.skel.names.resize(header.joint_count);
+			for (std::string& name : out_cache.skel.names)
+				Read_Name(file, name);
+		}
+
+		out_cache.meshes.resize(header.mesh_count);
+		for (cached_mesh& mesh : out_cache.meshes)
+		{
+			cached_mesh_header mesh_header;
+			file.read((char*)&mesh_header, sizeof(cached_mesh_header));
+			if (!file.good())
+				return -1;
+
+			Read_Array(file, mesh.control_points, mesh_header.control_point_count);
+			Read_Array(file, mesh.polygon_vertices, mesh_header.corner_count);
+			Read_Array(file, mesh.normals, mesh_header.has_normals ? mesh_header.corner_count : 0);
+			Read_Array(file, mesh.colors, mesh_header.has_colors ? mesh_header.corner_count : 0);
+			mesh.uv_sets.resize(mesh_header.uv_set_count);
+			for (std::vector<DirectX::XMFLOAT2>& uvs : mesh.uv_sets)
+				Read_Array(file, uvs, mesh_header.corner_count);
+			mesh.skinned = mesh_header.skinned != 0;
+			mesh.clusters.resize(mesh_header.cluster_count);
+			for (skin_cluster& cluster : mesh.clusters)
+			{
+				uint32_t count = 0;
+				file.read((char*)&cluster.joint, sizeof(int));
+				file.read((char*)&count, sizeof(uint32_t));
+				if (!file.good())
+					return -1;
+				Read_Array(file, cluster.control_points, count);
+				Read_Array(file, cluster.weights, count);
+			}
+			if (!file.good())
+				return -1;
+
+			// a corrupt index would read past the control points later on
+			for (int point : mesh.polygon_vertices)
+				if (point < 0 || static_cast<uint32_t>(point) >= mesh_header.control_point_count)
+					return -1;
+		}
+
+		out_cache.nodes.resize(header.node_count);
+		for (cached_node& node : out_cache.nodes)
+		{
+			Read_Name(file, node.name);
+			Read_Name(file, node.mesh_name);
+			file.read((char*)&node.mesh, sizeof(uint32_t));
+			file.read((char*)&node.root_child, sizeof(int));
+			if (!file.good() || node.mesh >= header.mesh_count)
+				return -1;
+		}
+
+		if (out_cache.has_animation)
+		{
+			file.read((char*)&out_cache.clip.duration, sizeof(double));
+			out_cache.clip.frames.resize(header.frame_count);
+			for (myKeyFrame& frame : out_cache.clip.frames)
+			{
+				file.read((char*)&frame.time, sizeof(double));
+				Read_Array(file, frame.joints, header.joint_count);
+			}
+			out_cache.clip.frameCount = static_cast<int>(out_cache.clip.frames.size());
+		}
+		if (!file.good())
+			return -1;
+		FBX_PROFILE_ITEMS(scope, header.mesh_count, header.frame_count);
+		return 0;
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "mesh_processing.h"
+#include "vertex_layout.h"
+#include "collision.h"
+#include "skeleton.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <DirectXMath.h>
+
+// What the exporters read out of an FbxScene, kept on disk so a file exported again with other options doesn't go
+// through the sdk import. One cache per source file, named after the hash of the file's bytes so an edited fbx
+// never hits a stale one. No Fbx sdk dependency
+namespace end
+{
+	// a triangulated mesh as the sdk has it, layer elements per triangle corner
+	struct cached_mesh
+	{
+		std::vector<DirectX::XMFLOAT3> control_points;
+		std::vector<int> polygon_vertices;					// control point of every triangle corner
+		std::vector<DirectX::XMFLOAT3> normals;				// empty when the mesh has none
+		std::vector<DirectX::XMFLOAT4> colors;				// first vertex color set, empty when the mesh has none
+		std::vector<std::vector<DirectX::XMFLOAT2>> uv_sets;
+		std::vector<skin_cluster> clusters;					// joints index the cache's skeleton
+		bool skinned = false;								// has a skin and the scene a skeleton
+	};
+
+	struct cached_node
+	{
+		std::string name;
+		std::string mesh_name;								// the FbxMesh's own name, often empty
+		uint32_t mesh = 0;
+		int root_child = -1;								// its place among the root's children, -1 deeper down
+	};
+
+	struct scene_cache
+	{
+		uint64_t source_hash = 0;
+		std::vector<cached_mesh> meshes;					// every distinct mesh once
+		std::vector<cached_node> nodes;						// mesh nodes in scene order
+		bool has_skeleton = false;							// the scene has a bind pose with a skeleton root
+		skeleton skel;
+		bool has_animation = false;
+		AnimClip clip;										// the current stack sampled like export_animation does
+	};
+
+	// fnv1a of the whole file, read a block at a time. Returns 0 on success, non-zero when it can't be read
+	int Source_File_Hash(const char* file_path, uint64_t& out_hash);
+
+	// "<16 hex digits>.fbxcache"
+	std::string Scene_Cache_File_Name(uint64_t source_hash);
+
+	// The raw_mesh Weld_Mesh would have read, bound rigidly to joint 0 unless the mesh is skinned
+	void Raw_Mesh_From_Cache(const cached_mesh& mesh, raw_mesh& out_raw);
+
+	// The attribute_mesh Read_Attribute_Mesh would have read, without a skin unless the mesh is skinned
+	void Attribute_Mesh_From_Cache(const cached_mesh& mesh, uint32_t joint_count, attribute_mesh& out_mesh);
+
+	// Positions welded through the control points, like export_collision reads them
+	void Collision_Mesh_From_Cache(const cached_mesh& mesh, collision_mesh& out_mesh);
+
+	// .fbxcache file layout
+	//	scene_cache_header
+	//	skeleton, when has_skeleton: int parent_indices[joint_count], DirectX::XMFLOAT4X4 inverse_bind[joint_count],
+	//		per joint: uint16_t name_length, char name[name_length]
+	//	per mesh: uint32_t control_point_count, corner_count, uv_set_count, cluster_count, uint8_t has_normals, has_colors, skinned, unused
+	//		DirectX::XMFLOAT3 control_points[control_point_count], int polygon_vertices[corner_count]
+	//		DirectX::XMFLOAT3 normals[corner_count] when has_normals, DirectX::XMFLOAT4 colors[corner_count] when has_colors
+	//		DirectX::XMFLOAT2 uvs[uv_set_count][corner_count]
+	//		per cluster: int joint, uint32_t count, int control_points[count], float weights[count]
+	//	per node: uint16_t name_length, char name[name_length], uint16_t mesh_name_length, char mesh_name[mesh_name_length],
+	//		uint32_t mesh, int root_child
+	//	animation, when has_animation: double duration, per frame: double time, Joint joints[joint_count]
+	const uint32_t SCENE_CACHE_FILE_MAGIC = 0x48434353; // "SCCH"
+	const uint32_t SCENE_CACHE_FILE_VERSION = 2;
+
+	struct scene_cache_header
+	{
+		uint32_t magic = SCENE_CACHE_FILE_MAGIC;
+		uint32_t version = SCENE_CACHE_FILE_VERSION;
+		uint64_t source_hash = 0;
+		uint32_t mesh_count = 0;
+		uint32_t node_count = 0;
+		uint32_t joint_count = 0;
+		uint32_t frame_count = 0;
+		uint8_t has_skeleton = 0;
+		uint8_t has_animation = 0;
+		uint16_t unused = 0;
+		uint32_t unused2 = 0;
+	};
+
+	// Written to a temporary file first and renamed, a reader never sees half a cache
+	// Returns 0 on success, non-zero to indicate failure
+	int Write_Scene_Cache_File(const scene_cache& cache, const char* output_file_path);
+
+	// Returns 0 on success, non-zero to indicate failure
+	int Load_Scene_Cache_File(const char* file_path, scene_cache& out_cache);
+}
@@ -47,13 +47,6 @@ namespace end
 		component_t components[COUNT];
 	};
 
-	struct myJoint
-	{
-		FbxNode* node;
-		DirectX::XMFLOAT4X4 globalBindposeInverse;
-		int parent_index;
-	};
-
 	struct Joint
 	{
 		DirectX::XMFLOAT4X4 global_xform;
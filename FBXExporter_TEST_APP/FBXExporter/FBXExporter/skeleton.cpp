@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "skeleton.h"
+#include "fnv1a.h"
+#include "profiler.h"
+
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+#include <algorithm>
+
+namespace end
+{
+	uint64_t Skeleton_Hash(const skeleton& skel)
+	{
+		const float BIND_PRECISION = 10000.0f;
+
+		uint64_t hash = fnv1a("SKEL");
+		for (size_t j = 0; j < skel.parent_indices.size(); ++j)
+		{
+			int32_t parent = skel.parent_indices[j];
+			hash = fnv1a(&parent, sizeof(parent), hash);
+			if (j < skel.names.size())
+				hash = fnv1a(skel.names[j].c_str(), skel.names[j].size() + 1, hash);
+			if (j < skel.inverse_bind.size())
+			{
+				const float* m = &skel.inverse_bind[j].m[0][0];
+				for (int e = 0; e < 16; ++e)
+				{
+					int64_t rounded = static_cast<int64_t>(std::llround(m[e] * BIND_PRECISION));
+					hash = fnv1a(&rounded, sizeof(rounded), hash);
+				}
+			}
+		}
+		return hash;
+	}
+
+	std::string Skeleton_File_Name(uint64_t hash)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.skel", static_cast<unsigned long long>(hash));
+		return name;
+	}
+
+	void Write_Skeleton_File(const skeleton& skel, uint64_t hash, const char* output_file_path)
+	{
+		FBX_PROFILE_SCOPE(scope, "write_skeleton_file");
+		skeleton_file_header header;
+		header.joint_count = static_cast<uint32_t>(skel.parent_indices.size());
+		header.hash = hash;
+
+		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+
+		assert(file.is_open());
+
+		if (file.is_open())
+		{
+			file.write((char const*)&header, sizeof(skeleton_file_header));
+			file.write((char const*)skel.parent_indices.data(), sizeof(int) * header.joint_count);
+			file.write((char const*)skel.inverse_bind.data(), sizeof(DirectX::XMFLOAT4X4) * header.joint_count);
+			for (auto& name : skel.names)
+			{
+				uint16_t length = static_cast<uint16_t>(std::min<size_t>(name.size(), UINT16_MAX));
+				file.write((char const*)&length, sizeof(uint16_t));
+				file.write(name.c_str(), length);
+			}
+			FBX_PROFILE_BYTES(scope, file.tellp());
+		}
+
+		file.close();
+	}
+
+	int Load_Skeleton_File(const char* file_path, skeleton& out_skeleton, uint64_t* out_hash)
+	{
+		std::ifstream file(file_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+			return -1;
+
+		skeleton_file_header header;
+		file.read((char*)&header, sizeof(skeleton_file_header));
+		if (!file.good() || header.magic != SKELETON_FILE_MAGIC || header.version != SKELETON_FILE_VERSION)
+			return -1;
+
+		out_skeleton.parent_indices.resize(header.joint_count);
+		out_skeleton.inverse_bind.resize(header.joint_count);
+		out_skeleton.names.resize(header.joint_count);
+		file.read((char*)out_skeleton.parent_indices.data(), sizeof(int) * header.joint_count);
+		file.read((char*)out_skeleton.inverse_bind.data(), sizeof(DirectX::XMFLOAT4X4) * header.joint_count);
+		for (auto& name : out_skeleton.names)
+		{
+			uint16_t length = 0;
+			file.read((char*)&length, sizeof(uint16_t));
+			name.resize(length);
+			file.read(&name[0], length);
+		}
+		if (!file.good())
+			return -1;
+
+		if (out_hash)
+			*out_hash = header.hash;
+		return 0;
+	}
+
+	int Find_Joint(const skeleton& skel, const char* name)
+	{
+		for (size_t j = 0; j < skel.names.size(); ++j)
+		{
+			if (skel.names[j] == name)
+				return static_cast<int>(j);
+		}
+		return -1;
+	}
+}
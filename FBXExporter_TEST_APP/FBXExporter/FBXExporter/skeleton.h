@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <DirectXMath.h>
+
+// The rig on its own, written once and shared by every mesh and clip bound to it.
+// Meshes and track files only carry the skeleton's hash, so characters that share a rig share one file.
+// No Fbx sdk dependency, the runtime can read it directly
+namespace end
+{
+	struct skeleton
+	{
+		std::vector<std::string> names;
+		std::vector<int> parent_indices;					// parents come before their children
+		std::vector<DirectX::XMFLOAT4X4> inverse_bind;		// model space to joint space at bind time
+	};
+
+	// .skel file layout
+	//	skeleton_file_header
+	//	int parent_indices[joint_count]
+	//	DirectX::XMFLOAT4X4 inverse_bind[joint_count]
+	//	per joint: uint16_t name_length, char name[name_length]
+	const uint32_t SKELETON_FILE_MAGIC = 0x4C454B53; // "SKEL"
+	const uint32_t SKELETON_FILE_VERSION = 1;
+
+	struct skeleton_file_header
+	{
+		uint32_t magic = SKELETON_FILE_MAGIC;
+		uint32_t version = SKELETON_FILE_VERSION;
+		uint32_t joint_count = 0;
+		uint32_t unused = 0;
+		uint64_t hash = 0;
+	};
+
+	// Hashes the joint names, the hierarchy and the bind pose
+	// The bind matrices are rounded first so float noise between two exports of the same rig doesn't split it
+	uint64_t Skeleton_Hash(const skeleton& skel);
+
+	// "<16 hex digits>.skel", the name every exporter gives the skeleton with 'hash'
+	std::string Skeleton_File_Name(uint64_t hash);
+
+	void Write_Skeleton_File(const skeleton& skel, uint64_t hash, const char* output_file_path);
+
+	// Returns 0 on success, non-zero to indicate failure
+	int Load_Skeleton_File(const char* file_path, skeleton& out_skeleton, uint64_t* out_hash = nullptr);
+
+	// Returns the index of the joint called 'name' or -1
+	int Find_Joint(const skeleton& skel, const char* name);
+}
@@ -0,0 +1,271 @@
+#include "pch.h"
+#include "skinning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// MSVC hands out every intrinsic regardless of /arch, gcc and clang need the function to opt in
+#if defined(_MSC_VER)
+#define SKIN_TARGET_AVX2
+#else
+#define SKIN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace end
+{
+	namespace
+	{
+		const size_t BATCH_ALIGNMENT = 8;
+
+		// the parts of a row major 4x4 a row vector actually uses: the 3x3 and the translation row
+		const int PALETTE_ELEMENTS[12] = { 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14 };
+
+		void Skin_Scalar(const float* palette, const skin_batch& b, size_t first, size_t last, skinned_batch& out)
+		{
+			for (size_t i = first; i < last; ++i)
+			{
+				float m[12] = {};
+				for (int k = 0; k < 4; ++k)
+				{
+					const float* joint = palette + b.joints[k][i] * 16;
+					float w = b.weights[k][i];
+					for (int e = 0; e < 12; ++e)
+						m[e] += joint[PALETTE_ELEMENTS[e]] * w;
+				}
+
+				float x = b.px[i], y = b.py[i], z = b.pz[i];
+				out.px[i] = x * m[0] + y * m[3] + z * m[6] + m[9];
+				out.py[i] = x * m[1] + y * m[4] + z * m[7] + m[10];
+				out.pz[i] = x * m[2] + y * m[5] + z * m[8] + m[11];
+
+				x = b.nx[i], y = b.ny[i], z = b.nz[i];
+				float nx = x * m[0] + y * m[3] + z * m[6];
+				float ny = x * m[1] + y * m[4] + z * m[7];
+				float nz = x * m[2] + y * m[5] + z * m[8];
+				float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+				float scale = length > 0.0f ? 1.0f / length : 0.0f;
+				out.nx[i] = nx * scale;
+				out.ny[i] = ny * scale;
+				out.nz[i] = nz * scale;
+			}
+		}
+
+		void Skin_Sse(const float* palette, const skin_batch& b, size_t first, size_t last, skinned_batch& out)
+		{
+			for (size_t i = first; i < last; i += 4)
+			{
+				__m128 m[12];
+				for (int e = 0; e < 12; ++e)
+					m[e] = _mm_setzero_ps();
+
+				for (int k = 0; k < 4; ++k)
+				{
+					const int* j = b.joints[k].data() + i;
+					const float* j0 = palette + j[0] * 16;
+					const float* j1 = palette + j[1] * 16;
+					const float* j2 = palette + j[2] * 16;
+					const float* j3 = palette + j[3] * 16;
+					__m128 w = _mm_loadu_ps(b.weights[k].data() + i);
+					for (int e = 0; e < 12; ++e)
+					{
+						int at = PALETTE_ELEMENTS[e];
+						m[e] = _mm_add_ps(m[e], _mm_mul_ps(_mm_set_ps(j3[at], j2[at], j1[at], j0[at]), w));
+					}
+				}
+
+				__m128 x = _mm_loadu_ps(b.px.data() + i), y = _mm_loadu_ps(b.py.data() + i), z = _mm_loadu_ps(b.pz.data() + i);
+				_mm_storeu_ps(out.px.data() + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0]), _mm_mul_ps(y, m[3])), _mm_add_ps(_mm_mul_ps(z, m[6]), m[9])));
+				_mm_storeu_ps(out.py.data() + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[1]), _mm_mul_ps(y, m[4])), _mm_add_ps(_mm_mul_ps(z, m[7]), m[10])));
+				_mm_storeu_ps(out.pz.data() + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[2]), _mm_mul_ps(y, m[5])), _mm_add_ps(_mm_mul_ps(z, m[8]), m[11])));
+
+				x = _mm_loadu_ps(b.nx.data() + i), y = _mm_loadu_ps(b.ny.data() + i), z = _mm_loadu_ps(b.nz.data() + i);
+				__m128 nx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0]), _mm_mul_ps(y, m[3])), _mm_mul_ps(z, m[6]));
+				__m128 ny = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[1]), _mm_mul_ps(y, m[4])), _mm_mul_ps(z, m[7]));
+				__m128 nz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[2]), _mm_mul_ps(y, m[5])), _mm_mul_ps(z, m[8]));
+				__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+				// zero length normals (the padding) stay zero instead of turning into NaNs
+				__m128 scale = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), length), _mm_cmpgt_ps(length, _mm_setzero_ps()));
+				_mm_storeu_ps(out.nx.data() + i, _mm_mul_ps(nx, scale));
+				_mm_storeu_ps(out.ny.data() + i, _mm_mul_ps(ny, scale));
+				_mm_storeu_ps(out.nz.data() + i, _mm_mul_ps(nz, scale));
+			}
+		}
+
+		SKIN_TARGET_AVX2 void Skin_Avx2(const float* palette, const skin_batch& b, size_t first, size_t last, skinned_batch& out)
+		{
+			for (size_t i = first; i < last; i += 8)
+			{
+				__m256 m[12];
+				for (int e = 0; e < 12; ++e)
+					m[e] = _mm256_setzero_ps();
+
+				for (int k = 0; k < 4; ++k)
+				{
+					// each joint is 16 floats into the palette
+					__m256i joint = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)(b.joints[k].data() + i)), 4);
+					__m256 w = _mm256_loadu_ps(b.weights[k].data() + i);
+					for (int e = 0; e < 12; ++e)
+						m[e] = _mm256_add_ps(m[e], _mm256_mul_ps(_mm256_i32gather_ps(palette + PALETTE_ELEMENTS[e], joint, 4), w));
+				}
+
+				__m256 x = _mm256_loadu_ps(b.px.data() + i), y = _mm256_loadu_ps(b.py.data() + i), z = _mm256_loadu_ps(b.pz.data() + i);
+				_mm256_storeu_ps(out.px.data() + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0]), _mm256_mul_ps(y, m[3])), _mm256_add_ps(_mm256_mul_ps(z, m[6]), m[9])));
+				_mm256_storeu_ps(out.py.data() + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[1]), _mm256_mul_ps(y, m[4])), _mm256_add_ps(_mm256_mul_ps(z, m[7]), m[10])));
+				_mm256_storeu_ps(out.pz.data() + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[2]), _mm256_mul_ps(y, m[5])), _mm256_add_ps(_mm256_mul_ps(z, m[8]), m[11])));
+
+				x = _mm256_loadu_ps(b.nx.data() + i), y = _mm256_loadu_ps(b.ny.data() + i), z = _mm256_loadu_ps(b.nz.data() + i);
+				__m256 nx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0]), _mm256_mul_ps(y, m[3])), _mm256_mul_ps(z, m[6]));
+				__m256 ny = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[1]), _mm256_mul_ps(y, m[4])), _mm256_mul_ps(z, m[7]));
+				__m256 nz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[2]), _mm256_mul_ps(y, m[5])), _mm256_mul_ps(z, m[8]));
+				__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)));
+				__m256 scale = _mm256_and_ps(_mm256_div_ps(_mm256_set1_ps(1.0f), length), _mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_GT_OQ));
+				_mm256_storeu_ps(out.nx.data() + i, _mm256_mul_ps(nx, scale));
+				_mm256_storeu_ps(out.ny.data() + i, _mm256_mul_ps(ny, scale));
+				_mm256_storeu_ps(out.nz.data() + i, _mm256_mul_ps(nz, scale));
+			}
+		}
+
+		void Resize(skinned_batch& out, size_t count)
+		{
+			for (auto* stream : { &out.px, &out.py, &out.pz, &out.nx, &out.ny, &out.nz })
+				stream->resize(count);
+		}
+	}
+
+	void Make_Skin_Batch(const simple_vert* verts, size_t vert_count, skin_batch& out_batch)
+	{
+		size_t padded = (vert_count + BATCH_ALIGNMENT - 1) / BATCH_ALIGNMENT * BATCH_ALIGNMENT;
+		out_batch.vert_count = vert_count;
+		out_batch.padded_count = padded;
+		for (auto* stream : { &out_batch.px, &out_batch.py, &out_batch.pz, &out_batch.nx, &out_batch.ny, &out_batch.nz })
+			stream->assign(padded, 0.0f);
+		for (int k = 0; k < 4; ++k)
+		{
+			out_batch.joints[k].assign(padded, 0);
+			out_batch.weights[k].assign(padded, 0.0f);
+		}
+
+		for (size_t i = 0; i < vert_count; ++i)
+		{
+			const simple_vert& v = verts[i];
+			out_batch.px[i] = v.pos.x;
+			out_batch.py[i] = v.pos.y;
+			out_batch.pz[i] = v.pos.z;
+			out_batch.nx[i] = v.norm.x;
+			out_batch.ny[i] = v.norm.y;
+			out_batch.nz[i] = v.norm.z;
+			for (int k = 0; k < 4; ++k)
+			{
+				out_batch.joints[k][i] = v.joint_index[k];
+				out_batch.weights[k][i] = v.weights[k];
+			}
+		}
+	}
+
+	void Build_Skinning_Palette(const std::vector<DirectX::XMFLOAT4X4>& model_pose, const std::vector<DirectX::XMFLOAT4X4>& inverse_bind,
+		std::vector<DirectX::XMFLOAT4X4>& out_palette)
+	{
+		using namespace DirectX;
+
+		size_t joint_count = std::min(model_pose.size(), inverse_bind.size());
+		out_palette.resize(joint_count);
+		for (size_t j = 0; j < joint_count; ++j)
+			XMStoreFloat4x4(&out_palette[j], XMMatrixMultiply(XMLoadFloat4x4(&inverse_bind[j]), XMLoadFloat4x4(&model_pose[j])));
+	}
+
+	void Skin_Range(const std::vector<DirectX::XMFLOAT4X4>& palette, const skin_batch& batch, size_t first, size_t last,
+		e_skinning_path path, skinned_batch& out)
+	{
+		const float* matrices = &palette[0].m[0][0];
+		if (path == SKIN_BEST)
+			path = Cpu_Has_Avx2() ? SKIN_AVX2 : SKIN_SSE;
+
+		// the vector paths run whole groups, the batch padding makes that safe
+		switch (path)
+		{
+		case SKIN_AVX2:
+			Skin_Avx2(matrices, batch, first, (last + 7) / 8 * 8, out);
+			break;
+		case SKIN_SSE:
+			Skin_Sse(matrices, batch, first, (last + 3) / 4 * 4, out);
+			break;
+		default:
+			Skin_Scalar(matrices, batch, first, last, out);
+			break;
+		}
+	}
+
+	void Skin_Batch(const std::vector<DirectX::XMFLOAT4X4>& palette, const skin_batch& batch, skinned_batch& out,
+		e_skinning_path path, unsigned thread_count)
+	{
+		Resize(out, batch.padded_count);
+		if (palette.empty() || batch.vert_count == 0)
+			return;
+
+		if (thread_count == 0)
+			thread_count = std::max(1u, std::thread::hardware_concurrency());
+		if (path == SKIN_BEST)
+			path = Cpu_Has_Avx2() ? SKIN_AVX2 : SKIN_SSE;
+
+		// ranges start on a multiple of 8 so no two threads ever write the same vector group
+		size_t groups = batch.padded_count / BATCH_ALIGNMENT;
+		size_t groups_per_thread = (groups + thread_count - 1) / thread_count;
+
+		std::vector<std::thread> workers;
+		for (unsigned t = 1; t < thread_count; ++t)
+		{
+			size_t first = t * groups_per_thread * BATCH_ALIGNMENT;
+			size_t last = std::min(first + groups_per_thread * BATCH_ALIGNMENT, batch.vert_count);
+			if (first >= last)
+				break;
+			workers.emplace_back([&, first, last] { Skin_Range(palette, batch, first, last, path, out); });
+		}
+		Skin_Range(palette, batch, 0, std::min(groups_per_thread * BATCH_ALIGNMENT, batch.vert_count), path, out);
+
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	bool Cpu_Has_Avx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		// avx itself has to be there and the OS has to save the ymm registers too
+		bool has_avx = (info[2] & (1 << 28)) != 0;
+		bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+		__cpuidex(info, 7, 0);
+		return has_avx && os_saves_ymm && (info[1] & (1 << 5));
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	size_t Check_Skin_Data(const simple_vert* verts, size_t vert_count, size_t joint_count)
+	{
+		size_t bad = 0;
+		for (size_t i = 0; i < vert_count; ++i)
+		{
+			float sum = 0.0f;
+			bool ok = true;
+			for (int k = 0; k < 4; ++k)
+			{
+				float w = verts[i].weights[k];
+				ok = ok && !std::isnan(w) && w >= 0.0f;
+				ok = ok && verts[i].joint_index[k] >= 0 && static_cast<size_t>(verts[i].joint_index[k]) < joint_count;
+				sum += w;
+			}
+			if (!ok || std::fabs(sum - 1.0f) > 0.001f)
+				++bad;
+		}
+		return bad;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "simple_mesh.h"
+
+#include <cstddef>
+
+// Reference CPU skinning for exported meshes, for servers and tools that have no GPU.
+// No Fbx sdk dependency, like the rest of the runtime side.
+namespace end
+{
+	// Bind pose vertices in structure of arrays form, every stream is padded to a multiple of 8
+	// The padding has zero weights so it skins to the origin and is never read back
+	struct skin_batch
+	{
+		size_t vert_count = 0;
+		size_t padded_count = 0;
+		std::vector<float> px, py, pz;
+		std::vector<float> nx, ny, nz;
+		std::vector<int> joints[4];
+		std::vector<float> weights[4];
+	};
+
+	struct skinned_batch
+	{
+		std::vector<float> px, py, pz;
+		std::vector<float> nx, ny, nz;
+	};
+
+	enum e_skinning_path
+	{
+		SKIN_SCALAR = 0,
+		SKIN_SSE,		// 4 vertices at a time
+		SKIN_AVX2,		// 8 vertices at a time with gathers, needs Cpu_Has_Avx2()
+		SKIN_BEST,		// AVX2 when the cpu has it, SSE otherwise
+	};
+
+	void Make_Skin_Batch(const simple_vert* verts, size_t vert_count, skin_batch& out_batch);
+
+	// palette[j] = inverse_bind[j] * model_pose[j], takes bind pose vertices straight into the posed model space
+	void Build_Skinning_Palette(const std::vector<DirectX::XMFLOAT4X4>& model_pose, const std::vector<DirectX::XMFLOAT4X4>& inverse_bind,
+		std::vector<DirectX::XMFLOAT4X4>& out_palette);
+
+	// Skins vertices [first, last) of 'batch' into 'out', which must already be sized to batch.padded_count
+	// 'first' must be a multiple of 8
+	void Skin_Range(const std::vector<DirectX::XMFLOAT4X4>& palette, const skin_batch& batch, size_t first, size_t last,
+		e_skinning_path path, skinned_batch& out);
+
+	// Skins the whole batch, split into vertex ranges over 'thread_count' threads (0 uses every hardware thread)
+	void Skin_Batch(const std::vector<DirectX::XMFLOAT4X4>& palette, const skin_batch& batch, skinned_batch& out,
+		e_skinning_path path = SKIN_BEST, unsigned thread_count = 0);
+
+	bool Cpu_Has_Avx2();
+
+	// Counts the vertices whose skin data can't be right:
+	// weights that don't add up to one, negative weights, joints outside the skeleton or NaNs
+	size_t Check_Skin_Data(const simple_vert* verts, size_t vert_count, size_t joint_count);
+}
@@ -0,0 +1,259 @@
+#include "pch.h"
+#include "vertex_layout.h"
+#include "profiler.h"
+#include "export_progress.h"
+
+#include <fstream>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+namespace end
+{
+	uint32_t Vertex_Format_Size(vertex_format format)
+	{
+		switch (format)
+		{
+		case FORMAT_FLOAT2: return 8;
+		case FORMAT_FLOAT3: return 12;
+		case FORMAT_FLOAT4: return 16;
+		case FORMAT_UNORM8X4: return 4;
+		case FORMAT_UINT8X4: return 4;
+		case FORMAT_UINT16X4: return 8;
+		case FORMAT_UNORM16X4: return 8;
+		}
+		return 0;
+	}
+
+	void Build_Vertex_Layout(const attribute_mesh& mesh, vertex_layout& out_layout)
+	{
+		out_layout = vertex_layout();
+		auto add = [&](vertex_attribute attribute, vertex_format format, size_t set)
+		{
+			vertex_element element;
+			element.attribute = attribute;
+			element.format = format;
+			element.set = static_cast<uint8_t>(set);
+			element.offset = static_cast<uint8_t>(out_layout.stride);
+			out_layout.elements.push_back(element);
+			out_layout.stride += Vertex_Format_Size(format);
+		};
+
+		add(ATTRIBUTE_POSITION, FORMAT_FLOAT3, 0);
+		if (!mesh.normals.empty())
+			add(ATTRIBUTE_NORMAL, FORMAT_FLOAT3, 0);
+		if (!mesh.colors.empty())
+			add(ATTRIBUTE_COLOR, FORMAT_UNORM8X4, 0);
+		for (size_t set = 0; set < mesh.uv_sets.size(); ++set)
+			add(ATTRIBUTE_TEXCOORD, FORMAT_FLOAT2, set);
+		if (!mesh.influences.empty())
+		{
+			add(ATTRIBUTE_JOINTS, mesh.joint_count <= 256 ? FORMAT_UINT8X4 : FORMAT_UINT16X4, 0);
+			add(ATTRIBUTE_WEIGHTS, FORMAT_UNORM16X4, 0);
+		}
+	}
+
+	namespace
+	{
+		// +0 and -0 have to pack the same or they don't weld
+		void Put_Floats(uint8_t* out, const float* values, size_t count)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				float value = values[i] + 0.0f;
+				memcpy(out + i * sizeof(float), &value, sizeof(float));
+			}
+		}
+
+		template<typename T>
+		void Put_Normalized(uint8_t* out, const float* values, size_t count)
+		{
+			const float top = static_cast<float>(std::numeric_limits<T>::max());
+			for (size_t i = 0; i < count; ++i)
+			{
+				T value = static_cast<T>(std::lround(std::clamp(values[i], 0.0f, 1.0f) * top));
+				memcpy(out + i * sizeof(T), &value, sizeof(T));
+			}
+		}
+
+		uint64_t Packed_Hash(const uint8_t* vert, uint32_t stride)
+		{
+			uint64_t hash = 0x9E3779B97F4A7C15ull;
+			for (uint32_t i = 0; i + sizeof(uint32_t) <= stride; i += sizeof(uint32_t))
+			{
+				uint32_t word;
+				memcpy(&word, vert + i, sizeof(uint32_t));
+				hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+			}
+			return hash ^ (hash >> 29);
+		}
+	}
+
+	void Pack_Vertices(const attribute_mesh& mesh, const vertex_layout& layout, std::vector<uint8_t>& out_vertices)
+	{
+		size_t corner_count = mesh.positions.size();
+		out_vertices.assign(corner_count * layout.stride, 0);
+
+		for (size_t corner = 0; corner < corner_count; ++corner)
+		{
+			uint8_t* vert = out_vertices.data() + corner * layout.stride;
+			for (const vertex_element& element : layout.elements)
+			{
+				uint8_t* out = vert + element.offset;
+				switch (element.attribute)
+				{
+				case ATTRIBUTE_POSITION:
+					Put_Floats(out, &mesh.positions[corner].x, 3);
+					break;
+				case ATTRIBUTE_NORMAL:
+					Put_Floats(out, &mesh.normals[corner].x, 3);
+					break;
+				case ATTRIBUTE_COLOR:
+					Put_Normalized<uint8_t>(out, &mesh.colors[corner].x, 4);
+					break;
+				case ATTRIBUTE_TEXCOORD:
+					Put_Floats(out, &mesh.uv_sets[element.set][corner].x, 2);
+					break;
+				case ATTRIBUTE_JOINTS:
+					for (size_t i = 0; i < MAX_INFLUENCES; ++i)
+					{
+						int joint = mesh.influences[corner][i].joint;
+						if (element.format == FORMAT_UINT8X4)
+							out[i] = static_cast<uint8_t>(joint);
+						else
+						{
+							uint16_t wide = static_cast<uint16_t>(joint);
+							memcpy(out + i * sizeof(uint16_t), &wide, sizeof(uint16_t));
+						}
+					}
+					break;
+				case ATTRIBUTE_WEIGHTS:
+				{
+					const influence_set& influences = mesh.influences[corner];
+					float weights[MAX_INFLUENCES];
+					float sum = 0.0f;
+					for (size_t i = 0; i < MAX_INFLUENCES; ++i)
+						sum += weights[i] = influences[i].weight;
+					// control points no cluster reached stay all zero rather than divide by it
+					for (size_t i = 0; i < MAX_INFLUENCES && sum > 0.0f; ++i)
+						weights[i] /= sum;
+					Put_Normalized<uint16_t>(out, weights, MAX_INFLUENCES);
+				}
+				break;
+				}
+			}
+		}
+	}
+
+	void Weld_Packed_Vertices(std::vector<uint8_t>& vertices, uint32_t stride, std::vector<uint32_t>& out_indices)
+	{
+		FBX_PROFILE_SCOPE(scope, "weld_packed_vertices");
+		size_t vert_count = stride ? vertices.size() / stride : 0;
+		out_indices.resize(vert_count);
+
+		// same open addressing as Compactify, slots hold a welded index + 1
+		size_t table_size = 16;
+		while (table_size < vert_count * 2)
+			table_size *= 2;
+		std::vector<uint32_t> table(table_size, 0);
+		size_t mask = table_size - 1;
+
+		uint8_t* data = vertices.data();
+		uint32_t welded = 0;
+		for (size_t v = 0; v < vert_count; ++v)
+		{
+			if ((v & 4095) == 0 && Export_Checkpoint("weld_packed_vertices", v, vert_count))
+			{
+				vertices.clear();
+				out_indices.clear();
+				return;
+			}
+
+			const uint8_t* vert = data + v * stride;
+			size_t slot = Packed_Hash(vert, stride) & mask;
+			while (table[slot] != 0 && memcmp(data + size_t(table[slot] - 1) * stride, vert, stride) != 0)
+				slot = (slot + 1) & mask;
+
+			if (table[slot] == 0)
+			{
+				if (welded != v)
+					memcpy(data + size_t(welded) * stride, vert, stride);
+				table[slot] = ++welded;
+			}
+			out_indices[v] = table[slot] - 1;
+		}
+
+		vertices.resize(size_t(welded) * stride);
+		FBX_PROFILE_ITEMS(scope, vert_count, welded);
+	}
+
+	void Write_Packed_Mesh_File(const packed_mesh& mesh, const char* output_file_path)
+	{
+		FBX_PROFILE_SCOPE(scope, "write_packed_mesh_file");
+		packed_mesh_header header;
+		header.stride = mesh.layout.stride;
+		header.vertex_count = mesh.layout.stride ? static_cast<uint32_t>(mesh.vertices.size() / mesh.layout.stride) : 0;
+		header.index_count = static_cast<uint32_t>(mesh.indices.size());
+		header.element_count = static_cast<uint16_t>(mesh.layout.elements.size());
+		header.index_size = header.vertex_count <= 0x10000 ? 2 : 4;
+		header.skeleton_hash = mesh.skeleton_hash;
+		FBX_PROFILE_ITEMS(scope, header.vertex_count, header.index_count);
+
+		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+
+		assert(file.is_open());
+
+		if (file.is_open())
+		{
+			file.write((char const*)&header, sizeof(packed_mesh_header));
+			file.write((char const*)mesh.layout.elements.data(), sizeof(vertex_element) * header.element_count);
+			file.write((char const*)mesh.vertices.data(), mesh.vertices.size());
+			if (header.index_size == 2)
+			{
+				std::vector<uint16_t> narrow(mesh.indices.begin(), mesh.indices.end());
+				file.write((char const*)narrow.data(), sizeof(uint16_t) * narrow.size());
+			}
+			else
+				file.write((char const*)mesh.indices.data(), sizeof(uint32_t) * mesh.indices.size());
+			FBX_PROFILE_BYTES(scope, file.tellp());
+		}
+
+		file.close();
+	}
+
+	int Load_Packed_Mesh_File(const char* file_path, packed_mesh& out_mesh)
+	{
+		std::ifstream file(file_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+			return -1;
+
+		packed_mesh_header header;
+		file.read((char*)&header, sizeof(packed_mesh_header));
+		if (!file.good() || header.magic != PACKED_MESH_FILE_MAGIC || header.version != PACKED_MESH_FILE_VERSION
+			|| (header.index_size != 2 && header.index_size != 4))
+			return -1;
+
+		out_mesh.layout.stride = header.stride;
+		out_mesh.layout.elements.resize(header.element_count);
+		out_mesh.vertices.resize(size_t(header.vertex_count) * header.stride);
+		out_mesh.skeleton_hash = header.skeleton_hash;
+		file.read((char*)out_mesh.layout.elements.data(), sizeof(vertex_element) * header.element_count);
+		file.read((char*)out_mesh.vertices.data(), out_mesh.vertices.size());
+		if (header.index_size == 2)
+		{
+			std::vector<uint16_t> narrow(header.index_count);
+			file.read((char*)narrow.data(), sizeof(uint16_t) * narrow.size());
+			out_mesh.indices.assign(narrow.begin(), narrow.end());
+		}
+		else
+		{
+			out_mesh.indices.resize(header.index_count);
+			file.read((char*)out_mesh.indices.data(), sizeof(uint32_t) * header.index_count);
+		}
+		if (!file.good())
+			return -1;
+		return 0;
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "mesh_processing.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <DirectXMath.h>
+
+// Meshes whose vertices only carry the channels the mesh actually has.
+// simple_vert is 84 bytes whatever the mesh; a static prop with one uv set packs down to 32 (position, normal, uv),
+// a skinned one with colors and two uv sets to 56. The layout is described in the file so the runtime can build its
+// input layout straight from it. No Fbx sdk dependency
+namespace end
+{
+	enum vertex_attribute : uint8_t
+	{
+		ATTRIBUTE_POSITION = 0,
+		ATTRIBUTE_NORMAL,
+		ATTRIBUTE_COLOR,
+		ATTRIBUTE_TEXCOORD,		// 'set' tells the uv sets apart
+		ATTRIBUTE_JOINTS,
+		ATTRIBUTE_WEIGHTS
+	};
+
+	enum vertex_format : uint8_t
+	{
+		FORMAT_FLOAT2 = 0,
+		FORMAT_FLOAT3,
+		FORMAT_FLOAT4,
+		FORMAT_UNORM8X4,		// colors
+		FORMAT_UINT8X4,			// joints of skeletons up to 256 joints
+		FORMAT_UINT16X4,		// joints of bigger ones
+		FORMAT_UNORM16X4		// weights
+	};
+
+	// Bytes one element of 'format' takes
+	uint32_t Vertex_Format_Size(vertex_format format);
+
+	struct vertex_element
+	{
+		vertex_attribute attribute = ATTRIBUTE_POSITION;
+		vertex_format format = FORMAT_FLOAT3;
+		uint8_t set = 0;
+		uint8_t offset = 0;		// bytes from the start of the vertex
+	};
+
+	struct vertex_layout
+	{
+		uint32_t stride = 0;
+		std::vector<vertex_element> elements;
+	};
+
+	// Per triangle corner channels of a mesh, a channel the mesh doesn't have is left empty
+	struct attribute_mesh
+	{
+		std::vector<DirectX::XMFLOAT3> positions;
+		std::vector<DirectX::XMFLOAT3> normals;
+		std::vector<DirectX::XMFLOAT4> colors;
+		std::vector<std::vector<DirectX::XMFLOAT2>> uv_sets;
+		std::vector<influence_set> influences;
+		uint32_t joint_count = 0;				// picks the joint format
+	};
+
+	// Position, then normal, color, every uv set and the skin, whichever the mesh has, tightly packed
+	void Build_Vertex_Layout(const attribute_mesh& mesh, vertex_layout& out_layout);
+
+	// One 'layout.stride' vertex per triangle corner
+	void Pack_Vertices(const attribute_mesh& mesh, const vertex_layout& layout, std::vector<uint8_t>& out_vertices);
+
+	// Compactify on packed vertices: welds the ones that are the same byte for byte, every channel counts
+	void Weld_Packed_Vertices(std::vector<uint8_t>& vertices, uint32_t stride, std::vector<uint32_t>& out_indices);
+
+	// .pmesh file layout
+	//	packed_mesh_header
+	//	vertex_element elements[element_count]
+	//	uint8_t vertices[vertex_count * stride]
+	//	uint16_t or uint32_t indices[index_count]		(index_size bytes each)
+	const uint32_t PACKED_MESH_FILE_MAGIC = 0x48534D50; // "PMSH"
+	const uint32_t PACKED_MESH_FILE_VERSION = 1;
+
+	struct packed_mesh_header
+	{
+		uint32_t magic = PACKED_MESH_FILE_MAGIC;
+		uint32_t version = PACKED_MESH_FILE_VERSION;
+		uint32_t vertex_count = 0;
+		uint32_t index_count = 0;
+		uint32_t stride = 0;
+		uint16_t element_count = 0;
+		uint16_t index_size = 4;				// 2 when every index fits
+		uint64_t skeleton_hash = 0;				// 0 for meshes without a skin
+	};
+
+	struct packed_mesh
+	{
+		vertex_layout layout;
+		std::vector<uint8_t> vertices;
+		std::vector<uint32_t> indices;
+		uint64_t skeleton_hash = 0;
+	};
+
+	void Write_Packed_Mesh_File(const packed_mesh& mesh, const char* output_file_path);
+
+	// Returns 0 on success, non-zero to indicate failure
+	int Load_Packed_Mesh_File(const char* file_path, packed_mesh& out_mesh);
+}
@@ -0,0 +1,224 @@
+#include "pch.h"
+#include "vertex_streams.h"
+#include "profiler.h"
+
+#include <fstream>
+#include <cassert>
+#include <cstring>
+#include <unordered_map>
+
+namespace end
+{
+	namespace
+	{
+		struct position_key
+		{
+			uint32_t bits[3];
+
+			bool operator==(const position_key& other) const
+			{
+				return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+			}
+		};
+
+		struct position_key_hash
+		{
+			size_t operator()(const position_key& key) const
+			{
+				uint64_t hash = 0x9E3779B97F4A7C15ull;
+				for (uint32_t word : key.bits)
+					hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+				return static_cast<size_t>(hash ^ (hash >> 29));
+			}
+		};
+
+		// +0 and -0 are the same place
+		position_key Position_Key(const DirectX::XMFLOAT3& position)
+		{
+			position_key key;
+			float values[3] = { position.x + 0.0f, position.y + 0.0f, position.z + 0.0f };
+			memcpy(key.bits, values, sizeof(key.bits));
+			return key;
+		}
+
+		uint64_t Align(uint64_t offset, uint32_t alignment)
+		{
+			return (offset + alignment - 1) & ~uint64_t(alignment - 1);
+		}
+	}
+
+	void Build_Stream_Mesh(const simple_mesh& mesh, uint64_t skeleton_hash, const stream_options& options, stream_mesh& out_mesh)
+	{
+		FBX_PROFILE_SCOPE(scope, "build_stream_mesh");
+		out_mesh = stream_mesh();
+		out_mesh.skeleton_hash = skeleton_hash;
+		bool skinned = options.skin && skeleton_hash != 0;
+
+		out_mesh.positions.resize(mesh.vert_count);
+		if (options.shading)
+			out_mesh.shading.resize(mesh.vert_count);
+		if (skinned)
+			out_mesh.skin.resize(mesh.vert_count);
+		for (uint32_t v = 0; v < mesh.vert_count; ++v)
+		{
+			const simple_vert& vert = mesh.verts[v];
+			out_mesh.positions[v] = { vert.pos.x, vert.pos.y, vert.pos.z };
+			if (options.shading)
+				out_mesh.shading[v] = { vert.norm, vert.color, vert.tex_coord };
+			if (skinned)
+			{
+				memcpy(out_mesh.skin[v].joint_index, vert.joint_index, sizeof(vert.joint_index));
+				memcpy(out_mesh.skin[v].weights, vert.weights, sizeof(vert.weights));
+			}
+		}
+		out_mesh.indices.assign(mesh.indices, mesh.indices + mesh.index_count);
+
+		if (options.shadow_indices)
+		{
+			std::unordered_map<position_key, uint32_t, position_key_hash> first;
+			first.reserve(mesh.vert_count);
+			std::vector<uint32_t> remap(mesh.vert_count);
+			for (uint32_t v = 0; v < mesh.vert_count; ++v)
+				remap[v] = first.emplace(Position_Key(out_mesh.positions[v]), v).first->second;
+
+			out_mesh.shadow_indices.resize(mesh.index_count);
+			for (uint32_t i = 0; i < mesh.index_count; ++i)
+				out_mesh.shadow_indices[i] = remap[mesh.indices[i]];
+			FBX_PROFILE_ITEMS(scope, mesh.vert_count, first.size());
+		}
+	}
+
+	void Write_Stream_Mesh_File(const stream_mesh& mesh, uint32_t alignment, const char* output_file_path)
+	{
+		FBX_PROFILE_SCOPE(scope, "write_stream_mesh_file");
+		if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+			alignment = 16;
+
+		stream_mesh_header header;
+		header.vertex_count = static_cast<uint32_t>(mesh.positions.size());
+		header.index_count = static_cast<uint32_t>(mesh.indices.size());
+		header.alignment = alignment;
+		header.skeleton_hash = mesh.skeleton_hash;
+
+		// indices are narrowed once up front, they're written as they'll be read
+		uint32_t index_stride = header.vertex_count <= 0x10000 ? 2 : 4;
+		std::vector<uint16_t> narrow_indices, narrow_shadow_indices;
+		if (index_stride == 2)
+		{
+			narrow_indices.assign(mesh.indices.begin(), mesh.indices.end());
+			narrow_shadow_indices.assign(mesh.shadow_indices.begin(), mesh.shadow_indices.end());
+		}
+
+		std::vector<stream_section> sections;
+		std::vector<const void*> data;
+		auto add = [&](stream_kind kind, uint32_t stride, size_t count, const void* bytes)
+		{
+			if (count == 0)
+				return;
+			stream_section section;
+			section.kind = kind;
+			section.stride = stride;
+			section.count = static_cast<uint32_t>(count);
+			section.size = uint64_t(stride) * count;
+			sections.push_back(section);
+			data.push_back(bytes);
+		};
+		add(STREAM_POSITIONS, sizeof(DirectX::XMFLOAT3), mesh.positions.size(), mesh.positions.data());
+		add(STREAM_SHADING, sizeof(stream_shading), mesh.shading.size(), mesh.shading.data());
+		add(STREAM_SKIN, sizeof(stream_skin), mesh.skin.size(), mesh.skin.data());
+		add(STREAM_INDICES, index_stride, mesh.indices.size(), index_stride == 2 ? (const void*)narrow_indices.data() : mesh.indices.data());
+		add(STREAM_SHADOW_INDICES, index_stride, mesh.shadow_indices.size(),
+			index_stride == 2 ? (const void*)narrow_shadow_indices.data() : mesh.shadow_indices.data());
+		header.section_count = static_cast<uint32_t>(sections.size());
+
+		uint64_t offset = sizeof(stream_mesh_header) + sizeof(stream_section) * sections.size();
+		for (stream_section& section : sections)
+		{
+			section.offset = Align(offset, alignment);
+			offset = section.offset + section.size;
+		}
+
+		std::ofstream file(output_file_path, std::ios::trunc | std::ios::binary | std::ios::out);
+
+		assert(file.is_open());
+
+		if (file.is_open())
+		{
+			file.write((char const*)&header, sizeof(stream_mesh_header));
+			file.write((char const*)sections.data(), sizeof(stream_section) * sections.size());
+			const char padding[256] = {};
+			uint64_t written = sizeof(stream_mesh_header) + sizeof(stream_section) * sections.size();
+			for (size_t s = 0; s < sections.size(); ++s)
+			{
+				for (uint64_t gap = sections[s].offset - written; gap > 0;)
+				{
+					uint64_t chunk = gap < sizeof(padding) ? gap : sizeof(padding);
+					file.write(padding, static_cast<std::streamsize>(chunk));
+					gap -= chunk;
+				}
+				file.write((char const*)data[s], static_cast<std::streamsize>(sections[s].size));
+				written = sections[s].offset + sections[s].size;
+			}
+			FBX_PROFILE_ITEMS(scope, header.vertex_count, header.section_count);
+			FBX_PROFILE_BYTES(scope, file.tellp());
+		}
+
+		file.close();
+	}
+
+	int Load_Stream_Mesh_File(const char* file_path, stream_mesh& out_mesh)
+	{
+		std::ifstream file(file_path, std::ios::binary | std::ios::in);
+		if (!file.is_open())
+			return -1;
+
+		stream_mesh_header header;
+		file.read((char*)&header, sizeof(stream_mesh_header));
+		if (!file.good() || header.magic != STREAM_MESH_FILE_MAGIC || header.version != STREAM_MESH_FILE_VERSION)
+			return -1;
+
+		std::vector<stream_section> sections(header.section_count);
+		file.read((char*)sections.data(), sizeof(stream_section) * sections.size());
+		if (!file.good())
+			return -1;
+
+		out_mesh = stream_mesh();
+		out_mesh.skeleton_hash = header.skeleton_hash;
+		for (const stream_section& section : sections)
+		{
+			file.seekg(static_cast<std::streamoff>(section.offset));
+			auto read = [&](auto& values, uint32_t stride)
+			{
+				if (section.stride != stride)
+					return false;
+				values.resize(section.count);
+				file.read((char*)values.data(), static_cast<std::streamsize>(section.size));
+				return true;
+			};
+			auto read_indices = [&](std::vector<uint32_t>& values)
+			{
+				if (section.stride == 4)
+					return read(values, 4);
+				std::vector<uint16_t> narrow;
+				if (!read(narrow, 2))
+					return false;
+				values.assign(narrow.begin(), narrow.end());
+				return true;
+			};
+
+			bool known = true;
+			switch (section.kind)
+			{
+			case STREAM_POSITIONS: known = read(out_mesh.positions, sizeof(DirectX::XMFLOAT3)); break;
+			case STREAM_SHADING: known = read(out_mesh.shading, sizeof(stream_shading)); break;
+			case STREAM_SKIN: known = read(out_mesh.skin, sizeof(stream_skin)); break;
+			case STREAM_INDICES: known = read_indices(out_mesh.indices); break;
+			case STREAM_SHADOW_INDICES: known = read_indices(out_mesh.shadow_indices); break;
+			default: break;		// newer streams are skipped
+			}
+			if (!known || !file.good())
+				return -1;
+		}
+		return 0;
+	}
+}